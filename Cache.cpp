@@ -0,0 +1,252 @@
+/* Veency - VNC Remote Access Server for iPhoneOS
+ * Copyright (C) 2008-2014  Jay Freeman (saurik)
+*/
+
+/* GNU Affero General Public License, Version 3 {{{ */
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+/* }}} */
+
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "Cache.hpp"
+
+static const size_t BytesPerPixel = 4;
+
+static inline uint64_t Mix(uint64_t hash, uint64_t value) {
+    hash ^= value * 0x9e3779b97f4a7c15ull;
+    hash = (hash << 31 | hash >> 33) * 0xbf58476d1ce4e5b9ull;
+    return hash;
+}
+
+VNCEncoded::VNCEncoded(unsigned char *data, size_t size) :
+    references_(1),
+    data_(data),
+    size_(size)
+{
+}
+
+VNCEncoded::~VNCEncoded() {
+    free(data_);
+}
+
+VNCEncoded *VNCEncoded::Retain() {
+    __sync_add_and_fetch(&references_, 1);
+    return this;
+}
+
+void VNCEncoded::Release() {
+    if (__sync_sub_and_fetch(&references_, 1) == 0)
+        delete this;
+}
+
+VNCTileCache::VNCTileCache() :
+    entries_(new Entry[Sets][Ways]),
+    sets_(Sets),
+    clock_(0),
+    hits_(0),
+    misses_(0),
+    waits_(0),
+    saved_(0),
+    bytes_(0)
+{
+    pthread_mutex_init(&mutex_, NULL);
+    pthread_cond_init(&done_, NULL);
+    memset(entries_, 0, sets_ * sizeof(*entries_));
+}
+
+VNCTileCache::~VNCTileCache() {
+    Clear();
+    delete [] entries_;
+    pthread_cond_destroy(&done_);
+    pthread_mutex_destroy(&mutex_);
+}
+
+void VNCTileCache::Clear() {
+    for (size_t set(0); set != sets_; ++set)
+        for (unsigned way(0); way != Ways; ++way)
+            if (entries_[set][way].encoded_ != NULL)
+                entries_[set][way].encoded_->Release();
+    bytes_ = 0;
+}
+
+void VNCTileCache::Resize(size_t tiles) {
+    Clear();
+
+    // sets stay a power of two, so a key's set is just its low bits; with
+    // only Ways per set, keys start pushing each other out well before all
+    // the entries are full, so there are twice as many as asked for
+    size_t sets(Sets);
+    while (sets * Ways < tiles * 2)
+        sets <<= 1;
+
+    if (sets != sets_) {
+        delete [] entries_;
+        entries_ = new Entry[sets][Ways];
+        sets_ = sets;
+    }
+
+    memset(entries_, 0, sets_ * sizeof(*entries_));
+}
+
+// the padding byte of each pixel is masked off, as nothing encodes it
+uint64_t VNCTileCache::Hash(const uint8_t *data, size_t stride, size_t width, size_t height, uint64_t seed) {
+    uint64_t hash(Mix(seed, width << 32 | height));
+
+    for (size_t y(0); y != height; ++y) {
+        const uint8_t *row(data + y * stride);
+
+        size_t x(0);
+        for (; x + 2 <= width; x += 2) {
+            uint64_t pair;
+            memcpy(&pair, row + x * BytesPerPixel, sizeof(pair));
+            hash = Mix(hash, pair & 0x00ffffff00ffffffull);
+        }
+
+        if (x != width) {
+            uint32_t pixel;
+            memcpy(&pixel, row + x * BytesPerPixel, sizeof(pixel));
+            hash = Mix(hash, pixel & 0x00ffffff);
+        }
+    }
+
+    return hash ^ hash >> 29;
+}
+
+// the same key, else an empty way, else the least recently used one that
+// nobody is busy encoding; NULL if they all are
+VNCTileCache::Entry *VNCTileCache::Victim(Entry *set, uint64_t key) {
+    Entry *victim(NULL);
+    for (unsigned way(0); way != Ways; ++way) {
+        Entry &entry(set[way]);
+        bool empty(entry.encoded_ == NULL && !entry.pending_);
+        if (!empty && entry.key_ == key)
+            return &entry;
+        else if (entry.pending_)
+            continue;
+        else if (victim == NULL || (victim->encoded_ != NULL && (empty || entry.used_ < victim->used_)))
+            victim = &entry;
+    }
+
+    return victim;
+}
+
+VNCEncoded *VNCTileCache::Find(uint64_t key) {
+    Entry *set(entries_[key & (sets_ - 1)]);
+    VNCEncoded *encoded(NULL);
+    bool waited(false);
+
+    pthread_mutex_lock(&mutex_);
+    for (;;) {
+        Entry *entry(Victim(set, key));
+        if (entry == NULL)
+            break;
+
+        if (entry->key_ != key || (entry->encoded_ == NULL && !entry->pending_)) {
+            // claim it; what was there before goes now, which is no loss
+            if (entry->encoded_ != NULL) {
+                bytes_ -= entry->encoded_->size_;
+                entry->encoded_->Release();
+            }
+            entry->encoded_ = NULL;
+            entry->key_ = key;
+            entry->pending_ = true;
+            break;
+        }
+
+        if (entry->encoded_ != NULL) {
+            encoded = entry->encoded_->Retain();
+            entry->used_ = ++clock_;
+            __sync_add_and_fetch(&saved_, entry->cost_);
+            break;
+        }
+
+        waited = true;
+        pthread_cond_wait(&done_, &mutex_);
+    }
+    pthread_mutex_unlock(&mutex_);
+
+    if (encoded == NULL)
+        __sync_add_and_fetch(&misses_, 1);
+    else {
+        __sync_add_and_fetch(&hits_, 1);
+        if (waited)
+            __sync_add_and_fetch(&waits_, 1);
+    }
+
+    return encoded;
+}
+
+// drops the least recently used tiles anywhere until size more would fit
+void VNCTileCache::Trim(size_t size) {
+    while (bytes_ + size > Limit) {
+        Entry *victim(NULL);
+        for (size_t set(0); set != sets_; ++set)
+            for (unsigned way(0); way != Ways; ++way) {
+                Entry &entry(entries_[set][way]);
+                if (entry.encoded_ != NULL && !entry.pending_ && (victim == NULL || entry.used_ < victim->used_))
+                    victim = &entry;
+            }
+
+        if (victim == NULL)
+            break;
+        bytes_ -= victim->encoded_->size_;
+        victim->encoded_->Release();
+        victim->encoded_ = NULL;
+    }
+}
+
+void VNCTileCache::Insert(uint64_t key, VNCEncoded *encoded, uint32_t cost) {
+    if (encoded->size_ > Largest)
+        return Abandon(key);
+
+    Entry *set(entries_[key & (sets_ - 1)]);
+    VNCEncoded *old(NULL);
+
+    pthread_mutex_lock(&mutex_);
+    if (Entry *victim = Victim(set, key)) {
+        old = victim->encoded_;
+        if (old != NULL)
+            bytes_ -= old->size_;
+        victim->encoded_ = NULL;
+        Trim(encoded->size_);
+        bytes_ += encoded->size_;
+        victim->encoded_ = encoded->Retain();
+        victim->key_ = key;
+        victim->pending_ = false;
+        victim->used_ = ++clock_;
+        victim->cost_ = cost;
+    }
+    pthread_cond_broadcast(&done_);
+    pthread_mutex_unlock(&mutex_);
+
+    if (old != NULL)
+        old->Release();
+}
+
+void VNCTileCache::Abandon(uint64_t key) {
+    Entry *set(entries_[key & (sets_ - 1)]);
+
+    pthread_mutex_lock(&mutex_);
+    for (unsigned way(0); way != Ways; ++way) {
+        Entry &entry(set[way]);
+        if (entry.pending_ && entry.key_ == key)
+            entry.pending_ = false;
+    }
+    pthread_cond_broadcast(&done_);
+    pthread_mutex_unlock(&mutex_);
+}
@@ -0,0 +1,118 @@
+/* Veency - VNC Remote Access Server for iPhoneOS
+ * Copyright (C) 2008-2014  Jay Freeman (saurik)
+*/
+
+/* GNU Affero General Public License, Version 3 {{{ */
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+/* }}} */
+
+
+#ifndef VEENCY_CACHE_HPP
+#define VEENCY_CACHE_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <pthread.h>
+
+// an encoded tile, shared by the cache and by everyone sending it; data
+// is malloc()ed, and freed along with the last reference
+
+class VNCEncoded {
+  private:
+    volatile unsigned references_;
+
+    ~VNCEncoded();
+
+  public:
+    unsigned char *data_;
+    size_t size_;
+
+    VNCEncoded(unsigned char *data, size_t size);
+
+    VNCEncoded *Retain();
+    void Release();
+};
+
+// recently encoded tiles, keyed by a hash of their pixels together with
+// everything else that went into encoding them; as JPEG (unlike zlib)
+// carries no state from one rect to the next, every client can share it
+
+// with several viewers in step, their encoders all want the same tiles at
+// once: whoever misses first claims the key, and the others wait for it to
+// be encoded rather than encoding it again themselves
+
+// it starts out with Sets * Ways entries, and Resize() makes room for a few
+// screens' worth of tiles once the screen's size is known; whatever the
+// count, no more than Limit bytes of tiles are kept
+
+class VNCTileCache {
+  private:
+    static const unsigned Sets = 16;
+    static const unsigned Ways = 4;
+    static const size_t Largest = 64 << 10;
+    static const size_t Limit = 16 << 20;
+
+    struct Entry {
+        uint64_t key_;
+        uint64_t used_;
+        VNCEncoded *encoded_;
+        bool pending_;
+        uint32_t cost_;
+    };
+
+    pthread_mutex_t mutex_;
+    pthread_cond_t done_;
+    Entry (*entries_)[Ways];
+    size_t sets_;
+    uint64_t clock_;
+
+    Entry *Victim(Entry *set, uint64_t key);
+    void Trim(size_t size);
+    void Clear();
+
+  public:
+    volatile uint64_t hits_;
+    volatile uint64_t misses_;
+
+    // hits that had to wait for another encoder to finish
+    volatile uint64_t waits_;
+
+    // the encoding time hits have saved, in microseconds
+    volatile uint64_t saved_;
+
+    // what the tiles held cost in memory
+    size_t bytes_;
+
+    VNCTileCache();
+    ~VNCTileCache();
+
+    // room for at least tiles tiles, forgetting everything; only while
+    // nobody is using the cache
+    void Resize(size_t tiles);
+
+    static uint64_t Hash(const uint8_t *data, size_t stride, size_t width, size_t height, uint64_t seed);
+
+    // a hit is a new reference; a miss (NULL) must be followed by Insert()
+    // or Abandon(), as it may have claimed the key for the caller
+    VNCEncoded *Find(uint64_t key);
+
+    // cost is how long encoding took, in microseconds
+    void Insert(uint64_t key, VNCEncoded *encoded, uint32_t cost);
+    void Abandon(uint64_t key);
+};
+
+#endif//VEENCY_CACHE_HPP
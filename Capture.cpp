@@ -0,0 +1,269 @@
+/* Veency - VNC Remote Access Server for iPhoneOS
+ * Copyright (C) 2008-2014  Jay Freeman (saurik)
+*/
+
+/* GNU Affero General Public License, Version 3 {{{ */
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+/* }}} */
+
+#include <string.h>
+
+#include "Capture.hpp"
+
+static const size_t BytesPerPixel = 4;
+
+static inline unsigned Front(uint64_t state) {
+    return state >> 0 & 0x7;
+}
+
+static inline unsigned Ready(uint64_t state) {
+    return state >> 3 & 0x7;
+}
+
+static inline unsigned Retired(uint64_t state) {
+    return state >> 6 & 0x7;
+}
+
+static inline unsigned Parity(uint64_t state) {
+    return state >> 9 & 0x1;
+}
+
+static inline bool Promoting(uint64_t state) {
+    return (state >> 10 & 0x1) != 0;
+}
+
+static inline unsigned Readers(uint64_t state, unsigned parity) {
+    return state >> (11 + parity * 11) & 0x7ff;
+}
+
+static inline uint64_t With(uint64_t state, unsigned shift, unsigned value) {
+    return (state & ~(uint64_t(0x7) << shift)) | uint64_t(value) << shift;
+}
+
+VNCCapture::VNCCapture() :
+    width_(0),
+    height_(0),
+    latest_(0),
+    previous_(None),
+    target_(NULL),
+    state_(0)
+{
+    for (unsigned slot(0); slot != Slots; ++slot) {
+        slots_[slot] = NULL;
+        stale_[slot] = NULL;
+    }
+}
+
+VNCCapture::~VNCCapture() {
+    for (unsigned slot(0); slot != Slots; ++slot) {
+        delete [] slots_[slot];
+        delete [] stale_[slot];
+    }
+}
+
+void VNCCapture::Resize(size_t width, size_t height, char **target) {
+    damage_.Resize(width, height);
+    damage_.Invalidate();
+
+    width_ = width;
+    height_ = height;
+
+    size_t size(width * height * BytesPerPixel);
+    size_t words(damage_.Words());
+
+    for (unsigned slot(0); slot != Slots; ++slot) {
+        delete [] slots_[slot];
+        slots_[slot] = new uint8_t[size];
+        memset(slots_[slot], 0, size);
+
+        delete [] stale_[slot];
+        stale_[slot] = new uint32_t[words];
+        memset(stale_[slot], slot == 0 ? 0x00 : 0xff, words * sizeof(uint32_t));
+    }
+
+    latest_ = 0;
+    previous_ = None;
+    state_ = With(With(With(0, 0, 0), 3, None), 6, None);
+
+    target_ = target;
+    *target_ = reinterpret_cast<char *>(slots_[0]);
+}
+
+size_t VNCCapture::Produce(const uint8_t *data, size_t stride) {
+    size_t pitch(width_ * BytesPerPixel);
+
+    size_t changed(damage_.Compare(slots_[latest_], pitch, data, stride));
+    if (changed == 0)
+        return 0;
+
+    unsigned slot(Claim());
+    uint8_t *base(slots_[slot]);
+    uint32_t *stale(stale_[slot]);
+
+    size_t words(damage_.Words());
+    for (size_t i(0); i != words; ++i)
+        stale[i] |= damage_.bitmap_[i];
+
+    // the back slot is missing whatever changed since it was last written
+    for (size_t row(0); row != damage_.rows_; ++row) {
+        size_t top(row * TileSize);
+        size_t bottom(top + TileSize);
+        if (bottom > height_)
+            bottom = height_;
+
+        for (size_t column(0); column != damage_.columns_; ) {
+            if (!VNCDamage::Dirty(stale, row * damage_.columns_ + column)) {
+                ++column;
+                continue;
+            }
+
+            size_t begin(column);
+            while (column != damage_.columns_ && VNCDamage::Dirty(stale, row * damage_.columns_ + column))
+                ++column;
+
+            size_t left(begin * TileSize * BytesPerPixel);
+            size_t right(column * TileSize * BytesPerPixel);
+            if (right > pitch)
+                right = pitch;
+
+            for (size_t y(top); y != bottom; ++y)
+                memcpy(base + y * pitch + left, data + y * stride + left, right - left);
+        }
+    }
+
+    memset(stale, 0, words * sizeof(uint32_t));
+    for (unsigned other(0); other != Slots; ++other)
+        if (other != slot)
+            for (size_t i(0); i != words; ++i)
+                stale_[other][i] |= damage_.bitmap_[i];
+
+    previous_ = slot == latest_ ? None : latest_;
+    latest_ = slot;
+    Post(slot);
+    return changed;
+}
+
+size_t VNCCapture::Blank() {
+    size_t changed(damage_.All());
+
+    unsigned slot(Claim());
+    memset(slots_[slot], 0, width_ * height_ * BytesPerPixel);
+
+    size_t words(damage_.Words());
+    memset(stale_[slot], 0, words * sizeof(uint32_t));
+    for (unsigned other(0); other != Slots; ++other)
+        if (other != slot)
+            for (size_t i(0); i != words; ++i)
+                stale_[other][i] |= damage_.bitmap_[i];
+
+    previous_ = slot == latest_ ? None : latest_;
+    latest_ = slot;
+    Post(slot);
+    return changed;
+}
+
+// a slot we may overwrite is neither the front nor a retired front that
+// stragglers from before the last swap might still be reading; a ready
+// slot has never been visible, so it is simply taken back
+
+unsigned VNCCapture::Claim() {
+    for (;;) {
+        uint64_t state(state_);
+
+        unsigned ready(Ready(state));
+        if (ready != None) {
+            if (__sync_bool_compare_and_swap(&state_, state, With(state, 3, None)))
+                return ready;
+            continue;
+        }
+
+        unsigned front(Front(state));
+        unsigned retired(Retired(state));
+        bool busy(Promoting(state) || Readers(state, !Parity(state)) != 0);
+
+        for (unsigned slot(0); slot != Slots; ++slot)
+            if (slot != front && (slot != retired || !busy))
+                return slot;
+    }
+}
+
+void VNCCapture::Post(unsigned slot) {
+    for (;;) {
+        uint64_t state(state_);
+        if (__sync_bool_compare_and_swap(&state_, state, With(state, 3, slot)))
+            break;
+    }
+
+    Promote();
+}
+
+// whoever takes the promoting bit moves ready to front, publishes the new
+// pointer, and only then flips the parity: encoders that registered before
+// the flip may have seen either pointer, and hold the retired slot until
+// they drain; anyone who arrives after the flip must see the new pointer
+
+bool VNCCapture::Promote() {
+    bool promoted(false);
+
+    for (;;) {
+        uint64_t state(state_);
+
+        unsigned ready(Ready(state));
+        if (ready == None || Promoting(state) || Readers(state, !Parity(state)) != 0)
+            return promoted;
+
+        uint64_t next(With(With(With(state, 6, Front(state)), 0, ready), 3, None) | uint64_t(1) << 10);
+        if (!__sync_bool_compare_and_swap(&state_, state, next))
+            continue;
+
+        *target_ = reinterpret_cast<char *>(slots_[ready]);
+        __sync_synchronize();
+
+        for (;;) {
+            state = state_;
+            next = ((state ^ uint64_t(1) << 9) & ~(uint64_t(1) << 10)) + (uint64_t(1) << 33);
+            if (__sync_bool_compare_and_swap(&state_, state, next))
+                break;
+        }
+
+        promoted = true;
+    }
+}
+
+unsigned VNCCapture::Acquire() {
+    for (;;) {
+        uint64_t state(state_);
+        unsigned parity(Parity(state));
+        if (__sync_bool_compare_and_swap(&state_, state, state + (uint64_t(1) << (11 + parity * 11))))
+            return parity;
+    }
+}
+
+bool VNCCapture::Release(unsigned parity) {
+    for (;;) {
+        uint64_t state(state_);
+        if (__sync_bool_compare_and_swap(&state_, state, state - (uint64_t(1) << (11 + parity * 11))))
+            break;
+    }
+
+    return Promote();
+}
+
+// mid-promotion, the pointer may not have been published yet
+bool VNCCapture::Pending() const {
+    uint64_t state(state_);
+    return Ready(state) != None || Promoting(state);
+}
@@ -0,0 +1,91 @@
+/* Veency - VNC Remote Access Server for iPhoneOS
+ * Copyright (C) 2008-2014  Jay Freeman (saurik)
+*/
+
+/* GNU Affero General Public License, Version 3 {{{ */
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+/* }}} */
+
+#ifndef VEENCY_CAPTURE_HPP
+#define VEENCY_CAPTURE_HPP
+
+#include "Damage.hpp"
+
+// a ring of full-frame capture buffers: the producer (the swap hook) fills
+// a back slot with whatever tiles it is missing, and the encoders (which
+// read screen->frameBuffer at will) only ever see a slot that is no longer
+// being written; the swap is coordinated through a single 64-bit word
+
+struct VNCCapture {
+    static const unsigned Slots = 3;
+    static const unsigned None = 7;
+
+    size_t width_;
+    size_t height_;
+
+    uint8_t *slots_[Slots];
+    uint32_t *stale_[Slots];
+    unsigned latest_;
+
+    // the slot holding the frame before latest_, until the next Produce(),
+    // or None if that frame was never published and its slot taken back
+    unsigned previous_;
+
+    VNCDamage damage_;
+
+    char **target_;
+
+    // front:3 ready:3 retired:3 parity:1 promoting:1 readers:11x2 sequence:31
+    volatile uint64_t state_;
+
+    VNCCapture();
+    ~VNCCapture();
+
+    // target is the pointer encoders read from (i.e. &screen->frameBuffer)
+    void Resize(size_t width, size_t height, char **target);
+
+    void Invalidate() {
+        damage_.Invalidate();
+    }
+
+    // copies a new frame into the ring; returns the number of changed tiles
+    size_t Produce(const uint8_t *data, size_t stride);
+
+    // publishes an all-black frame, damaged as a single full-screen rect
+    size_t Blank();
+
+    // brackets an encoder's use of *target_; Acquire() returns the token,
+    // and Release() whether it published a frame Produce() had to leave
+    unsigned Acquire();
+    bool Release(unsigned parity);
+
+    // whether the last frame produced is not yet what encoders read: while
+    // an encoder from before the previous frame is still reading, the ring
+    // cannot turn over, and damage marked now would be sent from the old
+    // frame and then forgotten
+    bool Pending() const;
+
+    uint32_t Sequence() const {
+        return state_ >> 33;
+    }
+
+  private:
+    unsigned Claim();
+    void Post(unsigned slot);
+    bool Promote();
+};
+
+#endif//VEENCY_CAPTURE_HPP
@@ -0,0 +1,216 @@
+/* Veency - VNC Remote Access Server for iPhoneOS
+ * Copyright (C) 2008-2014  Jay Freeman (saurik)
+*/
+
+/* GNU Affero General Public License, Version 3 {{{ */
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+/* }}} */
+
+#include <string.h>
+
+// tests/makefile sets VNC_FORCE_NEON to run the NEON kernel on other hosts
+#if defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(VNC_FORCE_NEON)
+#include <arm_neon.h>
+#elif defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "Damage.hpp"
+
+static const size_t BytesPerPixel = 4;
+
+// a tile is at most TileSize * BytesPerPixel = 256 bytes wide, so rather
+// than branching per vector we fold the xor of the whole segment together
+// and only test once at the end; memcmp() picks up any ragged tail
+
+static inline bool Differs(const uint8_t *lhs, const uint8_t *rhs, size_t size) {
+    size_t i(0);
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(VNC_FORCE_NEON)
+    uint8x16_t fold(vdupq_n_u8(0));
+    for (; i + 64 <= size; i += 64) {
+        uint8x16_t a(veorq_u8(vld1q_u8(lhs + i + 0), vld1q_u8(rhs + i + 0)));
+        uint8x16_t b(veorq_u8(vld1q_u8(lhs + i + 16), vld1q_u8(rhs + i + 16)));
+        uint8x16_t c(veorq_u8(vld1q_u8(lhs + i + 32), vld1q_u8(rhs + i + 32)));
+        uint8x16_t d(veorq_u8(vld1q_u8(lhs + i + 48), vld1q_u8(rhs + i + 48)));
+        fold = vorrq_u8(fold, vorrq_u8(vorrq_u8(a, b), vorrq_u8(c, d)));
+    }
+
+    uint64x2_t wide(vreinterpretq_u64_u8(fold));
+    if ((vgetq_lane_u64(wide, 0) | vgetq_lane_u64(wide, 1)) != 0)
+        return true;
+#elif defined(__AVX2__)
+    __m256i fold(_mm256_setzero_si256());
+    for (; i + 64 <= size; i += 64) {
+        __m256i a(_mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(lhs + i + 0)), _mm256_loadu_si256(reinterpret_cast<const __m256i *>(rhs + i + 0))));
+        __m256i b(_mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(lhs + i + 32)), _mm256_loadu_si256(reinterpret_cast<const __m256i *>(rhs + i + 32))));
+        fold = _mm256_or_si256(fold, _mm256_or_si256(a, b));
+    }
+
+    if (!_mm256_testz_si256(fold, fold))
+        return true;
+#elif defined(__SSE2__)
+    __m128i fold(_mm_setzero_si128());
+    for (; i + 64 <= size; i += 64) {
+        __m128i a(_mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i *>(lhs + i + 0)), _mm_loadu_si128(reinterpret_cast<const __m128i *>(rhs + i + 0))));
+        __m128i b(_mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i *>(lhs + i + 16)), _mm_loadu_si128(reinterpret_cast<const __m128i *>(rhs + i + 16))));
+        __m128i c(_mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i *>(lhs + i + 32)), _mm_loadu_si128(reinterpret_cast<const __m128i *>(rhs + i + 32))));
+        __m128i d(_mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i *>(lhs + i + 48)), _mm_loadu_si128(reinterpret_cast<const __m128i *>(rhs + i + 48))));
+        fold = _mm_or_si128(fold, _mm_or_si128(_mm_or_si128(a, b), _mm_or_si128(c, d)));
+    }
+
+    if (_mm_movemask_epi8(_mm_cmpeq_epi8(fold, _mm_setzero_si128())) != 0xffff)
+        return true;
+#endif
+
+    return i != size && memcmp(lhs + i, rhs + i, size - i) != 0;
+}
+
+VNCDamage::VNCDamage() :
+    width_(0),
+    height_(0),
+    columns_(0),
+    rows_(0),
+    bitmap_(NULL),
+    rects_(NULL),
+    count_(0),
+    invalid_(true)
+{
+}
+
+VNCDamage::~VNCDamage() {
+    delete [] bitmap_;
+    delete [] rects_;
+}
+
+void VNCDamage::Resize(size_t width, size_t height) {
+    if (width == width_ && height == height_)
+        return;
+
+    delete [] bitmap_;
+    delete [] rects_;
+
+    width_ = width;
+    height_ = height;
+
+    columns_ = (width + TileSize - 1) / TileSize;
+    rows_ = (height + TileSize - 1) / TileSize;
+
+    size_t tiles(columns_ * rows_);
+
+    bitmap_ = new uint32_t[(tiles + 31) / 32];
+    rects_ = new VNCRect[tiles];
+    count_ = 0;
+
+    invalid_ = true;
+}
+
+size_t VNCDamage::All() {
+    size_t tiles(columns_ * rows_);
+
+    memset(bitmap_, 0, Words() * sizeof(uint32_t));
+    for (size_t tile(0); tile != tiles; ++tile)
+        bitmap_[tile / 32] |= 1u << tile % 32;
+
+    rects_[0].x = 0;
+    rects_[0].y = 0;
+    rects_[0].w = width_;
+    rects_[0].h = height_;
+    count_ = tiles == 0 ? 0 : 1;
+
+    invalid_ = false;
+    return tiles;
+}
+
+size_t VNCDamage::Compare(const uint8_t *prev, size_t pitch, const uint8_t *next, size_t stride) {
+    memset(bitmap_, 0, Words() * sizeof(uint32_t));
+    count_ = 0;
+
+    size_t changed(0);
+
+    for (size_t row(0); row != rows_; ++row) {
+        size_t top(row * TileSize);
+        size_t bottom(top + TileSize);
+        if (bottom > height_)
+            bottom = height_;
+
+        size_t dirty(0);
+
+        for (size_t y(top); y != bottom && dirty != columns_; ++y) {
+            const uint8_t *lhs(next + y * stride);
+            const uint8_t *rhs(prev + y * pitch);
+
+            for (size_t column(0); column != columns_; ++column) {
+                if (Dirty(column, row))
+                    continue;
+
+                size_t left(column * TileSize * BytesPerPixel);
+                size_t size(TileSize * BytesPerPixel);
+                if (left + size > width_ * BytesPerPixel)
+                    size = width_ * BytesPerPixel - left;
+
+                if (invalid_ || Differs(lhs + left, rhs + left, size)) {
+                    size_t tile(row * columns_ + column);
+                    bitmap_[tile / 32] |= 1u << tile % 32;
+                    ++dirty;
+                }
+            }
+        }
+
+        if (dirty == 0)
+            continue;
+        changed += dirty;
+
+        for (size_t column(0); column != columns_; ) {
+            if (!Dirty(column, row)) {
+                ++column;
+                continue;
+            }
+
+            size_t begin(column);
+            while (column != columns_ && Dirty(column, row))
+                ++column;
+
+            size_t left(begin * TileSize);
+            size_t right(column * TileSize);
+            if (right > width_)
+                right = width_;
+
+            // extend a run of identical width from the tile row above
+            VNCRect *rect(NULL);
+            for (size_t i(0); i != count_; ++i)
+                if (rects_[i].x == left && rects_[i].w == right - left && rects_[i].y + rects_[i].h == top) {
+                    rect = &rects_[i];
+                    break;
+                }
+
+            if (rect != NULL)
+                rect->h += bottom - top;
+            else {
+                rect = &rects_[count_++];
+                rect->x = left;
+                rect->y = top;
+                rect->w = right - left;
+                rect->h = bottom - top;
+            }
+        }
+    }
+
+    invalid_ = false;
+    return changed;
+}
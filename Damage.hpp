@@ -0,0 +1,81 @@
+/* Veency - VNC Remote Access Server for iPhoneOS
+ * Copyright (C) 2008-2014  Jay Freeman (saurik)
+*/
+
+/* GNU Affero General Public License, Version 3 {{{ */
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+/* }}} */
+
+#ifndef VEENCY_DAMAGE_HPP
+#define VEENCY_DAMAGE_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+
+static const size_t TileSize = 64;
+
+struct VNCRect {
+    size_t x, y;
+    size_t w, h;
+};
+
+// compares a new 32-bit frame against the previous one and reports which
+// TileSize x TileSize tiles differ, both as a bitmap and coalesced rects
+
+struct VNCDamage {
+    size_t width_;
+    size_t height_;
+
+    size_t columns_;
+    size_t rows_;
+
+    uint32_t *bitmap_;
+
+    VNCRect *rects_;
+    size_t count_;
+
+    bool invalid_;
+
+    VNCDamage();
+    ~VNCDamage();
+
+    void Resize(size_t width, size_t height);
+
+    // the next Compare() will report every tile
+    void Invalidate() {
+        invalid_ = true;
+    }
+
+    size_t Words() const {
+        return (columns_ * rows_ + 31) / 32;
+    }
+
+    static bool Dirty(const uint32_t *bitmap, size_t tile) {
+        return (bitmap[tile / 32] & 1u << tile % 32) != 0;
+    }
+
+    bool Dirty(size_t column, size_t row) const {
+        return Dirty(bitmap_, row * columns_ + column);
+    }
+
+    // marks every tile, reported as a single rect; returns the tile count
+    size_t All();
+
+    // returns the number of changed tiles, and coalesces them into rects_
+    size_t Compare(const uint8_t *prev, size_t pitch, const uint8_t *next, size_t stride);
+};
+
+#endif//VEENCY_DAMAGE_HPP
@@ -0,0 +1,116 @@
+/* Veency - VNC Remote Access Server for iPhoneOS
+ * Copyright (C) 2008-2014  Jay Freeman (saurik)
+*/
+
+/* GNU Affero General Public License, Version 3 {{{ */
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+/* }}} */
+
+#include <math.h>
+
+#include "Governor.hpp"
+
+// motion at or below Idle is batched at the ceiling, at or above Busy it is
+// sent at the floor, and in between we interpolate on a log scale
+static const double Idle = 0.01;
+static const double Busy = 1.0;
+
+// samples shorter than this are too noisy to turn into a rate
+static const uint64_t Window = 250000;
+
+// a client with more than this much unsent is not keeping up
+static const size_t Backlogged = 64 * 1024;
+
+VNCGovernor::VNCGovernor(unsigned floor, unsigned ceiling, unsigned defer) :
+    floor_(floor),
+    ceiling_(ceiling),
+    defer_(defer),
+    motion_(0),
+    encode_(0),
+    backlog_(0),
+    start_(0),
+    damage_(0),
+    micros_(0),
+    updates_(0),
+    queued_(0)
+{
+}
+
+void VNCGovernor::Damage(uint64_t now, size_t changed, size_t tiles) {
+    if (start_ == 0)
+        start_ = now;
+    if (tiles != 0)
+        damage_ += double(changed) / tiles;
+}
+
+void VNCGovernor::Encode(uint64_t micros) {
+    __sync_add_and_fetch(&micros_, micros);
+    __sync_add_and_fetch(&updates_, 1);
+}
+
+void VNCGovernor::Backlog(size_t bytes) {
+    for (;;) {
+        size_t queued(queued_);
+        if (bytes <= queued || __sync_bool_compare_and_swap(&queued_, queued, bytes))
+            break;
+    }
+}
+
+unsigned VNCGovernor::Update(uint64_t now) {
+    if (start_ == 0 || now - start_ < Window)
+        return defer_;
+
+    double rate(damage_ * 1000000 / (now - start_));
+    motion_ = (motion_ + rate) / 2;
+    start_ = now;
+    damage_ = 0;
+
+    uint64_t micros(__sync_fetch_and_and(&micros_, 0));
+    uint32_t updates(__sync_fetch_and_and(&updates_, 0));
+    if (updates != 0)
+        encode_ = (encode_ + double(micros) / updates / 1000) / 2;
+
+    backlog_ = __sync_fetch_and_and(&queued_, 0);
+
+    double target;
+    if (motion_ <= Idle)
+        target = ceiling_;
+    else if (motion_ >= Busy)
+        target = floor_;
+    else
+        target = ceiling_ + (log(motion_) - log(Idle)) / (log(Busy) - log(Idle)) * (double(floor_) - ceiling_);
+
+    // sending faster than we can encode only queues up stale frames
+    if (target < encode_ * 5 / 4)
+        target = encode_ * 5 / 4;
+
+    // and while a socket is backed up, coalesce harder until it drains
+    if (backlog_ > Backlogged && target < defer_ * 3 / 2)
+        target = defer_ * 3 / 2;
+
+    if (target < floor_)
+        target = floor_;
+    if (target > ceiling_)
+        target = ceiling_;
+
+    // move up quickly, but come back down gradually
+    if (target > defer_)
+        defer_ = target;
+    else
+        defer_ = (defer_ + target) / 2;
+
+    return defer_;
+}
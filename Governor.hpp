@@ -0,0 +1,62 @@
+/* Veency - VNC Remote Access Server for iPhoneOS
+ * Copyright (C) 2008-2014  Jay Freeman (saurik)
+*/
+
+/* GNU Affero General Public License, Version 3 {{{ */
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+/* }}} */
+
+#ifndef VEENCY_GOVERNOR_HPP
+#define VEENCY_GOVERNOR_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+
+// picks libvncserver's deferUpdateTime between floor_ and ceiling_: small,
+// sporadic damage (a clock, a caret) is batched up, heavy motion is sent as
+// fast as the encoders and the slowest socket can actually keep up with
+
+struct VNCGovernor {
+    unsigned floor_;
+    unsigned ceiling_;
+    unsigned defer_;
+
+    // screens of damage per second, milliseconds per update, unsent bytes
+    double motion_;
+    double encode_;
+    size_t backlog_;
+
+    uint64_t start_;
+    double damage_;
+
+    volatile uint64_t micros_;
+    volatile uint32_t updates_;
+    volatile size_t queued_;
+
+    VNCGovernor(unsigned floor, unsigned ceiling, unsigned defer);
+
+    // called by the capture thread, with the fraction of tiles that changed
+    void Damage(uint64_t now, size_t changed, size_t tiles);
+
+    // called by client threads as updates finish
+    void Encode(uint64_t micros);
+    void Backlog(size_t bytes);
+
+    // returns the new defer time, in milliseconds
+    unsigned Update(uint64_t now);
+};
+
+#endif//VEENCY_GOVERNOR_HPP
@@ -0,0 +1,86 @@
+/* Veency - VNC Remote Access Server for iPhoneOS
+ * Copyright (C) 2008-2014  Jay Freeman (saurik)
+*/
+
+/* GNU Affero General Public License, Version 3 {{{ */
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+/* }}} */
+
+#include <string.h>
+
+#include "Histogram.hpp"
+
+VNCHistogram::VNCHistogram() :
+    maximum_(0)
+{
+    memset(const_cast<uint32_t *>(counts_), 0, sizeof(counts_));
+}
+
+unsigned VNCHistogram::Index(uint64_t value) {
+    static const uint64_t Maximum((uint64_t(Sub) << Shifts) - 1);
+    if (value > Maximum)
+        value = Maximum;
+
+    unsigned shift(0);
+    if (value >= 2 * Sub)
+        shift = 63 - __builtin_clzll(value) - SubBits;
+    return shift * Sub + (value >> shift);
+}
+
+uint64_t VNCHistogram::Lowest(unsigned index) {
+    unsigned shift(index < 2 * Sub ? 0 : index / Sub - 1);
+    return uint64_t(index - shift * Sub) << shift;
+}
+
+void VNCHistogram::Add(uint64_t value) {
+    __sync_fetch_and_add(&counts_[Index(value)], 1);
+
+    for (;;) {
+        uint64_t maximum(maximum_);
+        if (value <= maximum || __sync_bool_compare_and_swap(&maximum_, maximum, value))
+            break;
+    }
+}
+
+uint64_t VNCHistogram::Count() const {
+    uint64_t count(0);
+    for (unsigned i(0); i != Buckets; ++i)
+        count += counts_[i];
+    return count;
+}
+
+uint64_t VNCHistogram::Percentile(double fraction) const {
+    uint64_t count(Count());
+    if (count == 0)
+        return 0;
+
+    uint64_t rank(fraction * count + 0.5);
+    if (rank == 0)
+        rank = 1;
+    else if (rank > count)
+        rank = count;
+
+    uint64_t seen(0);
+    for (unsigned i(0); i != Buckets; ++i) {
+        seen += counts_[i];
+        if (seen >= rank) {
+            uint64_t highest(i + 1 == Buckets ? maximum_ : Lowest(i + 1) - 1);
+            return highest < maximum_ ? highest : maximum_;
+        }
+    }
+
+    return maximum_;
+}
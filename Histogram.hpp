@@ -0,0 +1,54 @@
+/* Veency - VNC Remote Access Server for iPhoneOS
+ * Copyright (C) 2008-2014  Jay Freeman (saurik)
+*/
+
+/* GNU Affero General Public License, Version 3 {{{ */
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+/* }}} */
+
+#ifndef VEENCY_HISTOGRAM_HPP
+#define VEENCY_HISTOGRAM_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+
+// log-linear buckets in the manner of HdrHistogram: values below 2 * Sub
+// are exact, and above that each bucket is 1/Sub of its power of two wide;
+// recording is a single atomic add, so any thread may call Add() at will
+
+struct VNCHistogram {
+    static const unsigned SubBits = 4;
+    static const unsigned Sub = 1 << SubBits;
+    static const unsigned Shifts = 32;
+    static const unsigned Buckets = (Shifts + 1) * Sub;
+
+    volatile uint32_t counts_[Buckets];
+    volatile uint64_t maximum_;
+
+    VNCHistogram();
+
+    static unsigned Index(uint64_t value);
+    static uint64_t Lowest(unsigned index);
+
+    void Add(uint64_t value);
+
+    uint64_t Count() const;
+
+    // the smallest bucket bound at or below which fraction of samples fall
+    uint64_t Percentile(double fraction) const;
+};
+
+#endif//VEENCY_HISTOGRAM_HPP
@@ -0,0 +1,293 @@
+/* Veency - VNC Remote Access Server for iPhoneOS
+ * Copyright (C) 2008-2014  Jay Freeman (saurik)
+*/
+
+/* GNU Affero General Public License, Version 3 {{{ */
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+/* }}} */
+
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
+#define JPEG_INTERNALS
+
+extern "C" {
+#include <jpeglib.h>
+#include <jdct.h>
+}
+
+#include "Jpeg.hpp"
+
+// VNCFdctController and VNCForwardDCT() follow jpeg-9's private layouts
+#if JPEG_LIB_VERSION != 90
+#error "Jpeg.cpp is written against jpeg-9"
+#endif
+
+// jcdctmgr.c's my_fdct_controller, as far as the fields we need: jpeg-9
+// follows do_dct with do_float_dct (if DCT_FLOAT_SUPPORTED), so the prefix
+// is the same either way, and keeps the divisors in dct_table
+
+struct VNCFdctController {
+    struct jpeg_forward_dct pub;
+    forward_DCT_method_ptr do_dct[MAX_COMPONENTS];
+};
+
+// jccolor.c builds a table of these products; as every entry is linear in
+// the sample, computing them directly is exact, rounding terms included
+
+static const int ScaleBits = 16;
+static const uint32_t OneHalf = 1 << (ScaleBits - 1);
+static const uint32_t Offset = CENTERJSAMPLE << ScaleBits;
+
+// FIX(0.299), FIX(0.587) and so on, at ScaleBits
+static const uint16_t YR(19595), YG(38470), YB(7471);
+static const uint16_t CbR(11058), CbG(21710), CbB(32768);
+static const uint16_t CrR(32768), CrG(27439), CrB(5329);
+
+// Bytes is the size of an input pixel, and Red/Green/Blue its byte offsets
+template <unsigned Bytes, unsigned Red, unsigned Green, unsigned Blue>
+static void VNCColorConvert(j_compress_ptr cinfo, JSAMPARRAY input_buf, JSAMPIMAGE output_buf, JDIMENSION output_row, int num_rows) {
+    JDIMENSION width(cinfo->image_width);
+
+    while (--num_rows >= 0) {
+        const JSAMPLE *in(*input_buf++);
+        JSAMPLE *y(output_buf[0][output_row]);
+        JSAMPLE *cb(output_buf[1][output_row]);
+        JSAMPLE *cr(output_buf[2][output_row]);
+        ++output_row;
+
+        JDIMENSION col(0);
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+        // Cb and Cr are computed unsigned: the offset keeps them positive
+        uint32x4_t half(vdupq_n_u32(OneHalf));
+        uint32x4_t offset(vdupq_n_u32(Offset + OneHalf - 1));
+
+        for (; col + 8 <= width; col += 8) {
+            uint8x8_t lanes[4];
+            if (Bytes == 4) {
+                uint8x8x4_t pixels(vld4_u8(in + col * 4));
+                for (unsigned i(0); i != 4; ++i)
+                    lanes[i] = pixels.val[i];
+            } else {
+                uint8x8x3_t pixels(vld3_u8(in + col * 3));
+                for (unsigned i(0); i != 3; ++i)
+                    lanes[i] = pixels.val[i];
+            }
+
+            uint16x8_t r(vmovl_u8(lanes[Red]));
+            uint16x8_t g(vmovl_u8(lanes[Green]));
+            uint16x8_t b(vmovl_u8(lanes[Blue]));
+
+            uint32x4_t yl(vmlal_n_u16(vmlal_n_u16(vmlal_n_u16(half, vget_low_u16(r), YR), vget_low_u16(g), YG), vget_low_u16(b), YB));
+            uint32x4_t yh(vmlal_n_u16(vmlal_n_u16(vmlal_n_u16(half, vget_high_u16(r), YR), vget_high_u16(g), YG), vget_high_u16(b), YB));
+            vst1_u8(y + col, vmovn_u16(vcombine_u16(vshrn_n_u32(yl, ScaleBits), vshrn_n_u32(yh, ScaleBits))));
+
+            uint32x4_t bl(vmlsl_n_u16(vmlsl_n_u16(vmlal_n_u16(offset, vget_low_u16(b), CbB), vget_low_u16(r), CbR), vget_low_u16(g), CbG));
+            uint32x4_t bh(vmlsl_n_u16(vmlsl_n_u16(vmlal_n_u16(offset, vget_high_u16(b), CbB), vget_high_u16(r), CbR), vget_high_u16(g), CbG));
+            vst1_u8(cb + col, vmovn_u16(vcombine_u16(vshrn_n_u32(bl, ScaleBits), vshrn_n_u32(bh, ScaleBits))));
+
+            uint32x4_t rl(vmlsl_n_u16(vmlsl_n_u16(vmlal_n_u16(offset, vget_low_u16(r), CrR), vget_low_u16(g), CrG), vget_low_u16(b), CrB));
+            uint32x4_t rh(vmlsl_n_u16(vmlsl_n_u16(vmlal_n_u16(offset, vget_high_u16(r), CrR), vget_high_u16(g), CrG), vget_high_u16(b), CrB));
+            vst1_u8(cr + col, vmovn_u16(vcombine_u16(vshrn_n_u32(rl, ScaleBits), vshrn_n_u32(rh, ScaleBits))));
+        }
+#endif
+
+        for (; col != width; ++col) {
+            const JSAMPLE *pixel(in + col * Bytes);
+            uint32_t r(pixel[Red]), g(pixel[Green]), b(pixel[Blue]);
+            y[col] = (YR * r + YG * g + YB * b + OneHalf) >> ScaleBits;
+            cb[col] = (CbB * b - CbR * r - CbG * g + Offset + OneHalf - 1) >> ScaleBits;
+            cr[col] = (CrR * r - CrG * g - CrB * b + Offset + OneHalf - 1) >> ScaleBits;
+        }
+    }
+}
+
+// jfdctint.c's jpeg_fdct_islow() with eight rows (or columns) per step;
+// the arithmetic, including where it rounds, is exactly the same
+
+typedef int32_t VNCLanes __attribute__((vector_size(32)));
+typedef float VNCFloats __attribute__((vector_size(32)));
+typedef JCOEF VNCCoefficients __attribute__((vector_size(16)));
+
+static const int CONST_BITS = 13;
+static const int PASS1_BITS = 2;
+
+static const int32_t FIX_0_298631336(2446);
+static const int32_t FIX_0_390180644(3196);
+static const int32_t FIX_0_541196100(4433);
+static const int32_t FIX_0_765366865(6270);
+static const int32_t FIX_0_899976223(7373);
+static const int32_t FIX_1_175875602(9633);
+static const int32_t FIX_1_501321110(12299);
+static const int32_t FIX_1_847759065(15137);
+static const int32_t FIX_1_961570560(16069);
+static const int32_t FIX_2_053119869(16819);
+static const int32_t FIX_2_562915447(20995);
+static const int32_t FIX_3_072711026(25172);
+
+static inline void Odd(const VNCLanes *in, VNCLanes *out, int shift) {
+    VNCLanes tmp0(in[0] - in[7]);
+    VNCLanes tmp1(in[1] - in[6]);
+    VNCLanes tmp2(in[2] - in[5]);
+    VNCLanes tmp3(in[3] - in[4]);
+
+    VNCLanes tmp12(tmp0 + tmp2);
+    VNCLanes tmp13(tmp1 + tmp3);
+
+    VNCLanes z1((tmp12 + tmp13) * FIX_1_175875602 + (1 << (shift - 1)));
+    tmp12 = tmp12 * -FIX_0_390180644 + z1;
+    tmp13 = tmp13 * -FIX_1_961570560 + z1;
+
+    z1 = (tmp0 + tmp3) * -FIX_0_899976223;
+    tmp0 = tmp0 * FIX_1_501321110 + z1 + tmp12;
+    tmp3 = tmp3 * FIX_0_298631336 + z1 + tmp13;
+
+    z1 = (tmp1 + tmp2) * -FIX_2_562915447;
+    tmp1 = tmp1 * FIX_3_072711026 + z1 + tmp13;
+    tmp2 = tmp2 * FIX_2_053119869 + z1 + tmp12;
+
+    out[1] = tmp0 >> shift;
+    out[3] = tmp1 >> shift;
+    out[5] = tmp2 >> shift;
+    out[7] = tmp3 >> shift;
+}
+
+static inline void Rows(const VNCLanes *in, VNCLanes *out) {
+    VNCLanes tmp0(in[0] + in[7]);
+    VNCLanes tmp1(in[1] + in[6]);
+    VNCLanes tmp2(in[2] + in[5]);
+    VNCLanes tmp3(in[3] + in[4]);
+
+    VNCLanes tmp10(tmp0 + tmp3);
+    VNCLanes tmp12(tmp0 - tmp3);
+    VNCLanes tmp11(tmp1 + tmp2);
+    VNCLanes tmp13(tmp1 - tmp2);
+
+    out[0] = (tmp10 + tmp11 - 8 * CENTERJSAMPLE) << PASS1_BITS;
+    out[4] = (tmp10 - tmp11) << PASS1_BITS;
+
+    VNCLanes z1((tmp12 + tmp13) * FIX_0_541196100 + (1 << (CONST_BITS - PASS1_BITS - 1)));
+    out[2] = (z1 + tmp12 * FIX_0_765366865) >> (CONST_BITS - PASS1_BITS);
+    out[6] = (z1 - tmp13 * FIX_1_847759065) >> (CONST_BITS - PASS1_BITS);
+
+    Odd(in, out, CONST_BITS - PASS1_BITS);
+}
+
+static inline void Columns(const VNCLanes *in, VNCLanes *out) {
+    VNCLanes tmp0(in[0] + in[7]);
+    VNCLanes tmp1(in[1] + in[6]);
+    VNCLanes tmp2(in[2] + in[5]);
+    VNCLanes tmp3(in[3] + in[4]);
+
+    VNCLanes tmp10(tmp0 + tmp3 + (1 << (PASS1_BITS - 1)));
+    VNCLanes tmp12(tmp0 - tmp3);
+    VNCLanes tmp11(tmp1 + tmp2);
+    VNCLanes tmp13(tmp1 - tmp2);
+
+    out[0] = (tmp10 + tmp11) >> PASS1_BITS;
+    out[4] = (tmp10 - tmp11) >> PASS1_BITS;
+
+    VNCLanes z1((tmp12 + tmp13) * FIX_0_541196100 + (1 << (CONST_BITS + PASS1_BITS - 1)));
+    out[2] = (z1 + tmp12 * FIX_0_765366865) >> (CONST_BITS + PASS1_BITS);
+    out[6] = (z1 - tmp13 * FIX_1_847759065) >> (CONST_BITS + PASS1_BITS);
+
+    Odd(in, out, CONST_BITS + PASS1_BITS);
+}
+
+// both passes want the lanes to run across the butterflies, so the block
+// goes in transposed and is transposed again between the passes
+static inline void Transpose(const VNCLanes *in, VNCLanes *out) {
+    const int32_t (*from)[DCTSIZE](reinterpret_cast<const int32_t (*)[DCTSIZE]>(in));
+    int32_t (*to)[DCTSIZE](reinterpret_cast<int32_t (*)[DCTSIZE]>(out));
+    for (int i(0); i != DCTSIZE; ++i)
+        for (int j(0); j != DCTSIZE; ++j)
+            to[j][i] = from[i][j];
+}
+
+static void VNCForwardDCT(j_compress_ptr, jpeg_component_info *compptr, JSAMPARRAY sample_data, JBLOCKROW coef_blocks, JDIMENSION start_row, JDIMENSION start_col, JDIMENSION num_blocks) {
+    const DCTELEM *divisors(reinterpret_cast<const DCTELEM *>(compptr->dct_table));
+
+    VNCLanes quotients[DCTSIZE];
+    VNCLanes halves[DCTSIZE];
+    for (int i(0); i != DCTSIZE; ++i)
+        for (int j(0); j != DCTSIZE; ++j) {
+            quotients[i][j] = divisors[i * DCTSIZE + j];
+            halves[i][j] = divisors[i * DCTSIZE + j] >> 1;
+        }
+
+    sample_data += start_row;
+
+    for (JDIMENSION block(0); block != num_blocks; ++block, start_col += DCTSIZE) {
+        VNCLanes samples[DCTSIZE], rows[DCTSIZE], work[DCTSIZE];
+
+        for (int i(0); i != DCTSIZE; ++i) {
+            const JSAMPLE *row(sample_data[i] + start_col);
+            for (int j(0); j != DCTSIZE; ++j)
+                samples[j][i] = row[j];
+        }
+
+        Rows(samples, rows);
+        Transpose(rows, work);
+        Columns(work, rows);
+
+        // jcdctmgr.c rounds the magnitude and divides; the numerators stay
+        // well below 2^24, so a float quotient truncates to the same value
+        JCOEF *output(coef_blocks[block]);
+        for (int i(0); i != DCTSIZE; ++i) {
+            VNCLanes sign(rows[i] >> 31);
+            VNCLanes magnitude(((rows[i] ^ sign) - sign) + halves[i]);
+            VNCLanes quotient(__builtin_convertvector(__builtin_convertvector(magnitude, VNCFloats) / __builtin_convertvector(quotients[i], VNCFloats), VNCLanes));
+            VNCCoefficients coefficients(__builtin_convertvector((quotient ^ sign) - sign, VNCCoefficients));
+            memcpy(output + i * DCTSIZE, &coefficients, sizeof(coefficients));
+        }
+    }
+}
+
+static bool VNCColorConvertible(jpeg_compress_struct *cinfo) {
+    return cinfo->in_color_space == JCS_RGB && cinfo->input_components == 3 &&
+        cinfo->jpeg_color_space == JCS_YCbCr && cinfo->num_components == 3 && cinfo->color_transform == JCT_NONE;
+}
+
+void VNCJpegAccelerate(jpeg_compress_struct *cinfo) {
+    if (VNCColorConvertible(cinfo))
+        cinfo->cconvert->color_convert = &VNCColorConvert<RGB_PIXELSIZE, RGB_RED, RGB_GREEN, RGB_BLUE>;
+
+    // the divisors in dct_table are only laid out as we read them for the
+    // integer DCT, and only unscaled blocks are DCTSIZE apart
+    if (cinfo->dct_method != JDCT_ISLOW)
+        return;
+
+    VNCFdctController *fdct(reinterpret_cast<VNCFdctController *>(cinfo->fdct));
+    for (int ci(0); ci != cinfo->num_components; ++ci) {
+        const jpeg_component_info &component(cinfo->comp_info[ci]);
+        if (component.DCT_h_scaled_size == DCTSIZE && component.DCT_v_scaled_size == DCTSIZE && fdct->do_dct[ci] == &jpeg_fdct_islow)
+            fdct->pub.forward_DCT[ci] = &VNCForwardDCT;
+    }
+}
+
+// jcprepct.c hands our row pointers straight to color_convert, so nothing
+// but the converter ever looks at how wide an input pixel really is
+bool VNCJpegInputBGRX(jpeg_compress_struct *cinfo) {
+    if (!VNCColorConvertible(cinfo))
+        return false;
+    cinfo->cconvert->color_convert = &VNCColorConvert<4, 2, 1, 0>;
+    return true;
+}
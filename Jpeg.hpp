@@ -0,0 +1,38 @@
+/* Veency - VNC Remote Access Server for iPhoneOS
+ * Copyright (C) 2008-2014  Jay Freeman (saurik)
+*/
+
+/* GNU Affero General Public License, Version 3 {{{ */
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+/* }}} */
+
+#ifndef VEENCY_JPEG_HPP
+#define VEENCY_JPEG_HPP
+
+struct jpeg_compress_struct;
+
+// called once jpeg_start_compress() has set up its modules: swaps in SIMD
+// versions of the RGB->YCbCr conversion and of the 8x8 integer DCT plus
+// quantization, which produce exactly what jpeg-9a's own C code would;
+// anything else (other color spaces, scaled DCTs) is left alone
+void VNCJpegAccelerate(jpeg_compress_struct *cinfo);
+
+// for a compressor started as 3-component RGB: makes it read 4-byte BGRX
+// pixels (a little-endian rfbPixel) instead, so that scanlines can point
+// straight into the framebuffer; false if the color spaces do not allow it
+bool VNCJpegInputBGRX(jpeg_compress_struct *cinfo);
+
+#endif//VEENCY_JPEG_HPP
@@ -0,0 +1,295 @@
+/* Veency - VNC Remote Access Server for iPhoneOS
+ * Copyright (C) 2008-2014  Jay Freeman (saurik)
+*/
+
+/* GNU Affero General Public License, Version 3 {{{ */
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+/* }}} */
+
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <sys/ioctl.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+
+#ifndef __APPLE__
+#include <linux/sockios.h>
+#endif
+
+#include "Output.hpp"
+
+void (*VNCWroteHook)(rfbClientPtr client, size_t bytes, uint64_t elapsed);
+VNCQueue *(*VNCQueueHook)(rfbClientPtr client);
+
+static uint64_t VNCMicroseconds() {
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    return uint64_t(now.tv_sec) * 1000000 + now.tv_usec;
+}
+
+bool VNCUnsent(int sock, size_t &bytes) {
+    if (sock == -1)
+        return false;
+
+    int unsent;
+#ifdef __APPLE__
+    socklen_t size(sizeof(unsent));
+    if (getsockopt(sock, SOL_SOCKET, SO_NWRITE, &unsent, &size) != 0)
+        return false;
+#else
+    if (ioctl(sock, SIOCOUTQ, &unsent) != 0)
+        return false;
+#endif
+
+    bytes = unsent;
+    return true;
+}
+
+// sockets.c's rfbWriteExact(), with writev(): on a full socket it waits in
+// five second steps, and gives up after rfbMaxClientWait of no progress
+
+static int VNCWriteAll(rfbClientPtr client, struct iovec *vector, int count) {
+    int sock(client->sock);
+    int waited(0);
+
+    while (count != 0) {
+        ssize_t written(writev(sock, vector, count));
+
+        if (written > 0) {
+            for (; count != 0 && size_t(written) >= vector->iov_len; --count, ++vector)
+                written -= vector->iov_len;
+            if (count != 0) {
+                vector->iov_base = reinterpret_cast<char *>(vector->iov_base) + written;
+                vector->iov_len -= written;
+            }
+            continue;
+        }
+
+        if (written == 0)
+            return 0;
+        if (errno == EINTR)
+            continue;
+        if (errno != EWOULDBLOCK && errno != EAGAIN)
+            return -1;
+
+        fd_set fds;
+        FD_ZERO(&fds);
+        FD_SET(sock, &fds);
+        struct timeval timeout = {5, 0};
+
+        int ready(select(sock + 1, NULL, &fds, NULL, &timeout));
+        if (ready < 0) {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+
+        if (ready != 0)
+            waited = 0;
+        else if ((waited += 5000) >= rfbMaxClientWait) {
+            errno = ETIMEDOUT;
+            return -1;
+        }
+    }
+
+    return 1;
+}
+
+VNCQueue::VNCQueue() :
+    sent_(0),
+    moved_(0)
+{
+}
+
+int VNCQueue::Write(int sock, const struct iovec *vector, int count) {
+    size_t skip(0);
+
+    if (Size() == 0) {
+        ssize_t written;
+        do written = writev(sock, vector, count);
+        while (written == -1 && errno == EINTR);
+
+        if (written != -1)
+            skip = written;
+        else if (errno != EWOULDBLOCK && errno != EAGAIN)
+            return -1;
+
+        moved_ = VNCMicroseconds();
+    }
+
+    size_t bytes(0);
+    for (int i(0); i != count; ++i)
+        bytes += vector[i].iov_len;
+    if (Size() + bytes - skip > Limit) {
+        errno = ENOBUFS;
+        return -1;
+    }
+
+    for (int i(0); i != count; ++i) {
+        const char *base(reinterpret_cast<const char *>(vector[i].iov_base));
+        size_t size(vector[i].iov_len);
+        if (skip >= size)
+            skip -= size;
+        else {
+            data_.insert(data_.end(), base + skip, base + size);
+            skip = 0;
+        }
+    }
+
+    return 1;
+}
+
+int VNCQueue::Flush(int sock) {
+    while (Size() != 0) {
+        ssize_t written(write(sock, &data_[sent_], Size()));
+        if (written > 0) {
+            sent_ += written;
+            moved_ = VNCMicroseconds();
+        } else if (written == -1 && errno == EINTR)
+            continue;
+        else if (written == -1 && errno != EWOULDBLOCK && errno != EAGAIN)
+            return -1;
+        else
+            break;
+    }
+
+    // the front is dropped once it is the larger part, so each byte is
+    // moved at most about once
+    if (Size() == 0) {
+        data_.clear();
+        sent_ = 0;
+        return 1;
+    }
+
+    if (sent_ * 2 > data_.size()) {
+        data_.erase(data_.begin(), data_.begin() + sent_);
+        sent_ = 0;
+    }
+
+    return 0;
+}
+
+int VNCWriteVector(rfbClientPtr client, struct iovec *vector, int count) {
+#ifdef LIBVNCSERVER_WITH_WEBSOCKETS
+    // websockets need their framing, which only rfbWriteExact() knows
+    if (client->webSockets) {
+        for (int i(0); i != count; ++i) {
+            int result(rfbWriteExact(client, reinterpret_cast<char *>(vector[i].iov_base), vector[i].iov_len));
+            if (result <= 0)
+                return result;
+        }
+        return 1;
+    }
+#endif
+
+    size_t bytes(0);
+    for (int i(0); i != count; ++i)
+        bytes += vector[i].iov_len;
+
+    uint64_t start(VNCMicroseconds());
+
+    LOCK(client->outputMutex);
+    VNCQueue *queue(VNCQueueHook == NULL ? NULL : (*VNCQueueHook)(client));
+    int result(queue != NULL ? queue->Write(client->sock, vector, count) : VNCWriteAll(client, vector, count));
+    UNLOCK(client->outputMutex);
+
+    if (VNCWroteHook != NULL)
+        (*VNCWroteHook)(client, bytes, VNCMicroseconds() - start);
+    return result;
+}
+
+VNCGather::VNCGather(rfbClientPtr client) :
+    client_(client),
+    count_(0),
+    mark_(0)
+{
+}
+
+// as rfbSendUpdateBuf() does, a failed write closes the client
+bool VNCGather::Send() {
+    if (client_->ublen > mark_) {
+        vector_[count_].iov_base = client_->updateBuf + mark_;
+        vector_[count_].iov_len = client_->ublen - mark_;
+        ++count_;
+    }
+
+    int result(count_ == 0 ? 1 : VNCWriteVector(client_, vector_, count_));
+
+    count_ = 0;
+    mark_ = 0;
+    client_->ublen = 0;
+
+    if (result > 0)
+        return true;
+
+    rfbLogPerror("VNCGather: write");
+    rfbCloseClient(client_);
+    return false;
+}
+
+bool VNCGather::Reserve(size_t size) {
+    return client_->ublen + size <= UPDATE_BUF_SIZE || Send();
+}
+
+bool VNCGather::Copy(const void *data, size_t size) {
+    const char *bytes(reinterpret_cast<const char *>(data));
+
+    while (size != 0) {
+        if (!Reserve(1))
+            return false;
+
+        size_t chunk(UPDATE_BUF_SIZE - client_->ublen);
+        if (chunk > size)
+            chunk = size;
+
+        memcpy(client_->updateBuf + client_->ublen, bytes, chunk);
+        client_->ublen += chunk;
+
+        bytes += chunk;
+        size -= chunk;
+    }
+
+    return true;
+}
+
+bool VNCGather::Refer(const void *data, size_t size) {
+    if (size <= Inline)
+        return Copy(data, size);
+
+    // this takes up to two entries, and Send() may need one more
+    if (count_ + 3 > Vectors && !Send())
+        return false;
+
+    if (client_->ublen > mark_) {
+        vector_[count_].iov_base = client_->updateBuf + mark_;
+        vector_[count_].iov_len = client_->ublen - mark_;
+        ++count_;
+        mark_ = client_->ublen;
+    }
+
+    vector_[count_].iov_base = const_cast<void *>(data);
+    vector_[count_].iov_len = size;
+    ++count_;
+    return true;
+}
+
+bool VNCGather::Flush() {
+    return count_ == 0 || Send();
+}
@@ -0,0 +1,120 @@
+/* Veency - VNC Remote Access Server for iPhoneOS
+ * Copyright (C) 2008-2014  Jay Freeman (saurik)
+*/
+
+/* GNU Affero General Public License, Version 3 {{{ */
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+/* }}} */
+
+
+#ifndef VEENCY_OUTPUT_HPP
+#define VEENCY_OUTPUT_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <sys/uio.h>
+
+#include <rfb/rfb.h>
+
+#include <vector>
+
+// writes a whole vector as rfbWriteExact() would a buffer: 1 on success,
+// else 0 or -1 with errno set, and the client left for the caller to close
+int VNCWriteVector(rfbClientPtr client, struct iovec *vector, int count);
+
+// how much written to the socket the peer has yet to acknowledge; false
+// if that cannot be known
+bool VNCUnsent(int sock, size_t &bytes);
+
+// told of every VNCWriteVector(), which a hook on rfbWriteExact() misses;
+// elapsed is how long it took, in microseconds
+extern void (*VNCWroteHook)(rfbClientPtr client, size_t bytes, uint64_t elapsed);
+
+// what a client wrote that its socket could not take yet: the reactor must
+// never wait on one client, so writes go out as far as the socket allows,
+// and the rest is kept here, in order, until the socket is writable again;
+// whoever uses one holds the client's outputMutex
+
+class VNCQueue {
+  private:
+    std::vector<char> data_;
+    size_t sent_;
+
+    // when the socket last took anything, or the queue last filled
+    uint64_t moved_;
+
+  public:
+    // a client that lets this much pile up is not reading, and is given up
+    // on rather than let it take the memory; a few full raw frames fit
+    static const size_t Limit = 32 << 20;
+
+    VNCQueue();
+
+    size_t Size() const {
+        return data_.size() - sent_;
+    }
+
+    uint64_t Moved() const {
+        return moved_;
+    }
+
+    // 1, or -1 with errno set (ENOBUFS past Limit); nothing is sent ahead
+    // of what is queued
+    int Write(int sock, const struct iovec *vector, int count);
+
+    // 1 once empty, 0 if the socket filled up first, or -1 with errno set
+    int Flush(int sock);
+};
+
+// where VNCWriteVector() (and Tweak's rfbWriteExact()) queue a client's
+// output rather than wait for its socket; without a queue, they block
+extern VNCQueue *(*VNCQueueHook)(rfbClientPtr client);
+
+// assembles output in updateBuf, as libvncserver does, except that large
+// payloads (such as encoded tiles) are only referenced where they are and
+// everything goes out in one writev() once updateBuf or the vector fills;
+// anything referenced must stay put until the next Flush()
+
+class VNCGather {
+  private:
+    static const int Vectors = 64;
+    static const size_t Inline = 256;
+
+    rfbClientPtr client_;
+    struct iovec vector_[Vectors];
+    int count_;
+
+    // where the part of updateBuf not yet in vector_ starts
+    int mark_;
+
+    bool Send();
+
+  public:
+    VNCGather(rfbClientPtr client);
+
+    // makes sure updateBuf has room for size more bytes
+    bool Reserve(size_t size);
+
+    bool Copy(const void *data, size_t size);
+    bool Refer(const void *data, size_t size);
+
+    // sends everything, if anything is referenced; otherwise updateBuf is
+    // left for libvncserver (or whoever appends to it next) to send
+    bool Flush();
+};
+
+#endif//VEENCY_OUTPUT_HPP
@@ -0,0 +1,126 @@
+/* Veency - VNC Remote Access Server for iPhoneOS
+ * Copyright (C) 2008-2014  Jay Freeman (saurik)
+*/
+
+/* GNU Affero General Public License, Version 3 {{{ */
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+/* }}} */
+
+#include "Pool.hpp"
+
+VNCPool::VNCPool() :
+    head_(NULL),
+    tail_(&head_),
+    threads_(0)
+{
+    pthread_mutex_init(&mutex_, NULL);
+    pthread_cond_init(&work_, NULL);
+    pthread_cond_init(&done_, NULL);
+}
+
+void VNCPool::Start(unsigned threads) {
+    for (; threads_ != threads; ++threads_) {
+        pthread_t thread;
+        if (pthread_create(&thread, NULL, &Work, this) != 0)
+            break;
+        pthread_detach(thread);
+    }
+}
+
+VNCTask *VNCPool::Take(Batch *&batch) {
+    batch = head_;
+    if (batch == NULL)
+        return NULL;
+
+    VNCTask *task(batch->tasks_[batch->next_]);
+
+    // a batch leaves the queue once handed out; its owner waits on done_
+    if (++batch->next_ == batch->count_) {
+        head_ = batch->link_;
+        if (head_ == NULL)
+            tail_ = &head_;
+    }
+
+    return task;
+}
+
+void VNCPool::Finish(Batch *batch) {
+    if (++batch->done_ == batch->count_)
+        pthread_cond_broadcast(&done_);
+}
+
+void *VNCPool::Work(void *arg) {
+    VNCPool *pool(reinterpret_cast<VNCPool *>(arg));
+    pthread_mutex_lock(&pool->mutex_);
+
+    for (;;) {
+        Batch *batch;
+        VNCTask *task(pool->Take(batch));
+        if (task == NULL) {
+            pthread_cond_wait(&pool->work_, &pool->mutex_);
+            continue;
+        }
+
+        pthread_mutex_unlock(&pool->mutex_);
+        task->Run();
+        pthread_mutex_lock(&pool->mutex_);
+
+        pool->Finish(batch);
+    }
+
+    return NULL;
+}
+
+void VNCPool::Run(VNCTask **tasks, size_t count) {
+    if (count == 0)
+        return;
+
+    if (threads_ == 0 || count == 1) {
+        for (size_t i(0); i != count; ++i)
+            tasks[i]->Run();
+        return;
+    }
+
+    Batch self;
+    self.tasks_ = tasks;
+    self.count_ = count;
+    self.next_ = 0;
+    self.done_ = 0;
+    self.link_ = NULL;
+
+    pthread_mutex_lock(&mutex_);
+
+    *tail_ = &self;
+    tail_ = &self.link_;
+    pthread_cond_broadcast(&work_);
+
+    // help with whatever is queued, ours or not, until ours is handed out
+    while (self.next_ != self.count_) {
+        Batch *batch;
+        VNCTask *task(Take(batch));
+
+        pthread_mutex_unlock(&mutex_);
+        task->Run();
+        pthread_mutex_lock(&mutex_);
+
+        Finish(batch);
+    }
+
+    while (self.done_ != self.count_)
+        pthread_cond_wait(&done_, &mutex_);
+
+    pthread_mutex_unlock(&mutex_);
+}
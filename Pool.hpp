@@ -0,0 +1,76 @@
+/* Veency - VNC Remote Access Server for iPhoneOS
+ * Copyright (C) 2008-2014  Jay Freeman (saurik)
+*/
+
+/* GNU Affero General Public License, Version 3 {{{ */
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+/* }}} */
+
+#ifndef VEENCY_POOL_HPP
+#define VEENCY_POOL_HPP
+
+#include <stddef.h>
+
+#include <pthread.h>
+
+struct VNCTask {
+    virtual ~VNCTask() {}
+    virtual void Run() = 0;
+};
+
+// a fixed set of worker threads shared by every client thread; a caller
+// hands over a batch of tasks and then works through them alongside the
+// workers, so a pool with no threads simply runs everything inline
+
+class VNCPool {
+  private:
+    struct Batch {
+        VNCTask **tasks_;
+        size_t count_;
+        size_t next_;
+        size_t done_;
+        Batch *link_;
+    };
+
+    pthread_mutex_t mutex_;
+    pthread_cond_t work_;
+    pthread_cond_t done_;
+
+    Batch *head_;
+    Batch **tail_;
+
+    unsigned threads_;
+
+    static void *Work(void *arg);
+
+    // takes the next task from the oldest batch, with mutex_ held
+    VNCTask *Take(Batch *&batch);
+    void Finish(Batch *batch);
+
+  public:
+    VNCPool();
+
+    void Start(unsigned threads);
+
+    unsigned Threads() const {
+        return threads_;
+    }
+
+    // returns once every task has been run
+    void Run(VNCTask **tasks, size_t count);
+};
+
+#endif//VEENCY_POOL_HPP
@@ -0,0 +1,413 @@
+/* Veency - VNC Remote Access Server for iPhoneOS
+ * Copyright (C) 2008-2014  Jay Freeman (saurik)
+*/
+
+/* GNU Affero General Public License, Version 3 {{{ */
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+/* }}} */
+
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#include <sys/time.h>
+
+#ifdef __APPLE__
+#include <sys/event.h>
+#else
+#include <sys/epoll.h>
+#endif
+
+#include "Output.hpp"
+#include "Reactor.hpp"
+
+static const size_t Events = 64;
+
+static uint64_t VNCMicroseconds() {
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    return uint64_t(now.tv_sec) * 1000000 + now.tv_usec;
+}
+
+static VNCQueue *VNCQueueOf(rfbClientPtr client) {
+    return VNCQueueHook == NULL ? NULL : (*VNCQueueHook)(client);
+}
+
+VNCReactor::VNCReactor() :
+    screen_(NULL),
+    running_(false),
+    queue_(-1),
+    listening_(false)
+{
+    wake_[0] = wake_[1] = -1;
+    pthread_mutex_init(&mutex_, NULL);
+}
+
+bool VNCReactor::Start(rfbScreenInfoPtr screen) {
+    if (running_)
+        return true;
+
+#ifdef __APPLE__
+    queue_ = kqueue();
+#else
+    queue_ = epoll_create(Events);
+#endif
+    if (queue_ == -1)
+        return false;
+
+    // the pipe outlives any one run, as Wake() may come from anywhere
+    if (wake_[0] == -1) {
+        if (pipe(wake_) == -1) {
+            close(queue_);
+            queue_ = -1;
+            return false;
+        }
+
+        for (unsigned i(0); i != 2; ++i) {
+            fcntl(wake_[i], F_SETFL, fcntl(wake_[i], F_GETFL) | O_NONBLOCK);
+            fcntl(wake_[i], F_SETFD, FD_CLOEXEC);
+        }
+    }
+
+    screen_ = screen;
+    watched_.clear();
+    decisions_.clear();
+    running_ = true;
+
+    if (pthread_create(&thread_, NULL, &Run, this) != 0) {
+        running_ = false;
+        Stop();
+        return false;
+    }
+
+    return true;
+}
+
+void VNCReactor::Stop() {
+    if (running_) {
+        running_ = false;
+        Signal();
+        pthread_join(thread_, NULL);
+    }
+
+    if (queue_ != -1) {
+        close(queue_);
+        queue_ = -1;
+    }
+
+    // whoever is still on hold goes with the server
+    pthread_mutex_lock(&mutex_);
+    decisions_.clear();
+    pthread_mutex_unlock(&mutex_);
+}
+
+// a full pipe already has a wakeup pending, so a failed write is fine
+void VNCReactor::Signal() {
+    char byte(0);
+    if (write(wake_[1], &byte, sizeof(byte)) == -1)
+        return;
+}
+
+void VNCReactor::Wake() {
+    if (running_)
+        Signal();
+}
+
+void VNCReactor::Answer(rfbClientPtr client, bool accept) {
+    Decision decision = {client, accept};
+    pthread_mutex_lock(&mutex_);
+    decisions_.push_back(decision);
+    pthread_mutex_unlock(&mutex_);
+    Wake();
+}
+
+void VNCReactor::Apply() {
+    std::vector<Decision> decisions;
+    pthread_mutex_lock(&mutex_);
+    decisions.swap(decisions_);
+    pthread_mutex_unlock(&mutex_);
+
+    for (size_t i(0); i != decisions.size(); ++i)
+        if (decisions[i].accept_)
+            rfbStartOnHoldClient(decisions[i].client_);
+        else
+            rfbRefuseOnHoldClient(decisions[i].client_);
+}
+
+// sends what the clients' sockets will now take of their queued output; as
+// rfbWriteExact() would, this gives up on a client whose socket has taken
+// nothing for rfbMaxClientWait, and closes it
+
+void VNCReactor::Flush() {
+    rfbClientIteratorPtr iterator(rfbGetClientIterator(screen_));
+    while (rfbClientPtr client = rfbClientIteratorNext(iterator)) {
+        // one on hold may be getting its queue on another thread right now
+        if (client->onHold)
+            continue;
+
+        VNCQueue *queue(VNCQueueOf(client));
+        if (queue == NULL)
+            continue;
+
+        LOCK(client->outputMutex);
+        int result(queue->Size() == 0 ? 1 : queue->Flush(client->sock));
+        if (result == 0 && VNCMicroseconds() - queue->Moved() >= uint64_t(rfbMaxClientWait) * 1000) {
+            errno = ETIMEDOUT;
+            result = -1;
+        }
+        UNLOCK(client->outputMutex);
+
+        if (result < 0) {
+            rfbLogPerror("VNCReactor: write");
+            rfbCloseClient(client);
+        }
+    }
+    rfbReleaseClientIterator(iterator);
+}
+
+// brings queue_ in line with the sockets libvncserver has right now, which
+// only ever change within Dispatch() on our own thread; clients on
+// hold are left out, so that nothing they send wakes us until Answer()
+
+void VNCReactor::Sync() {
+    std::vector<Watch> current;
+
+    Watch watch;
+    watch.client_ = NULL;
+    watch.output_ = false;
+
+    int listens[] = {wake_[0], screen_->listenSock, screen_->listen6Sock, screen_->httpListenSock, screen_->httpListen6Sock, screen_->httpSock};
+    for (size_t i(0); i != sizeof(listens) / sizeof(listens[0]); ++i)
+        if ((watch.fd_ = listens[i]) != -1)
+            current.push_back(watch);
+
+    rfbClientIteratorPtr iterator(rfbGetClientIterator(screen_));
+    while (rfbClientPtr client = rfbClientIteratorNext(iterator))
+        if ((watch.fd_ = client->sock) != -1 && !client->onHold) {
+            watch.client_ = client;
+            if (VNCQueue *queue = VNCQueueOf(client)) {
+                LOCK(client->outputMutex);
+                watch.output_ = queue->Size() != 0;
+                UNLOCK(client->outputMutex);
+            } else
+                watch.output_ = false;
+            current.push_back(watch);
+        }
+    rfbReleaseClientIterator(iterator);
+
+    std::sort(current.begin(), current.end());
+
+    std::vector<Watch> removed, added;
+    std::set_difference(watched_.begin(), watched_.end(), current.begin(), current.end(), std::back_inserter(removed));
+    std::set_difference(current.begin(), current.end(), watched_.begin(), watched_.end(), std::back_inserter(added));
+    watched_.swap(current);
+
+    // libvncserver already makes them so, but VNCQueue counts on it
+    for (size_t i(0); i != added.size(); ++i)
+        if (added[i].client_ != NULL)
+            fcntl(added[i].fd_, F_SETFL, fcntl(added[i].fd_, F_GETFL) | O_NONBLOCK);
+
+#ifdef __APPLE__
+    std::vector<struct kevent> changes;
+    struct kevent change;
+
+    for (size_t i(0); i != removed.size(); ++i) {
+        EV_SET(&change, removed[i].fd_, EVFILT_READ, EV_DELETE | EV_RECEIPT, 0, 0, NULL);
+        changes.push_back(change);
+        if (removed[i].output_) {
+            EV_SET(&change, removed[i].fd_, EVFILT_WRITE, EV_DELETE | EV_RECEIPT, 0, 0, NULL);
+            changes.push_back(change);
+        }
+    }
+
+    for (size_t i(0); i != added.size(); ++i) {
+        EV_SET(&change, added[i].fd_, EVFILT_READ, EV_ADD | EV_RECEIPT, 0, 0, NULL);
+        changes.push_back(change);
+        if (added[i].output_) {
+            EV_SET(&change, added[i].fd_, EVFILT_WRITE, EV_ADD | EV_RECEIPT, 0, 0, NULL);
+            changes.push_back(change);
+        }
+    }
+
+    // with EV_RECEIPT, each change (including deleting a socket that was
+    // closed, and so already deleted) reports back rather than stopping
+    // the rest, and nothing pending is drained
+    if (!changes.empty()) {
+        std::vector<struct kevent> receipts(changes.size());
+        struct timespec now = {0, 0};
+        kevent(queue_, &changes[0], changes.size(), &receipts[0], receipts.size(), &now);
+    }
+#else
+    for (size_t i(0); i != removed.size(); ++i)
+        epoll_ctl(queue_, EPOLL_CTL_DEL, removed[i].fd_, NULL);
+
+    for (size_t i(0); i != added.size(); ++i) {
+        struct epoll_event event;
+        event.events = EPOLLIN;
+        if (added[i].output_)
+            event.events |= EPOLLOUT;
+        event.data.fd = added[i].fd_;
+        if (epoll_ctl(queue_, EPOLL_CTL_ADD, added[i].fd_, &event) == -1 && errno == EEXIST)
+            epoll_ctl(queue_, EPOLL_CTL_MOD, added[i].fd_, &event);
+    }
+#endif
+}
+
+// rfbUpdateClient() sends an update (or a deferred pointer event) only
+// once the defer time has passed since it first saw it pending, so that
+// is when we need to come back; and Flush() must get to look at a queue
+// before rfbMaxClientWait has passed without any of it going out
+
+int VNCReactor::Timeout() {
+    bool pending(false);
+    uint64_t moved(0);
+
+    rfbClientIteratorPtr iterator(rfbGetClientIterator(screen_));
+    while (rfbClientPtr client = rfbClientIteratorNext(iterator)) {
+        if (client->sock == -1 || client->onHold)
+            continue;
+
+        if (VNCQueue *queue = VNCQueueOf(client)) {
+            LOCK(client->outputMutex);
+            if (queue->Size() != 0 && (moved == 0 || queue->Moved() < moved))
+                moved = queue->Moved();
+            UNLOCK(client->outputMutex);
+        }
+
+        if (pending)
+            continue;
+
+        if (!client->viewOnly && client->lastPtrX >= 0)
+            pending = true;
+        else {
+            LOCK(client->updateMutex);
+            pending = FB_UPDATE_PENDING(client) && !sraRgnEmpty(client->requestedRegion);
+            UNLOCK(client->updateMutex);
+        }
+    }
+    rfbReleaseClientIterator(iterator);
+
+    int timeout(-1);
+    if (pending)
+        timeout = std::max(screen_->deferUpdateTime, screen_->deferPtrUpdateTime) + 1;
+
+    if (moved != 0) {
+        uint64_t elapsed((VNCMicroseconds() - moved) / 1000);
+        int left(elapsed >= uint64_t(rfbMaxClientWait) ? 0 : rfbMaxClientWait - int(elapsed) + 1);
+        if (timeout == -1 || left < timeout)
+            timeout = left;
+    }
+
+    return timeout;
+}
+
+// a socket is looked up in watched_, which Sync() left with one entry per
+// socket; what is only writable is left to Flush()
+
+void VNCReactor::Wait(int timeout) {
+    bool woken(false);
+    ready_.clear();
+    listening_ = false;
+
+#ifdef __APPLE__
+    struct kevent events[Events];
+    struct timespec limit = {timeout / 1000, timeout % 1000 * 1000000};
+    int count(kevent(queue_, NULL, 0, events, Events, timeout == -1 ? NULL : &limit));
+#else
+    struct epoll_event events[Events];
+    int count(epoll_wait(queue_, events, Events, timeout));
+#endif
+
+    for (int i(0); i < count; ++i) {
+#ifdef __APPLE__
+        if (events[i].filter != EVFILT_READ)
+            continue;
+        int fd(events[i].ident);
+#else
+        if ((events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) == 0)
+            continue;
+        int fd(events[i].data.fd);
+#endif
+
+        if (fd == wake_[0]) {
+            woken = true;
+            continue;
+        }
+
+        Watch watch = {fd, NULL, false};
+        std::vector<Watch>::const_iterator found(std::lower_bound(watched_.begin(), watched_.end(), watch));
+        if (found == watched_.end() || found->fd_ != fd)
+            continue;
+        if (found->client_ == NULL)
+            listening_ = true;
+        else
+            ready_.push_back(found->client_);
+    }
+
+    if (woken) {
+        char bytes[64];
+        while (read(wake_[0], bytes, sizeof(bytes)) > 0);
+    }
+}
+
+// rfbProcessEvents(), less its select() over every socket: a ready client
+// gets its message read, and a ready listener goes through rfbCheckFds(),
+// which takes care of any ready client as well; after which every client
+// gets rfbUpdateClient(), which costs nothing without an update due
+
+// XXX: a websockets client that left data in its buffer is not ready by
+// its socket, which rfbCheckFds() looks for but this does not
+
+void VNCReactor::Dispatch() {
+    if (listening_) {
+        rfbCheckFds(screen_, 0);
+        rfbHttpCheckFds(screen_);
+    } else
+        for (size_t i(0); i != ready_.size(); ++i) {
+            rfbClientPtr client(ready_[i]);
+            if (client->sock != -1 && !client->onHold)
+                rfbProcessClientMessage(client);
+        }
+
+    rfbClientIteratorPtr iterator(rfbGetClientIteratorWithClosed(screen_));
+    rfbClientPtr client(rfbClientIteratorNext(iterator));
+    while (client != NULL) {
+        rfbUpdateClient(client);
+        rfbClientPtr last(client);
+        client = rfbClientIteratorNext(iterator);
+        if (last->sock == -1)
+            rfbClientConnectionGone(last);
+    }
+    rfbReleaseClientIterator(iterator);
+}
+
+void *VNCReactor::Run(void *arg) {
+    VNCReactor *reactor(reinterpret_cast<VNCReactor *>(arg));
+    rfbScreenInfoPtr screen(reactor->screen_);
+
+    while (reactor->running_ && rfbIsActive(screen)) {
+        reactor->Apply();
+        reactor->Sync();
+        reactor->Wait(reactor->Timeout());
+        reactor->Flush();
+        reactor->Dispatch();
+    }
+
+    return NULL;
+}
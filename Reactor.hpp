@@ -0,0 +1,116 @@
+/* Veency - VNC Remote Access Server for iPhoneOS
+ * Copyright (C) 2008-2014  Jay Freeman (saurik)
+*/
+
+/* GNU Affero General Public License, Version 3 {{{ */
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+/* }}} */
+
+
+#ifndef VEENCY_REACTOR_HPP
+#define VEENCY_REACTOR_HPP
+
+#include <pthread.h>
+
+#include <rfb/rfb.h>
+
+#include <vector>
+
+// one thread serving every client through libvncserver's own non-threaded
+// pieces, which only ever get called once something is ready: a socket
+// (watched with kqueue, or epoll on Linux), a Wake() from whoever marks the
+// framebuffer modified, or an update due after deferUpdateTime; only the
+// clients whose sockets are ready get read from
+
+// nothing here may wait on any one client: sockets are non-blocking, what
+// a socket will not take waits in the client's VNCQueue (see VNCQueueHook)
+// until it is writable, and clients left on hold by newClientHook are not
+// watched at all until Answer()
+
+class VNCReactor {
+  private:
+    rfbScreenInfoPtr screen_;
+    pthread_t thread_;
+    volatile bool running_;
+
+    int queue_;
+    int wake_[2];
+
+    // what is registered with queue_; a client is part of the identity,
+    // as a closed socket leaves the queue by itself and its number may be
+    // reused for the next one
+    struct Watch {
+        int fd_;
+        rfbClientPtr client_;
+
+        // whether output is queued, which also needs the socket writable
+        bool output_;
+
+        bool operator <(const Watch &rhs) const {
+            return fd_ < rhs.fd_ || (fd_ == rhs.fd_ && (client_ < rhs.client_ || (client_ == rhs.client_ && output_ < rhs.output_)));
+        }
+
+        bool operator ==(const Watch &rhs) const {
+            return fd_ == rhs.fd_ && client_ == rhs.client_ && output_ == rhs.output_;
+        }
+    };
+
+    std::vector<Watch> watched_;
+
+    // what the last Wait() found readable: clients, and whether anything
+    // else (a listener, or the http connection) was
+    std::vector<rfbClientPtr> ready_;
+    bool listening_;
+
+    struct Decision {
+        rfbClientPtr client_;
+        bool accept_;
+    };
+
+    // Answer()s yet to be applied, under mutex_
+    pthread_mutex_t mutex_;
+    std::vector<Decision> decisions_;
+
+    static void *Run(void *arg);
+
+    void Signal();
+
+    void Apply();
+    void Flush();
+    void Sync();
+    int Timeout();
+    void Wait(int timeout);
+    void Dispatch();
+
+  public:
+    VNCReactor();
+
+    bool Running() const {
+        return running_;
+    }
+
+    // the server must have been through rfbInitServer()
+    bool Start(rfbScreenInfoPtr screen);
+    void Stop();
+
+    void Wake();
+
+    // starts (or refuses) a client that newClientHook left on hold; this is
+    // done on the reactor's thread, which owns the clients
+    void Answer(rfbClientPtr client, bool accept);
+};
+
+#endif//VEENCY_REACTOR_HPP
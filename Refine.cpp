@@ -0,0 +1,118 @@
+/* Veency - VNC Remote Access Server for iPhoneOS
+ * Copyright (C) 2008-2014  Jay Freeman (saurik)
+*/
+
+/* GNU Affero General Public License, Version 3 {{{ */
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+/* }}} */
+
+
+#include <string.h>
+
+#include <algorithm>
+
+#include "Refine.hpp"
+
+VNCQuiet::VNCQuiet() :
+    width_(0),
+    height_(0),
+    columns_(0),
+    rows_(0),
+    changed_(NULL)
+{
+}
+
+VNCQuiet::~VNCQuiet() {
+    delete [] changed_;
+}
+
+void VNCQuiet::Resize(size_t width, size_t height) {
+    width_ = width;
+    height_ = height;
+
+    columns_ = (width + TileSize - 1) / TileSize;
+    rows_ = (height + TileSize - 1) / TileSize;
+
+    delete [] changed_;
+    changed_ = new uint64_t[columns_ * rows_];
+    memset(changed_, 0, columns_ * rows_ * sizeof(uint64_t));
+}
+
+void VNCQuiet::Update(const VNCDamage &damage, uint64_t now) {
+    for (size_t row(0); row != rows_; ++row)
+        for (size_t column(0); column != columns_; ++column)
+            if (damage.Dirty(column, row))
+                changed_[row * columns_ + column] = now;
+}
+
+// the history's cells are the damage's tiles; anything past the history's
+// reach was never marked lossy, and so never needs refining, and the cells
+// along the right and bottom edges end where the screen does
+
+bool VNCRefinable(VNCTightHistory &history, const VNCQuiet &quiet, uint64_t before, sraRegionPtr region) {
+    size_t columns(std::min<size_t>(quiet.columns_, VNCTightHistory::Columns));
+    size_t rows(std::min<size_t>(quiet.rows_, VNCTightHistory::Rows));
+    bool pending(false);
+
+    for (size_t row(0); row != rows; ++row)
+        for (size_t column(0); column != columns; ++column) {
+            if (!history.lossy_[row][column])
+                continue;
+            if (quiet.changed_[row * quiet.columns_ + column] > before) {
+                pending = true;
+                continue;
+            }
+
+            history.refine_[row][column] = true;
+
+            size_t x(column * TileSize), y(row * TileSize);
+            sraRegionPtr cell(sraRgnCreateRect(x, y, std::min(x + TileSize, quiet.width_), std::min(y + TileSize, quiet.height_)));
+            sraRgnOr(region, cell);
+            sraRgnDestroy(cell);
+        }
+
+    return pending;
+}
+
+void VNCLossy(const VNCTightHistory &history, size_t width, size_t height, sraRegionPtr region) {
+    size_t columns(std::min<size_t>((width + TileSize - 1) / TileSize, VNCTightHistory::Columns));
+    size_t rows(std::min<size_t>((height + TileSize - 1) / TileSize, VNCTightHistory::Rows));
+
+    for (size_t row(0); row != rows; ++row)
+        for (size_t column(0); column != columns; ++column) {
+            if (!history.lossy_[row][column])
+                continue;
+
+            size_t x(column * TileSize), y(row * TileSize);
+            sraRegionPtr cell(sraRgnCreateRect(x, y, std::min(x + TileSize, width), std::min(y + TileSize, height)));
+            sraRgnOr(region, cell);
+            sraRgnDestroy(cell);
+        }
+}
+
+bool VNCRefining(const VNCTightHistory &history, int x, int y, int w, int h) {
+    int left(x >> VNCTightHistory::CellBits), right((x + w - 1) >> VNCTightHistory::CellBits);
+    int top(y >> VNCTightHistory::CellBits), bottom((y + h - 1) >> VNCTightHistory::CellBits);
+    if (right >= VNCTightHistory::Columns || bottom >= VNCTightHistory::Rows)
+        return false;
+
+    for (int row(top); row <= bottom; ++row)
+        for (int column(left); column <= right; ++column)
+            if (!history.refine_[row][column])
+                return false;
+
+    return true;
+}
@@ -0,0 +1,55 @@
+/* Veency - VNC Remote Access Server for iPhoneOS
+ * Copyright (C) 2008-2014  Jay Freeman (saurik)
+*/
+
+/* GNU Affero General Public License, Version 3 {{{ */
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+/* }}} */
+
+
+#ifndef VEENCY_REFINE_HPP
+#define VEENCY_REFINE_HPP
+
+#include "Damage.hpp"
+#include "Tight.hpp"
+
+// when each tile of the screen last changed, as seen by the capture thread
+struct VNCQuiet {
+    size_t width_, height_;
+    size_t columns_, rows_;
+
+    uint64_t *changed_;
+
+    VNCQuiet();
+    ~VNCQuiet();
+
+    void Resize(size_t width, size_t height);
+    void Update(const VNCDamage &damage, uint64_t now);
+};
+
+// adds each cell the client got lossy and that has not changed since
+// before to region, flagging it so the next send of it is lossless; true
+// if lossy cells are left that changed too recently to be refined yet
+bool VNCRefinable(VNCTightHistory &history, const VNCQuiet &quiet, uint64_t before, sraRegionPtr region);
+
+// adds each cell the client last got lossy to region, as far as it is on
+// a width x height screen
+void VNCLossy(const VNCTightHistory &history, size_t width, size_t height, sraRegionPtr region);
+
+// whether every cell of the rect is flagged for refinement
+bool VNCRefining(const VNCTightHistory &history, int x, int y, int w, int h);
+
+#endif//VEENCY_REFINE_HPP
@@ -0,0 +1,233 @@
+/* Veency - VNC Remote Access Server for iPhoneOS
+ * Copyright (C) 2008-2014  Jay Freeman (saurik)
+*/
+
+/* GNU Affero General Public License, Version 3 {{{ */
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+/* }}} */
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "Scale.hpp"
+
+static const size_t BytesPerPixel = 4;
+
+static void Box(const uint8_t *in, size_t stride, uint8_t *out, size_t x, size_t width, unsigned factor) {
+    unsigned count(factor * factor);
+
+    for (; x != width; ++x)
+        for (size_t c(0); c != BytesPerPixel; ++c) {
+            unsigned sum(count / 2);
+            for (unsigned r(0); r != factor; ++r)
+                for (unsigned i(0); i != factor; ++i)
+                    sum += in[r * stride + (x * factor + i) * BytesPerPixel + c];
+            out[x * BytesPerPixel + c] = sum / count;
+        }
+}
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+
+// vld4 splits 16 pixels into one vector per channel, so neighbouring pixels
+// become neighbouring lanes that vpaddl can sum into 16-bit accumulators
+
+static size_t Half(const uint8_t *in, size_t stride, uint8_t *out, size_t width) {
+    size_t x(0);
+
+    for (; x + 8 <= width; x += 8) {
+        uint8x16x4_t a(vld4q_u8(in + x * 8));
+        uint8x16x4_t b(vld4q_u8(in + stride + x * 8));
+
+        uint8x8x4_t o;
+        for (unsigned c(0); c != 4; ++c)
+            o.val[c] = vrshrn_n_u16(vaddq_u16(vpaddlq_u8(a.val[c]), vpaddlq_u8(b.val[c])), 2);
+        vst4_u8(out + x * 4, o);
+    }
+
+    return x;
+}
+
+static size_t Quarter(const uint8_t *in, size_t stride, uint8_t *out, size_t width) {
+    size_t x(0);
+
+    for (; x + 8 <= width; x += 8) {
+        uint16x8_t lo[4], hi[4];
+        for (unsigned c(0); c != 4; ++c)
+            lo[c] = hi[c] = vdupq_n_u16(0);
+
+        for (unsigned r(0); r != 4; ++r) {
+            uint8x16x4_t a(vld4q_u8(in + r * stride + x * 16));
+            uint8x16x4_t b(vld4q_u8(in + r * stride + x * 16 + 64));
+            for (unsigned c(0); c != 4; ++c) {
+                lo[c] = vaddq_u16(lo[c], vpaddlq_u8(a.val[c]));
+                hi[c] = vaddq_u16(hi[c], vpaddlq_u8(b.val[c]));
+            }
+        }
+
+        uint8x8x4_t o;
+        for (unsigned c(0); c != 4; ++c)
+            o.val[c] = vrshrn_n_u16(vcombine_u16(
+                vpadd_u16(vget_low_u16(lo[c]), vget_high_u16(lo[c])),
+                vpadd_u16(vget_low_u16(hi[c]), vget_high_u16(hi[c]))
+            ), 4);
+        vst4_u8(out + x * 4, o);
+    }
+
+    return x;
+}
+
+#elif defined(__SSE2__)
+
+// widened to 16 bits, a register holds two pixels; adding its two halves
+// together sums a horizontal pair, which is all these need per output
+
+static inline __m128i Load(const uint8_t *data) {
+    return _mm_loadu_si128(reinterpret_cast<const __m128i *>(data));
+}
+
+static inline __m128i Pairs(__m128i lhs, __m128i rhs) {
+    return _mm_add_epi16(_mm_unpacklo_epi64(lhs, rhs), _mm_unpackhi_epi64(lhs, rhs));
+}
+
+static size_t Half(const uint8_t *in, size_t stride, uint8_t *out, size_t width) {
+    __m128i zero(_mm_setzero_si128());
+    __m128i two(_mm_set1_epi16(2));
+
+    size_t x(0);
+
+    for (; x + 4 <= width; x += 4) {
+        __m128i sums[4];
+        for (unsigned i(0); i != 2; ++i) {
+            __m128i a(Load(in + x * 8 + i * 16));
+            __m128i b(Load(in + stride + x * 8 + i * 16));
+            sums[i * 2 + 0] = _mm_add_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero));
+            sums[i * 2 + 1] = _mm_add_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero));
+        }
+
+        __m128i lo(_mm_srli_epi16(_mm_add_epi16(Pairs(sums[0], sums[1]), two), 2));
+        __m128i hi(_mm_srli_epi16(_mm_add_epi16(Pairs(sums[2], sums[3]), two), 2));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out + x * 4), _mm_packus_epi16(lo, hi));
+    }
+
+    return x;
+}
+
+static size_t Quarter(const uint8_t *in, size_t stride, uint8_t *out, size_t width) {
+    __m128i zero(_mm_setzero_si128());
+    __m128i eight(_mm_set1_epi16(8));
+
+    size_t x(0);
+
+    for (; x + 4 <= width; x += 4) {
+        __m128i sums[8];
+        for (unsigned i(0); i != 8; ++i)
+            sums[i] = zero;
+
+        for (unsigned r(0); r != 4; ++r)
+            for (unsigned i(0); i != 4; ++i) {
+                __m128i a(Load(in + r * stride + x * 16 + i * 16));
+                sums[i * 2 + 0] = _mm_add_epi16(sums[i * 2 + 0], _mm_unpacklo_epi8(a, zero));
+                sums[i * 2 + 1] = _mm_add_epi16(sums[i * 2 + 1], _mm_unpackhi_epi8(a, zero));
+            }
+
+        __m128i quads[4];
+        for (unsigned i(0); i != 4; ++i)
+            quads[i] = _mm_add_epi16(sums[i * 2 + 0], sums[i * 2 + 1]);
+
+        __m128i lo(_mm_srli_epi16(_mm_add_epi16(Pairs(quads[0], quads[1]), eight), 4));
+        __m128i hi(_mm_srli_epi16(_mm_add_epi16(Pairs(quads[2], quads[3]), eight), 4));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out + x * 4), _mm_packus_epi16(lo, hi));
+    }
+
+    return x;
+}
+
+#else
+
+static size_t Half(const uint8_t *, size_t, uint8_t *, size_t) {
+    return 0;
+}
+
+static size_t Quarter(const uint8_t *, size_t, uint8_t *, size_t) {
+    return 0;
+}
+
+#endif
+
+void VNCDownscale(const uint8_t *src, size_t stride, uint8_t *dst, size_t pitch, size_t width, size_t height, unsigned factor) {
+    for (size_t y(0); y != height; ++y) {
+        const uint8_t *in(src + y * factor * stride);
+        uint8_t *out(dst + y * pitch);
+
+        size_t x;
+        if (factor == 2)
+            x = Half(in, stride, out, width);
+        else if (factor == 4)
+            x = Quarter(in, stride, out, width);
+        else
+            x = 0;
+
+        Box(in, stride, out, x, width, factor);
+    }
+}
+
+VNCScaler::VNCScaler() :
+    width_(0),
+    height_(0),
+    factor_(1)
+{
+}
+
+VNCScaler::~VNCScaler() {
+}
+
+bool VNCScaler::Resize(size_t width, size_t height, unsigned factor) {
+    width_ = width;
+    height_ = height;
+    factor_ = factor;
+    return true;
+}
+
+VNCSoftwareScaler::VNCSoftwareScaler() :
+    buffer_(NULL)
+{
+}
+
+VNCSoftwareScaler::~VNCSoftwareScaler() {
+    delete [] buffer_;
+}
+
+bool VNCSoftwareScaler::Resize(size_t width, size_t height, unsigned factor) {
+    VNCScaler::Resize(width, height, factor);
+
+    delete [] buffer_;
+    buffer_ = factor == 1 ? NULL : new uint8_t[width * height * BytesPerPixel];
+    return true;
+}
+
+const uint8_t *VNCSoftwareScaler::Scale(void *, const uint8_t *data, size_t stride, size_t &pitch) {
+    if (factor_ == 1) {
+        pitch = stride;
+        return data;
+    }
+
+    pitch = width_ * BytesPerPixel;
+    VNCDownscale(data, stride, buffer_, pitch, width_, height_, factor_);
+    return buffer_;
+}
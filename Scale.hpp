@@ -0,0 +1,63 @@
+/* Veency - VNC Remote Access Server for iPhoneOS
+ * Copyright (C) 2008-2014  Jay Freeman (saurik)
+*/
+
+/* GNU Affero General Public License, Version 3 {{{ */
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+/* }}} */
+
+#ifndef VEENCY_SCALE_HPP
+#define VEENCY_SCALE_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+
+// box-filters a 32-bit frame down by factor in each direction; width and
+// height are those of the destination, and src must cover factor times that
+void VNCDownscale(const uint8_t *src, size_t stride, uint8_t *dst, size_t pitch, size_t width, size_t height, unsigned factor);
+
+// turns a full-size frame into one of the size VNCCapture was given; data
+// and stride are the frame's pixels, which backends that can read surface
+// directly (such as the 2D engine) are free to ignore
+
+struct VNCScaler {
+    size_t width_;
+    size_t height_;
+    unsigned factor_;
+
+    VNCScaler();
+    virtual ~VNCScaler();
+
+    // returns false if this backend cannot produce frames of this size
+    virtual bool Resize(size_t width, size_t height, unsigned factor);
+
+    // returns the frame and its pitch, valid until the next call, or NULL
+    virtual const uint8_t *Scale(void *surface, const uint8_t *data, size_t stride, size_t &pitch) = 0;
+};
+
+struct VNCSoftwareScaler :
+    public VNCScaler
+{
+    uint8_t *buffer_;
+
+    VNCSoftwareScaler();
+    virtual ~VNCSoftwareScaler();
+
+    virtual bool Resize(size_t width, size_t height, unsigned factor);
+    virtual const uint8_t *Scale(void *surface, const uint8_t *data, size_t stride, size_t &pitch);
+};
+
+#endif//VEENCY_SCALE_HPP
@@ -0,0 +1,306 @@
+/* Veency - VNC Remote Access Server for iPhoneOS
+ * Copyright (C) 2008-2014  Jay Freeman (saurik)
+*/
+
+/* GNU Affero General Public License, Version 3 {{{ */
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+/* }}} */
+
+
+#include <string.h>
+
+#include <algorithm>
+
+#include "Scroll.hpp"
+
+static const size_t BytesPerPixel = 4;
+
+// a shift needs this many segments agreeing on it, and a copy this many
+// rows (or columns), to be worth more than just encoding the pixels
+static const size_t MinVotes = 32;
+static const size_t MinRun = 32;
+
+static const int32_t Empty = -1;
+static const int32_t Ambiguous = -2;
+
+static inline uint64_t Mix(uint64_t hash, uint32_t pixel) {
+    return (hash ^ pixel) * 0x100000001b3ull;
+}
+
+static inline size_t Slot(uint64_t hash, size_t mask) {
+    return (hash ^ hash >> 29) * 0x9e3779b97f4a7c15ull >> 32 & mask;
+}
+
+VNCScroll::VNCScroll() :
+    width_(0),
+    height_(0),
+    columns_(0),
+    rows_(0),
+    rects_(NULL),
+    count_(0),
+    dx_(0),
+    dy_(0),
+    keys_(NULL),
+    values_(NULL),
+    mask_(0),
+    votes_(NULL),
+    lanes_(NULL)
+{
+    for (unsigned i(0); i != 2; ++i) {
+        across_[i] = NULL;
+        down_[i] = NULL;
+    }
+}
+
+VNCScroll::~VNCScroll() {
+    for (unsigned i(0); i != 2; ++i) {
+        delete [] across_[i];
+        delete [] down_[i];
+    }
+
+    delete [] rects_;
+    delete [] keys_;
+    delete [] values_;
+    delete [] votes_;
+    delete [] lanes_;
+}
+
+void VNCScroll::Resize(size_t width, size_t height) {
+    width_ = width;
+    height_ = height;
+
+    columns_ = (width + TileSize - 1) / TileSize;
+    rows_ = (height + TileSize - 1) / TileSize;
+
+    // hashes of an all-black frame never match anything that moved, so
+    // zero stands in until each tile has been seen for real
+    for (unsigned i(0); i != 2; ++i) {
+        delete [] across_[i];
+        across_[i] = new uint64_t[columns_ * height];
+        memset(across_[i], 0, columns_ * height * sizeof(uint64_t));
+
+        delete [] down_[i];
+        down_[i] = new uint64_t[rows_ * width];
+        memset(down_[i], 0, rows_ * width * sizeof(uint64_t));
+    }
+
+    size_t length(std::max(width, height));
+
+    delete [] rects_;
+    rects_ = new VNCRect[columns_ + rows_];
+    count_ = 0;
+
+    size_t size(1);
+    while (size < length * 2)
+        size <<= 1;
+    mask_ = size - 1;
+
+    delete [] keys_;
+    keys_ = new uint64_t[size];
+    delete [] values_;
+    values_ = new int32_t[size];
+
+    delete [] votes_;
+    votes_ = new uint32_t[length * 2];
+
+    delete [] lanes_;
+    lanes_ = new bool[std::max(columns_, rows_)];
+}
+
+// one pass over the tile yields both its row and its column segments
+void VNCScroll::Hash(const uint8_t *frame, size_t pitch, size_t column, size_t row) {
+    size_t left(column * TileSize), right(std::min(left + TileSize, width_));
+    size_t top(row * TileSize), bottom(std::min(top + TileSize, height_));
+
+    uint64_t *across(across_[1] + column * height_);
+    uint64_t *down(down_[1] + row * width_);
+
+    for (size_t x(left); x != right; ++x)
+        down[x] = 0xcbf29ce484222325ull;
+
+    for (size_t y(top); y != bottom; ++y) {
+        const uint32_t *pixels(reinterpret_cast<const uint32_t *>(frame + y * pitch));
+        uint64_t hash(0xcbf29ce484222325ull);
+        for (size_t x(left); x != right; ++x) {
+            uint32_t pixel(pixels[x] & 0x00ffffff);
+            hash = Mix(hash, pixel);
+            down[x] = Mix(down[x], pixel);
+        }
+        across[y] = hash;
+    }
+}
+
+// every changed segment whose old content sat uniquely somewhere else in
+// the same lane votes for that distance; the favorite has to be clear
+int VNCScroll::Vote(const uint64_t *before, const uint64_t *after, size_t length, const bool *lanes, size_t count) {
+    memset(votes_, 0, length * 2 * sizeof(uint32_t));
+
+    for (size_t lane(0); lane != count; ++lane) {
+        if (!lanes[lane])
+            continue;
+
+        const uint64_t *old(before + lane * length);
+        const uint64_t *now(after + lane * length);
+
+        memset(values_, 0xff, (mask_ + 1) * sizeof(int32_t));
+        for (size_t i(0); i != length; ++i) {
+            size_t slot(Slot(old[i], mask_));
+            while (values_[slot] != Empty && keys_[slot] != old[i])
+                slot = (slot + 1) & mask_;
+            keys_[slot] = old[i];
+            values_[slot] = values_[slot] == Empty ? int32_t(i) : Ambiguous;
+        }
+
+        for (size_t i(0); i != length; ++i) {
+            if (now[i] == old[i])
+                continue;
+
+            size_t slot(Slot(now[i], mask_));
+            while (values_[slot] != Empty && keys_[slot] != now[i])
+                slot = (slot + 1) & mask_;
+            if (values_[slot] >= 0)
+                ++votes_[i - values_[slot] + length];
+        }
+    }
+
+    size_t best(length);
+    for (size_t shift(0); shift != length * 2; ++shift)
+        if (votes_[shift] > votes_[best])
+            best = shift;
+
+    return votes_[best] < MinVotes ? 0 : int(best) - int(length);
+}
+
+// whether rect of frame really is what sat at (-dx, -dy) from it in prev
+bool VNCScroll::Same(const uint8_t *prev, const uint8_t *frame, size_t pitch, const VNCRect &rect, int dx, int dy) {
+    for (size_t y(rect.y); y != rect.y + rect.h; ++y)
+        if (memcmp(frame + y * pitch + rect.x * BytesPerPixel, prev + (y - dy) * pitch + (rect.x - dx) * BytesPerPixel, rect.w * BytesPerPixel) != 0)
+            return false;
+    return true;
+}
+
+// in each lane, the longest stretch that moved by shift and did change; a
+// hash collision would have the viewer copy the wrong pixels, so a run is
+// only kept if the frames agree
+void VNCScroll::Runs(const uint8_t *prev, const uint8_t *frame, size_t pitch, const uint64_t *before, const uint64_t *after, size_t length, const bool *lanes, size_t count, int shift, bool vertical) {
+    size_t begin(std::max(shift, 0));
+    size_t end(length - std::max(-shift, 0));
+
+    for (size_t lane(0); lane != count; ++lane) {
+        if (!lanes[lane])
+            continue;
+
+        const uint64_t *old(before + lane * length);
+        const uint64_t *now(after + lane * length);
+
+        size_t start(0), size(0);
+        for (size_t i(begin); i != end; ) {
+            if (now[i] != old[i - shift]) {
+                ++i;
+                continue;
+            }
+
+            size_t from(i);
+            bool moved(false);
+            for (; i != end && now[i] == old[i - shift]; ++i)
+                moved = moved || now[i] != old[i];
+
+            if (moved && i - from > size) {
+                start = from;
+                size = i - from;
+            }
+        }
+
+        if (size < MinRun)
+            continue;
+        size_t offset(lane * TileSize);
+
+        VNCRect &rect(rects_[count_]);
+        if (vertical) {
+            rect.x = offset;
+            rect.w = std::min(offset + TileSize, width_) - offset;
+            rect.y = start;
+            rect.h = size;
+        } else {
+            rect.x = start;
+            rect.w = size;
+            rect.y = offset;
+            rect.h = std::min(offset + TileSize, height_) - offset;
+        }
+
+        if (Same(prev, frame, pitch, rect, vertical ? 0 : shift, vertical ? shift : 0))
+            ++count_;
+    }
+}
+
+size_t VNCScroll::Detect(const uint8_t *prev, const uint8_t *frame, size_t pitch, const VNCDamage &damage) {
+    for (size_t row(0); row != rows_; ++row)
+        for (size_t column(0); column != columns_; ++column)
+            if (damage.Dirty(column, row))
+                Hash(frame, pitch, column, row);
+
+    count_ = 0;
+    dx_ = 0;
+    dy_ = 0;
+
+    // a column of tiles is a lane for vertical motion, a row for horizontal
+    for (size_t column(0); column != columns_; ++column) {
+        lanes_[column] = false;
+        for (size_t row(0); row != rows_ && !lanes_[column]; ++row)
+            lanes_[column] = damage.Dirty(column, row);
+    }
+
+    int dy(prev == NULL ? 0 : Vote(across_[0], across_[1], height_, lanes_, columns_));
+    if (dy != 0)
+        Runs(prev, frame, pitch, across_[0], across_[1], height_, lanes_, columns_, dy, true);
+    size_t vertical(count_);
+
+    for (size_t row(0); row != rows_; ++row) {
+        lanes_[row] = false;
+        for (size_t column(0); column != columns_ && !lanes_[row]; ++column)
+            lanes_[row] = damage.Dirty(column, row);
+    }
+
+    int dx(prev == NULL ? 0 : Vote(down_[0], down_[1], width_, lanes_, rows_));
+    if (dx != 0)
+        Runs(prev, frame, pitch, down_[0], down_[1], width_, lanes_, rows_, dx, false);
+
+    // whichever direction would copy more wins, as there is only one delta
+    size_t across(0), down(0);
+    for (size_t i(0); i != count_; ++i)
+        (i < vertical ? across : down) += rects_[i].w * rects_[i].h;
+
+    if (across >= down) {
+        count_ = vertical;
+        dy_ = vertical == 0 ? 0 : dy;
+    } else {
+        count_ -= vertical;
+        memmove(rects_, rects_ + vertical, count_ * sizeof(VNCRect));
+        dx_ = dx;
+    }
+
+    // leave both generations equal again for the next frame
+    for (size_t row(0); row != rows_; ++row)
+        for (size_t column(0); column != columns_; ++column)
+            if (damage.Dirty(column, row)) {
+                size_t top(row * TileSize), bottom(std::min(top + TileSize, height_));
+                size_t left(column * TileSize), right(std::min(left + TileSize, width_));
+                memcpy(across_[0] + column * height_ + top, across_[1] + column * height_ + top, (bottom - top) * sizeof(uint64_t));
+                memcpy(down_[0] + row * width_ + left, down_[1] + row * width_ + left, (right - left) * sizeof(uint64_t));
+            }
+
+    return count_;
+}
@@ -0,0 +1,74 @@
+/* Veency - VNC Remote Access Server for iPhoneOS
+ * Copyright (C) 2008-2014  Jay Freeman (saurik)
+*/
+
+/* GNU Affero General Public License, Version 3 {{{ */
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+/* }}} */
+
+
+#ifndef VEENCY_SCROLL_HPP
+#define VEENCY_SCROLL_HPP
+
+#include "Damage.hpp"
+
+// finds content that moved between two frames as a whole: every dirty tile
+// hashes its rows and its columns, so that a vertical shift shows up as a
+// run of row hashes in one column of tiles that reappear some distance
+// away (and a horizontal one as the same, but across)
+
+struct VNCScroll {
+    size_t width_;
+    size_t height_;
+
+    size_t columns_;
+    size_t rows_;
+
+    // a row of one column of tiles, and a column of one row of tiles
+    uint64_t *across_[2];
+    uint64_t *down_[2];
+
+    // the destinations of whatever moved by dx_, dy_
+    VNCRect *rects_;
+    size_t count_;
+    int dx_, dy_;
+
+    // an open-addressed map of hash to position, and a tally per shift
+    uint64_t *keys_;
+    int32_t *values_;
+    size_t mask_;
+    uint32_t *votes_;
+    bool *lanes_;
+
+    VNCScroll();
+    ~VNCScroll();
+
+    void Resize(size_t width, size_t height);
+
+    // frame is a whole width_ x height_ frame, which damage was computed
+    // against, and prev the one before it (or NULL if it is gone, in which
+    // case nothing is copied); returns the number of rects that can be sent
+    // as copies
+    size_t Detect(const uint8_t *prev, const uint8_t *frame, size_t pitch, const VNCDamage &damage);
+
+  private:
+    void Hash(const uint8_t *frame, size_t pitch, size_t column, size_t row);
+    int Vote(const uint64_t *before, const uint64_t *after, size_t length, const bool *lanes, size_t count);
+    bool Same(const uint8_t *prev, const uint8_t *frame, size_t pitch, const VNCRect &rect, int dx, int dy);
+    void Runs(const uint8_t *prev, const uint8_t *frame, size_t pitch, const uint64_t *before, const uint64_t *after, size_t length, const bool *lanes, size_t count, int shift, bool vertical);
+};
+
+#endif//VEENCY_SCROLL_HPP
@@ -0,0 +1,100 @@
+/* Veency - VNC Remote Access Server for iPhoneOS
+ * Copyright (C) 2008-2014  Jay Freeman (saurik)
+*/
+
+/* GNU Affero General Public License, Version 3 {{{ */
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+/* }}} */
+
+
+#include <stdlib.h>
+
+#include "Slab.hpp"
+
+// the size rides in front of each block, padded to keep it aligned
+union VNCSlabHeader {
+    size_t size_;
+    long double align_;
+};
+
+VNCSlabs::VNCSlabs() :
+    cached_(0),
+    hits_(0),
+    misses_(0)
+{
+    pthread_mutex_init(&mutex_, NULL);
+    for (unsigned i(0); i != Classes; ++i) {
+        classes_[i].size_ = 0;
+        classes_[i].count_ = 0;
+    }
+}
+
+void *VNCSlabs::Allocate(size_t size) {
+    VNCSlabHeader *header(NULL);
+
+    pthread_mutex_lock(&mutex_);
+    for (unsigned i(0); i != Classes; ++i) {
+        Class &entry(classes_[i]);
+        if (entry.size_ == size && entry.count_ != 0) {
+            header = reinterpret_cast<VNCSlabHeader *>(entry.blocks_[--entry.count_]);
+            cached_ -= size;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&mutex_);
+
+    if (header != NULL)
+        __sync_add_and_fetch(&hits_, 1);
+    else {
+        __sync_add_and_fetch(&misses_, 1);
+        header = reinterpret_cast<VNCSlabHeader *>(malloc(sizeof(VNCSlabHeader) + size));
+        if (header == NULL)
+            return NULL;
+        header->size_ = size;
+    }
+
+    return header + 1;
+}
+
+void VNCSlabs::Free(void *data) {
+    if (data == NULL)
+        return;
+
+    VNCSlabHeader *header(reinterpret_cast<VNCSlabHeader *>(data) - 1);
+    size_t size(header->size_);
+
+    pthread_mutex_lock(&mutex_);
+    if (cached_ + size <= Limit) {
+        // prefer the class already holding this size, else any empty one
+        Class *entry(NULL);
+        for (unsigned i(0); i != Classes; ++i)
+            if (classes_[i].size_ == size) {
+                entry = &classes_[i];
+                break;
+            } else if (entry == NULL && classes_[i].count_ == 0)
+                entry = &classes_[i];
+
+        if (entry != NULL && entry->count_ != Depth) {
+            entry->size_ = size;
+            entry->blocks_[entry->count_++] = header;
+            cached_ += size;
+            header = NULL;
+        }
+    }
+    pthread_mutex_unlock(&mutex_);
+
+    free(header);
+}
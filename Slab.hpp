@@ -0,0 +1,64 @@
+/* Veency - VNC Remote Access Server for iPhoneOS
+ * Copyright (C) 2008-2014  Jay Freeman (saurik)
+*/
+
+/* GNU Affero General Public License, Version 3 {{{ */
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+/* }}} */
+
+
+#ifndef VEENCY_SLAB_HPP
+#define VEENCY_SLAB_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <pthread.h>
+
+// keeps freed blocks around by their exact size, so that the next client
+// to connect gets back the very buffers the last one let go of; a handful
+// of distinct sizes are cached, up to Limit bytes in all, and anything
+// beyond that simply goes back to malloc()
+
+class VNCSlabs {
+  private:
+    static const unsigned Classes = 8;
+    // a deflate stream asks for two blocks each of 64KB and 128KB, and a
+    // client has six streams (Tight's four, Zlib and ZRLE)
+    static const unsigned Depth = 16;
+    static const size_t Limit = 4 << 20;
+
+    struct Class {
+        size_t size_;
+        unsigned count_;
+        void *blocks_[Depth];
+    };
+
+    pthread_mutex_t mutex_;
+    Class classes_[Classes];
+    size_t cached_;
+
+  public:
+    volatile uint64_t hits_;
+    volatile uint64_t misses_;
+
+    VNCSlabs();
+
+    void *Allocate(size_t size);
+    void Free(void *data);
+};
+
+#endif//VEENCY_SLAB_HPP
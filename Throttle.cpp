@@ -0,0 +1,68 @@
+/* Veency - VNC Remote Access Server for iPhoneOS
+ * Copyright (C) 2008-2014  Jay Freeman (saurik)
+*/
+
+/* GNU Affero General Public License, Version 3 {{{ */
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+/* }}} */
+
+
+#include "Throttle.hpp"
+
+VNCThrottle::VNCThrottle() :
+    bytes_(0),
+    blocked_(0),
+    base_(0),
+    clear_(0),
+    limit_(Levels - 1),
+    rate_(0)
+{
+}
+
+void VNCThrottle::Wrote(size_t bytes, uint64_t elapsed) {
+    __sync_add_and_fetch(&bytes_, bytes);
+    __sync_add_and_fetch(&blocked_, elapsed);
+}
+
+size_t VNCThrottle::Budget() const {
+    uint64_t budget(rate_ * Window / 1000000);
+    return budget < Minimum ? Minimum : budget;
+}
+
+bool VNCThrottle::Update(uint64_t bytes, uint64_t blocked, uint64_t busy, uint64_t deliver) {
+    if (base_ == 0 || deliver < base_)
+        base_ = deliver;
+    else
+        base_ += (deliver - base_) / 256;
+
+    if (busy + deliver != 0) {
+        uint64_t rate(bytes * 1000000 / (busy + deliver));
+        rate_ = rate_ == 0 ? rate : (rate_ * 7 + rate) / 8;
+    }
+
+    if (blocked * 2 > busy || deliver > base_ * 2 + Slack) {
+        limit_ = limit_ < 2 ? 0 : limit_ - 2;
+        clear_ = 0;
+        return false;
+    }
+
+    if (++clear_ < Steady || limit_ == Levels - 1)
+        return false;
+
+    ++limit_;
+    clear_ = 0;
+    return true;
+}
@@ -0,0 +1,87 @@
+/* Veency - VNC Remote Access Server for iPhoneOS
+ * Copyright (C) 2008-2014  Jay Freeman (saurik)
+*/
+
+/* GNU Affero General Public License, Version 3 {{{ */
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+/* }}} */
+
+
+#ifndef VEENCY_THROTTLE_HPP
+#define VEENCY_THROTTLE_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+
+// a per-client loop on the highest JPEG quality level we let it have: an
+// update that spent much of its time blocked in write(), or that took far
+// longer than usual to be asked past, means the link is full, and costs
+// two levels at once; enough clean updates in a row earn one level back
+
+// XXX: at level 0 this could step the scale down as well, but the scale is
+// the capture ring's, shared by every client and only changed while none
+// is connected; libvncserver's per-client scaledScreen would put Tight's
+// rects in other coordinates than VNCMotion, VNCScroll and the refinement
+// history use, and needs viewers that take NewFBSize mid-session
+
+class VNCThrottle {
+  public:
+    static const int Levels = 10;
+
+  private:
+    static const unsigned Steady = 8;
+    static const uint64_t Slack = 50000;
+
+    static const size_t Minimum = 64 * 1024;
+    static const uint64_t Window = 100000;
+
+    volatile uint64_t bytes_;
+    volatile uint64_t blocked_;
+
+    // the quickest delivery seen, which drifts back up slowly so that a
+    // change of route is eventually learned: our stand-in for the RTT
+    uint64_t base_;
+    unsigned clear_;
+
+  public:
+    int limit_;
+
+    // bytes per second, smoothed over the last several updates
+    uint64_t rate_;
+
+    VNCThrottle();
+
+    // whoever writes to the socket reports each write and how long it took
+    void Wrote(size_t bytes, uint64_t elapsed);
+
+    uint64_t Bytes() const {
+        return bytes_;
+    }
+
+    uint64_t Blocked() const {
+        return blocked_;
+    }
+
+    // how much may sit unsent in the socket before another update would
+    // only queue up behind it: Window microseconds at rate_, or Minimum
+    size_t Budget() const;
+
+    // one update of bytes, written in busy microseconds (blocked of which
+    // in write()), then delivered; true if this raised the limit
+    bool Update(uint64_t bytes, uint64_t blocked, uint64_t busy, uint64_t deliver);
+};
+
+#endif//VEENCY_THROTTLE_HPP
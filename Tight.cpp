@@ -0,0 +1,536 @@
+/* Veency - VNC Remote Access Server for iPhoneOS
+ * Copyright (C) 2008-2014  Jay Freeman (saurik)
+*/
+
+/* GNU Affero General Public License, Version 3 {{{ */
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+/* }}} */
+
+#include <setjmp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+
+#include <sys/time.h>
+
+// rfb.h defines TRUE as -1, which jpeg-9's enum boolean would not accept;
+// seeing it already defined, jpeglib.h settles for an int boolean instead
+#include "Tight.hpp"
+
+extern "C" {
+#include <jpeglib.h>
+}
+
+#include "Jpeg.hpp"
+#include "Output.hpp"
+
+static const size_t BytesPerPixel = 4;
+
+// these mirror tight.c: rects below MinSplit are not worth splitting, no
+// rect may be wider than MaxWidth or larger than MaxArea, and a tile with
+// at most PaletteColors colors compresses better as a palette than a JPEG
+static const int MinSplit = 4096;
+static const int MaxWidth = 2048;
+static const int MaxArea = 65536;
+static const unsigned PaletteColors = 24;
+
+// a step to the next pixel is smooth if its channels move by at most
+// SmoothStep in all; a tile whose steps are mostly flat or sharp is UI or
+// text, which JPEG smears and zlib handles well, so it is sent lossless
+// unless that region last cost more than Tolerance times what JPEG did
+static const unsigned SmoothStep = 24;
+static const unsigned Tolerance = 2;
+
+// the quality and chroma subsampling TurboVNC uses for each Tight level
+static const int Quality[10] = {15, 29, 41, 42, 62, 77, 79, 86, 92, 100};
+static const bool Subsample[10] = {true, true, true, true, true, true, false, false, false, false};
+
+static inline uint32_t Pixel(const uint8_t *data) {
+    return *reinterpret_cast<const uint32_t *>(data) & 0x00ffffff;
+}
+
+struct VNCJpegError {
+    jpeg_error_mgr manager_;
+    jmp_buf jump_;
+};
+
+static uint64_t VNCMicroseconds() {
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    return uint64_t(now.tv_sec) * 1000000 + now.tv_usec;
+}
+
+static void VNCJpegExit(j_common_ptr cinfo) {
+    longjmp(reinterpret_cast<VNCJpegError *>(cinfo->err)->jump_, 1);
+}
+
+struct VNCTile :
+    public VNCTask
+{
+    enum Kind {
+        Fill,
+        Jpeg,
+        Lossless,
+        Fallback
+    };
+
+    const uint8_t *data_;
+    size_t stride_;
+
+    int x_, y_;
+    int w_, h_;
+
+    int quality_;
+    bool subsample_;
+
+    VNCTileCache *cache_;
+
+    unsigned jpegCost_;
+    unsigned losslessCost_;
+
+    Kind kind_;
+    uint32_t color_;
+
+    unsigned char *jpeg_;
+    unsigned long size_;
+
+    // when set, jpeg_ belongs to it, and is shared with the cache
+    VNCEncoded *encoded_;
+
+    VNCTile() :
+        jpeg_(NULL),
+        size_(0),
+        encoded_(NULL)
+    {
+    }
+
+    virtual ~VNCTile() {
+        if (encoded_ != NULL)
+            encoded_->Release();
+        else
+            free(jpeg_);
+    }
+
+    bool Solid() {
+        color_ = Pixel(data_);
+        for (int y(0); y != h_; ++y) {
+            const uint8_t *row(data_ + y * stride_);
+            for (int x(0); x != w_; ++x)
+                if (Pixel(row + x * BytesPerPixel) != color_)
+                    return false;
+        }
+
+        return true;
+    }
+
+    // a small open-addressed set, abandoned as soon as it overflows
+    bool Few() {
+        uint32_t colors[64];
+        bool used[64] = {false};
+        unsigned count(0);
+
+        for (int y(0); y != h_; ++y) {
+            const uint8_t *row(data_ + y * stride_);
+            for (int x(0); x != w_; ++x) {
+                uint32_t color(Pixel(row + x * BytesPerPixel));
+
+                unsigned slot((color * 2654435761u) >> 26);
+                while (used[slot] && colors[slot] != color)
+                    slot = (slot + 1) & 63;
+                if (used[slot])
+                    continue;
+
+                if (++count > PaletteColors)
+                    return false;
+                used[slot] = true;
+                colors[slot] = color;
+            }
+        }
+
+        return true;
+    }
+
+    // every other row is enough to tell gradients from edges
+    Kind Classify() {
+        size_t steps(0), flat(0), smooth(0);
+
+        for (int y(0); y < h_; y += 2) {
+            const uint8_t *row(data_ + y * stride_);
+            for (int x(1); x < w_; ++x) {
+                const uint8_t *left(row + (x - 1) * BytesPerPixel);
+                const uint8_t *pixel(row + x * BytesPerPixel);
+
+                unsigned step(abs(pixel[0] - left[0]) + abs(pixel[1] - left[1]) + abs(pixel[2] - left[2]));
+                ++steps;
+                if (step == 0)
+                    ++flat;
+                else if (step <= SmoothStep)
+                    ++smooth;
+            }
+        }
+
+        bool photo(flat * 2 < steps && smooth * 2 >= steps - flat);
+        if (photo)
+            return losslessCost_ != 0 && jpegCost_ != 0 && losslessCost_ < jpegCost_ ? Lossless : Jpeg;
+        return losslessCost_ != 0 && jpegCost_ != 0 && losslessCost_ > jpegCost_ * Tolerance ? Jpeg : Lossless;
+    }
+
+    bool Compress() {
+        jpeg_compress_struct cinfo;
+        VNCJpegError error;
+        cinfo.err = jpeg_std_error(&error.manager_);
+        error.manager_.error_exit = &VNCJpegExit;
+
+        if (setjmp(error.jump_)) {
+            jpeg_destroy_compress(&cinfo);
+            return false;
+        }
+
+        jpeg_create_compress(&cinfo);
+        jpeg_mem_dest(&cinfo, &jpeg_, &size_);
+
+        cinfo.image_width = w_;
+        cinfo.image_height = h_;
+        cinfo.input_components = 3;
+        cinfo.in_color_space = JCS_RGB;
+
+        jpeg_set_defaults(&cinfo);
+        jpeg_set_quality(&cinfo, quality_, TRUE);
+
+        if (!subsample_) {
+            cinfo.comp_info[0].h_samp_factor = 1;
+            cinfo.comp_info[0].v_samp_factor = 1;
+        }
+
+        jpeg_start_compress(&cinfo, TRUE);
+
+        if (!VNCJpegInputBGRX(&cinfo)) {
+            jpeg_destroy_compress(&cinfo);
+            return false;
+        }
+
+        // the rows are only ever read, whatever JSAMPROW says
+        while (cinfo.next_scanline != cinfo.image_height) {
+            JSAMPROW rows[DCTSIZE * 2];
+            JDIMENSION count(0);
+            for (JDIMENSION y(cinfo.next_scanline); y != cinfo.image_height && count != DCTSIZE * 2; ++y)
+                rows[count++] = const_cast<uint8_t *>(data_ + y * stride_);
+            jpeg_write_scanlines(&cinfo, rows, count);
+        }
+
+        jpeg_finish_compress(&cinfo);
+        jpeg_destroy_compress(&cinfo);
+
+        return true;
+    }
+
+    // the position is part of the key: a tile is only reused in place
+    bool Encode() {
+        if (cache_ == NULL)
+            return Compress();
+
+        uint64_t seed(uint64_t(x_) << 48 | uint64_t(y_) << 32 | quality_ << 1 | subsample_);
+        uint64_t key(VNCTileCache::Hash(data_, stride_, w_, h_, seed));
+        if ((encoded_ = cache_->Find(key)) != NULL) {
+            jpeg_ = encoded_->data_;
+            size_ = encoded_->size_;
+            return true;
+        }
+
+        uint64_t start(VNCMicroseconds());
+        if (!Compress()) {
+            cache_->Abandon(key);
+            return false;
+        }
+
+        encoded_ = new VNCEncoded(jpeg_, size_);
+        cache_->Insert(key, encoded_, VNCMicroseconds() - start);
+        return true;
+    }
+
+    virtual void Run() {
+        if (Solid())
+            kind_ = Fill;
+        else if (Few())
+            kind_ = Fallback;
+        else if ((kind_ = Classify()) == Jpeg && !Encode())
+            kind_ = Fallback;
+    }
+};
+
+static bool VNCHeader(VNCGather &gather, rfbClientPtr client, const VNCTile &tile) {
+    if (!gather.Reserve(sz_rfbFramebufferUpdateRectHeader))
+        return false;
+
+    rfbFramebufferUpdateRectHeader header;
+    header.r.x = Swap16IfLE(tile.x_);
+    header.r.y = Swap16IfLE(tile.y_);
+    header.r.w = Swap16IfLE(tile.w_);
+    header.r.h = Swap16IfLE(tile.h_);
+    header.encoding = Swap32IfLE(rfbEncodingTight);
+
+    memcpy(client->updateBuf + client->ublen, &header, sz_rfbFramebufferUpdateRectHeader);
+    client->ublen += sz_rfbFramebufferUpdateRectHeader;
+
+    rfbStatRecordEncodingSent(client, rfbEncodingTight, sz_rfbFramebufferUpdateRectHeader, tile.w_ * tile.h_ * (client->format.bitsPerPixel / 8));
+    return true;
+}
+
+static bool VNCSendFill(VNCGather &gather, rfbClientPtr client, const VNCTile &tile) {
+    if (!VNCHeader(gather, client, tile))
+        return false;
+
+    char pixel[1 + 4];
+    size_t size;
+
+    pixel[0] = rfbTightFill << 4;
+
+    const rfbPixelFormat &format(client->format);
+    if (format.depth == 24 && format.redMax == 0xff && format.greenMax == 0xff && format.blueMax == 0xff) {
+        // tight.c's Pack24(): the channels themselves, R G B
+        pixel[1] = tile.color_ >> 16;
+        pixel[2] = tile.color_ >> 8;
+        pixel[3] = tile.color_ >> 0;
+        size = 4;
+    } else {
+        uint32_t color(tile.color_);
+        client->translateFn(client->translateLookupTable, &client->screen->serverFormat, &client->format, reinterpret_cast<char *>(&color), pixel + 1, BytesPerPixel, 1, 1);
+        size = 1 + format.bitsPerPixel / 8;
+    }
+
+    rfbStatRecordEncodingSentAdd(client, rfbEncodingTight, size);
+    return gather.Copy(pixel, size);
+}
+
+// the JPEG itself is not copied, but sent from where it is
+static bool VNCSendJpeg(VNCGather &gather, rfbClientPtr client, const VNCTile &tile) {
+    if (!VNCHeader(gather, client, tile))
+        return false;
+
+    // the control byte, then the length in Tight's 7-bit compact form
+    char prefix[4];
+    size_t size(0);
+
+    prefix[size++] = rfbTightJpeg << 4;
+    prefix[size++] = tile.size_ & 0x7f;
+    if (tile.size_ > 0x7f) {
+        prefix[size - 1] |= 0x80;
+        prefix[size++] = tile.size_ >> 7 & 0x7f;
+        if (tile.size_ > 0x3fff) {
+            prefix[size - 1] |= 0x80;
+            prefix[size++] = tile.size_ >> 14 & 0xff;
+        }
+    }
+
+    rfbStatRecordEncodingSentAdd(client, rfbEncodingTight, size + tile.size_);
+    return gather.Copy(prefix, size) && gather.Refer(tile.jpeg_, tile.size_);
+}
+
+// the mean over the cells a tile touches, if at least half are known
+static unsigned VNCCost(const uint8_t (*costs)[VNCTightHistory::Columns], const VNCTile &tile) {
+    int left(tile.x_ >> VNCTightHistory::CellBits), right(std::min((tile.x_ + tile.w_ - 1) >> VNCTightHistory::CellBits, VNCTightHistory::Columns - 1));
+    int top(tile.y_ >> VNCTightHistory::CellBits), bottom(std::min((tile.y_ + tile.h_ - 1) >> VNCTightHistory::CellBits, VNCTightHistory::Rows - 1));
+
+    unsigned total(0), known(0), cells(0);
+    for (int row(top); row <= bottom; ++row)
+        for (int column(left); column <= right; ++column, ++cells)
+            if (costs[row][column] != 0) {
+                total += costs[row][column];
+                ++known;
+            }
+
+    return known * 2 < cells ? 0 : total / known;
+}
+
+static void VNCCharge(uint8_t (*costs)[VNCTightHistory::Columns], const VNCTile &tile, size_t bytes) {
+    unsigned cost(std::max<size_t>(1, std::min<size_t>(255, bytes * 8 * 16 / (tile.w_ * tile.h_))));
+
+    int left(tile.x_ >> VNCTightHistory::CellBits), right(std::min((tile.x_ + tile.w_ - 1) >> VNCTightHistory::CellBits, VNCTightHistory::Columns - 1));
+    int top(tile.y_ >> VNCTightHistory::CellBits), bottom(std::min((tile.y_ + tile.h_ - 1) >> VNCTightHistory::CellBits, VNCTightHistory::Rows - 1));
+
+    for (int row(top); row <= bottom; ++row)
+        for (int column(left); column <= right; ++column)
+            costs[row][column] = cost;
+}
+
+// a lossy rect taints every cell it touches; a lossless one only clears
+// the cells it covers completely (as far as they are on the screen)
+void VNCTightMark(VNCTightHistory &history, rfbClientPtr client, int x, int y, int w, int h, bool lossy) {
+    int left(x >> VNCTightHistory::CellBits), right(std::min((x + w - 1) >> VNCTightHistory::CellBits, VNCTightHistory::Columns - 1));
+    int top(y >> VNCTightHistory::CellBits), bottom(std::min((y + h - 1) >> VNCTightHistory::CellBits, VNCTightHistory::Rows - 1));
+
+    if (!lossy) {
+        rfbScreenInfoPtr screen(client->scaledScreen);
+        if (x % VNCTightHistory::CellSize != 0)
+            ++left;
+        if (y % VNCTightHistory::CellSize != 0)
+            ++top;
+        if ((x + w) % VNCTightHistory::CellSize != 0 && x + w != screen->width)
+            --right;
+        if ((y + h) % VNCTightHistory::CellSize != 0 && y + h != screen->height)
+            --bottom;
+    }
+
+    for (int row(top); row <= bottom; ++row)
+        for (int column(left); column <= right; ++column) {
+            history.lossy_[row][column] = lossy;
+            history.refine_[row][column] = false;
+        }
+}
+
+rfbBool VNCSendTightAt(VNCSendRect fallback, rfbClientPtr client, int quality, int x, int y, int w, int h) {
+    int requested;
+    for (;;) {
+        requested = client->tightQualityLevel;
+        if (requested == quality)
+            return (*fallback)(client, x, y, w, h);
+        if (__sync_bool_compare_and_swap(&client->tightQualityLevel, requested, quality))
+            break;
+    }
+
+    rfbBool success((*fallback)(client, x, y, w, h));
+    __sync_bool_compare_and_swap(&client->tightQualityLevel, quality, requested);
+    return success;
+}
+
+// tight.c sends true color as JPEG whenever a quality level is set, so we
+// hide it for the duration; its byte count is all we learn of the result
+static bool VNCSendLossless(VNCSendRect fallback, rfbClientPtr client, const VNCTile &tile, size_t &bytes) {
+    rfbStatList *stats(rfbStatLookupEncoding(client, rfbEncodingTight));
+    uint32_t before(stats == NULL ? 0 : stats->bytesSent);
+
+    bool success(VNCSendTightAt(fallback, client, -1, tile.x_, tile.y_, tile.w_, tile.h_));
+
+    stats = rfbStatLookupEncoding(client, rfbEncodingTight);
+    bytes = stats == NULL ? 0 : stats->bytesSent - before;
+    return success;
+}
+
+static int VNCBand(int width) {
+    int band(MaxArea / std::min(width, MaxWidth) / 16 * 16);
+    return band == 0 ? 16 : band;
+}
+
+size_t VNCTightTiles(int width, int height) {
+    int band(VNCBand(width));
+    return size_t((width + MaxWidth - 1) / MaxWidth) * ((height + band - 1) / band);
+}
+
+bool VNCTightParallel(rfbClientPtr client, int quality) {
+    return client->enableLastRectEncoding && quality >= 0 && quality <= 9 && client->format.bitsPerPixel != 8;
+}
+
+rfbBool VNCSendRectTight(VNCPool &pool, VNCTileCache *cache, VNCSendRect fallback, VNCTightHistory &history, rfbClientPtr client, int quality, int x, int y, int w, int h) {
+    // tight.c may well pick JPEG, which we cannot see from here
+    if (!VNCTightParallel(client, quality) || w * h < MinSplit) {
+        VNCTightMark(history, client, x, y, w, h, quality != -1);
+        return VNCSendTightAt(fallback, client, quality, x, y, w, h);
+    }
+
+    rfbScreenInfoPtr screen(client->scaledScreen);
+    const uint8_t *frame(reinterpret_cast<uint8_t *>(screen->frameBuffer));
+    size_t stride(screen->paddedWidthInBytes);
+
+    // a fill has no size limit, so a rect of one color (such as the whole
+    // black screen while the display is off) goes out as one, not per band
+    VNCTile whole;
+    whole.x_ = x;
+    whole.y_ = y;
+    whole.w_ = w;
+    whole.h_ = h;
+    whole.data_ = frame + y * stride + x * BytesPerPixel;
+    whole.stride_ = stride;
+    if (whole.Solid()) {
+        VNCTightMark(history, client, x, y, w, h, false);
+        VNCGather gather(client);
+        return VNCSendFill(gather, client, whole) && gather.Flush() ? TRUE : FALSE;
+    }
+
+    // columns no wider than MaxWidth, cut into bands of whole JPEG MCUs;
+    // the bands are on a grid fixed to the screen rather than to the rect,
+    // so viewers whose updates cover the same rows get the same tiles
+    int columns((w + MaxWidth - 1) / MaxWidth);
+    int width((w + columns - 1) / columns);
+    int band(VNCBand(screen->width));
+    int first(y / band);
+    int rows((y + h - 1) / band - first + 1);
+
+    size_t count(columns * rows);
+    VNCTile *tiles(new VNCTile[count]);
+    VNCTask **tasks(new VNCTask *[count]);
+
+    for (int row(0); row != rows; ++row)
+        for (int column(0); column != columns; ++column) {
+            VNCTile &tile(tiles[row * columns + column]);
+            tile.x_ = x + column * width;
+            tile.y_ = std::max(y, (first + row) * band);
+            tile.w_ = column + 1 == columns ? x + w - tile.x_ : width;
+            tile.h_ = std::min(y + h, (first + row + 1) * band) - tile.y_;
+            tile.data_ = frame + tile.y_ * stride + tile.x_ * BytesPerPixel;
+            tile.stride_ = stride;
+            tile.quality_ = Quality[quality];
+            tile.subsample_ = Subsample[quality];
+            tile.cache_ = cache;
+            tile.jpegCost_ = VNCCost(history.jpeg_, tile);
+            tile.losslessCost_ = VNCCost(history.lossless_, tile);
+            tasks[row * columns + column] = &tile;
+        }
+
+    pool.Run(tasks, count);
+
+    // tight.c writes through updateBuf on its own, so whatever we gathered
+    // must go out before any tile falls back to it
+    VNCGather gather(client);
+
+    rfbBool success(TRUE);
+    for (size_t i(0); success && i != count; ++i) {
+        const VNCTile &tile(tiles[i]);
+        // a palette may still turn out too big for tight.c, and so JPEG
+        VNCTightMark(history, client, tile.x_, tile.y_, tile.w_, tile.h_, tile.kind_ == VNCTile::Jpeg || tile.kind_ == VNCTile::Fallback);
+
+        switch (tile.kind_) {
+            case VNCTile::Fill:
+                success = VNCSendFill(gather, client, tile);
+            break;
+
+            case VNCTile::Jpeg:
+                success = VNCSendJpeg(gather, client, tile);
+                VNCCharge(history.jpeg_, tile, tile.size_);
+            break;
+
+            case VNCTile::Lossless: {
+                size_t bytes;
+                success = gather.Flush() && VNCSendLossless(fallback, client, tile, bytes);
+                if (success && bytes != 0)
+                    VNCCharge(history.lossless_, tile, bytes);
+            } break;
+
+            case VNCTile::Fallback:
+                success = gather.Flush() && VNCSendTightAt(fallback, client, quality, tile.x_, tile.y_, tile.w_, tile.h_);
+            break;
+        }
+    }
+
+    if (success)
+        success = gather.Flush();
+
+    delete [] tasks;
+    delete [] tiles;
+
+    return success;
+}
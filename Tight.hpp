@@ -0,0 +1,72 @@
+/* Veency - VNC Remote Access Server for iPhoneOS
+ * Copyright (C) 2008-2014  Jay Freeman (saurik)
+*/
+
+/* GNU Affero General Public License, Version 3 {{{ */
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+/* }}} */
+
+#ifndef VEENCY_TIGHT_HPP
+#define VEENCY_TIGHT_HPP
+
+#include <rfb/rfb.h>
+
+#include "Cache.hpp"
+#include "Pool.hpp"
+
+typedef rfbBool (*VNCSendRect)(rfbClientPtr client, int x, int y, int w, int h);
+
+// what the last tile over each CellSize square of the screen cost with
+// JPEG and with lossless zlib, in sixteenths of a bit per pixel (0 being
+// not yet known); kept per client, as each picks its own quality level
+struct VNCTightHistory {
+    static const int CellBits = 6;
+    static const int CellSize = 1 << CellBits;
+    static const int Columns = 64;
+    static const int Rows = 64;
+
+    uint8_t jpeg_[Rows][Columns];
+    uint8_t lossless_[Rows][Columns];
+
+    // whether the client last got the cell lossy, and whether it is now
+    // due to be sent again losslessly
+    bool lossy_[Rows][Columns];
+    bool refine_[Rows][Columns];
+};
+
+// records whether a client last got the cells of a rect lossy or not
+void VNCTightMark(VNCTightHistory &history, rfbClientPtr client, int x, int y, int w, int h, bool lossy);
+
+// how many tiles VNCSendRectTight() cuts a whole screen of this size into
+size_t VNCTightTiles(int width, int height);
+
+// whether VNCSendRectTight() may split rects for this client, which needs
+// LastRect (so the rect count is not fixed up front) and JPEG
+bool VNCTightParallel(rfbClientPtr client, int quality);
+
+// calls tight.c at quality rather than the client's own level; tight.c only
+// looks at the client, so the level is swapped in for the call, but never
+// over one that SetEncodings stored meanwhile on the input thread
+rfbBool VNCSendTightAt(VNCSendRect fallback, rfbClientPtr client, int quality, int x, int y, int w, int h);
+
+// encodes a rect as independent Tight tiles on the pool and writes them in
+// order; tiles it would rather not handle (few colors, so palette + zlib,
+// or sharp-edged content, so lossless zlib, whose streams are per-client
+// state) are passed to fallback in sequence; cache may be NULL, and quality
+// (-1 for lossless) is at most the level the client asked for
+rfbBool VNCSendRectTight(VNCPool &pool, VNCTileCache *cache, VNCSendRect fallback, VNCTightHistory &history, rfbClientPtr client, int quality, int x, int y, int w, int h);
+
+#endif//VEENCY_TIGHT_HPP
@@ -0,0 +1,182 @@
+/* Veency - VNC Remote Access Server for iPhoneOS
+ * Copyright (C) 2008-2014  Jay Freeman (saurik)
+*/
+
+/* GNU Affero General Public License, Version 3 {{{ */
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+/* }}} */
+
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
+#include "Translate.hpp"
+
+// translate.c's rfbInitOneRGBTable() scales each channel with rounding, as
+// (value * Max + 127) / 255; for any value * Max + 127 below 65536, which
+// all of ours are, (x + (x >> 8) + 1) >> 8 is the same as x / 255
+
+template <unsigned Max>
+static inline uint32_t VNCScale(uint32_t value) {
+    if (Max == 255)
+        return value;
+    uint32_t x(value * Max + 127);
+    return (x + (x >> 8) + 1) >> 8;
+}
+
+template <typename Pixel>
+static inline Pixel VNCSwap(Pixel pixel);
+
+template <>
+inline uint8_t VNCSwap(uint8_t pixel) {
+    return pixel;
+}
+
+template <>
+inline uint16_t VNCSwap(uint16_t pixel) {
+    return pixel >> 8 | pixel << 8;
+}
+
+template <>
+inline uint32_t VNCSwap(uint32_t pixel) {
+    return __builtin_bswap32(pixel);
+}
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+template <unsigned Max>
+static inline uint16x8_t VNCScale(uint8x8_t value) {
+    if (Max == 255)
+        return vmovl_u8(value);
+    uint16x8_t x(vmlal_u8(vdupq_n_u16(127), value, vdup_n_u8(Max)));
+    return vshrq_n_u16(vaddq_u16(vaddq_u16(x, vshrq_n_u16(x, 8)), vdupq_n_u16(1)), 8);
+}
+#endif
+
+// Swap is whether the client's byte order differs from ours
+template <typename Pixel, unsigned RedMax, unsigned RedShift, unsigned GreenMax, unsigned GreenShift, unsigned BlueMax, unsigned BlueShift, bool Swap>
+static void VNCTranslate(char *, rfbPixelFormat *, rfbPixelFormat *, char *iptr, char *optr, int bytesBetweenInputLines, int width, int height) {
+    Pixel *output(reinterpret_cast<Pixel *>(optr));
+
+    while (--height >= 0) {
+        const uint8_t *input(reinterpret_cast<uint8_t *>(iptr));
+        iptr += bytesBetweenInputLines;
+
+        int col(0);
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+        for (; col + 8 <= width; col += 8) {
+            // in memory, a little-endian BGRX pixel is blue, green, red, x
+            uint8x8x4_t pixels(vld4_u8(input + col * 4));
+
+            if (sizeof(Pixel) == 4) {
+                // every channel is a whole byte, which just moves
+                uint8x8x4_t bytes;
+                bytes.val[0] = bytes.val[1] = bytes.val[2] = bytes.val[3] = vdup_n_u8(0);
+                bytes.val[Swap ? 3 - RedShift / 8 : RedShift / 8] = pixels.val[2];
+                bytes.val[Swap ? 3 - GreenShift / 8 : GreenShift / 8] = pixels.val[1];
+                bytes.val[Swap ? 3 - BlueShift / 8 : BlueShift / 8] = pixels.val[0];
+                vst4_u8(reinterpret_cast<uint8_t *>(output + col), bytes);
+                continue;
+            }
+
+            // not vshlq_n_u16(), which would reject the 32-bit shifts
+            uint16x8_t packed(vorrq_u16(vorrq_u16(
+                vshlq_u16(VNCScale<RedMax>(pixels.val[2]), vdupq_n_s16(RedShift)),
+                vshlq_u16(VNCScale<GreenMax>(pixels.val[1]), vdupq_n_s16(GreenShift))),
+                vshlq_u16(VNCScale<BlueMax>(pixels.val[0]), vdupq_n_s16(BlueShift))));
+
+            if (sizeof(Pixel) == 1)
+                vst1_u8(reinterpret_cast<uint8_t *>(output + col), vmovn_u16(packed));
+            else if (Swap)
+                vst1q_u8(reinterpret_cast<uint8_t *>(output + col), vrev16q_u8(vreinterpretq_u8_u16(packed)));
+            else
+                vst1q_u16(reinterpret_cast<uint16_t *>(output + col), packed);
+        }
+#endif
+
+        for (; col != width; ++col) {
+            const uint8_t *pixel(input + col * 4);
+            Pixel value(
+                VNCScale<RedMax>(pixel[2]) << RedShift |
+                VNCScale<GreenMax>(pixel[1]) << GreenShift |
+                VNCScale<BlueMax>(pixel[0]) << BlueShift
+            );
+            output[col] = Swap ? VNCSwap(value) : value;
+        }
+
+        output += width;
+    }
+}
+
+struct VNCTranslation {
+    uint8_t bitsPerPixel;
+    uint16_t redMax, greenMax, blueMax;
+    uint8_t redShift, greenShift, blueShift;
+    rfbTranslateFnType native;
+    rfbTranslateFnType swapped;
+};
+
+#define VNCTranslation_(Pixel, RedMax, RedShift, GreenMax, GreenShift, BlueMax, BlueShift) \
+    {sizeof(Pixel) * 8, RedMax, GreenMax, BlueMax, RedShift, GreenShift, BlueShift, \
+        &VNCTranslate<Pixel, RedMax, RedShift, GreenMax, GreenShift, BlueMax, BlueShift, false>, \
+        &VNCTranslate<Pixel, RedMax, RedShift, GreenMax, GreenShift, BlueMax, BlueShift, true>}
+
+// what clients we know of ask for; BGR233 is the usual 8-bit format
+static const VNCTranslation Translations[] = {
+    VNCTranslation_(uint16_t, 31, 11, 63, 5, 31, 0),
+    VNCTranslation_(uint16_t, 31, 0, 63, 5, 31, 11),
+    VNCTranslation_(uint16_t, 31, 10, 31, 5, 31, 0),
+    VNCTranslation_(uint16_t, 31, 0, 31, 5, 31, 10),
+    VNCTranslation_(uint8_t, 7, 0, 7, 3, 3, 6),
+    VNCTranslation_(uint8_t, 7, 5, 7, 2, 3, 0),
+    VNCTranslation_(uint32_t, 255, 16, 255, 8, 255, 0),
+    VNCTranslation_(uint32_t, 255, 0, 255, 8, 255, 16),
+    VNCTranslation_(uint32_t, 255, 24, 255, 16, 255, 8),
+    VNCTranslation_(uint32_t, 255, 8, 255, 16, 255, 24),
+};
+
+#undef VNCTranslation_
+
+rfbTranslateFnType VNCTranslateFunction(const rfbPixelFormat &in, const rfbPixelFormat &out) {
+    bool little(rfbEndianTest != 0);
+
+    if (
+        in.bitsPerPixel != 32 || !in.trueColour || (in.bigEndian != 0) == little ||
+        in.redMax != 255 || in.greenMax != 255 || in.blueMax != 255 ||
+        in.redShift != 16 || in.greenShift != 8 || in.blueShift != 0
+    )
+        return NULL;
+
+    if (!out.trueColour)
+        return NULL;
+
+    for (size_t i(0); i != sizeof(Translations) / sizeof(Translations[0]); ++i) {
+        const VNCTranslation &translation(Translations[i]);
+        if (
+            out.bitsPerPixel == translation.bitsPerPixel &&
+            out.redMax == translation.redMax && out.greenMax == translation.greenMax && out.blueMax == translation.blueMax &&
+            out.redShift == translation.redShift && out.greenShift == translation.greenShift && out.blueShift == translation.blueShift
+        )
+            // translate.c only swaps multi-byte pixels
+            return (out.bigEndian != 0) != (in.bigEndian != 0) && out.bitsPerPixel != 8 ? translation.swapped : translation.native;
+    }
+
+    return NULL;
+}
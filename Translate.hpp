@@ -0,0 +1,33 @@
+/* Veency - VNC Remote Access Server for iPhoneOS
+ * Copyright (C) 2008-2014  Jay Freeman (saurik)
+*/
+
+/* GNU Affero General Public License, Version 3 {{{ */
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+/* }}} */
+
+
+#ifndef VEENCY_TRANSLATE_HPP
+#define VEENCY_TRANSLATE_HPP
+
+#include <rfb/rfb.h>
+
+// a converter from our 32-bit BGRX framebuffer to the client's true color
+// format, producing exactly what libvncserver's RGB tables would; NULL if
+// either format is one we have no specialization for
+rfbTranslateFnType VNCTranslateFunction(const rfbPixelFormat &in, const rfbPixelFormat &out);
+
+#endif//VEENCY_TRANSLATE_HPP
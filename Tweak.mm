@@ -31,10 +31,22 @@
 #include <rfb/rfb.h>
 #include <rfb/keysym.h>
 
+#include <stdio.h>
+#include <zlib.h>
+
+extern "C" {
+#include <jpeglib.h>
+}
+
 #include <mach/mach.h>
 #include <mach/mach_time.h>
 
+#include <pthread.h>
+
+#include <dlfcn.h>
+
 #include <sys/mman.h>
+#include <sys/socket.h>
 #include <sys/sysctl.h>
 
 #undef assert
@@ -52,6 +64,21 @@ extern "C" {
 #include "SpringBoardAccess.h"
 }
 
+#include "Capture.hpp"
+#include "Governor.hpp"
+#include "Histogram.hpp"
+#include "Jpeg.hpp"
+#include "Output.hpp"
+#include "Reactor.hpp"
+#include "Refine.hpp"
+#include "Scale.hpp"
+#include "Scroll.hpp"
+#include "Slab.hpp"
+#include "Throttle.hpp"
+#include "Tight.hpp"
+#include "Translate.hpp"
+#include "Video.hpp"
+
 typedef CFTypeRef IOHIDEventRef;
 typedef CFTypeRef IOHIDEventSystemClientRef;
 typedef CFTypeRef IOHIDEventSystemConnectionRef;
@@ -112,6 +139,7 @@ MSClassHook(UIApplication)
 #define IOSurfaceCreate CoreSurfaceBufferCreate
 #define IOSurfaceFlushProcessorCaches CoreSurfaceBufferFlushProcessorCaches
 #define IOSurfaceGetBaseAddress CoreSurfaceBufferGetBaseAddress
+#define IOSurfaceGetBytesPerRow CoreSurfaceBufferGetBytesPerRow
 #define IOSurfaceLock CoreSurfaceBufferLock
 #define IOSurfaceUnlock CoreSurfaceBufferUnlock
 
@@ -137,6 +165,7 @@ extern "C" IOSurfaceRef IOSurfaceCreate(CFDictionaryRef dict);
 extern "C" int IOSurfaceLock(IOSurfaceRef surface, uint32_t options, uint32_t *seed);
 extern "C" int IOSurfaceUnlock(IOSurfaceRef surface, uint32_t options, uint32_t *seed);
 extern "C" void *IOSurfaceGetBaseAddress(IOSurfaceRef surface);
+extern "C" size_t IOSurfaceGetBytesPerRow(IOSurfaceRef surface);
 
 extern "C" void IOSurfaceFlushProcessorCaches(IOSurfaceRef buffer);
 
@@ -190,11 +219,150 @@ static const size_t BytesPerPixel = 4;
 static const size_t BitsPerSample = 8;
 
 static IOSurfaceAcceleratorRef accelerator_;
-static IOSurfaceRef buffer_;
+
+// has the 2D engine copy, and if need be resample, the layer into a buffer
+// of our own, which is then much cheaper to read than the layer itself
+
+struct VNCAcceleratedScaler :
+    public VNCScaler
+{
+    IOSurfaceAcceleratorRef accelerator_;
+    IOSurfaceRef surface_;
+
+    VNCAcceleratedScaler(IOSurfaceAcceleratorRef accelerator) :
+        accelerator_(accelerator),
+        surface_(NULL)
+    {
+    }
+
+    virtual ~VNCAcceleratedScaler() {
+        if (surface_ != NULL)
+            CFRelease(surface_);
+    }
+
+    virtual bool Resize(size_t width, size_t height, unsigned factor) {
+        VNCScaler::Resize(width, height, factor);
+
+        if (surface_ != NULL)
+            CFRelease(surface_);
+
+        surface_ = IOSurfaceCreate((CFDictionaryRef) [NSDictionary dictionaryWithObjectsAndKeys:
+            @"PurpleEDRAM", kIOSurfaceMemoryRegion,
+            [NSNumber numberWithBool:YES], kIOSurfaceIsGlobal,
+            [NSNumber numberWithInt:(width * BytesPerPixel)], kIOSurfaceBytesPerRow,
+            [NSNumber numberWithInt:width], kIOSurfaceWidth,
+            [NSNumber numberWithInt:height], kIOSurfaceHeight,
+            [NSNumber numberWithInt:'BGRA'], kIOSurfacePixelFormat,
+            [NSNumber numberWithInt:(width * height * BytesPerPixel)], kIOSurfaceAllocSize,
+        nil]);
+
+        return surface_ != NULL;
+    }
+
+    virtual const uint8_t *Scale(void *surface, const uint8_t *data, size_t stride, size_t &pitch) {
+        if (IOSurfaceAcceleratorTransferSurface(accelerator_, surface, surface_, NULL, NULL, NULL, NULL) != 0)
+            return NULL;
+        pitch = width_ * BytesPerPixel;
+        return reinterpret_cast<uint8_t *>(IOSurfaceGetBaseAddress(surface_));
+    }
+};
+
+static VNCSoftwareScaler software_;
+static VNCAcceleratedScaler *accelerated_;
+static VNCScaler *scaler_;
+
+static VNCCapture capture_;
+static VNCScroll scroll_;
+
+// damage of frames the ring could not publish yet: marking it any earlier
+// lets an encoder send (and clear) it from the frame before
+static sraRegionPtr deferred_;
+
+static VNCPool pool_;
+
+// deflate state for tight.c, zlib.c and zrleoutstream.c
+static VNCSlabs slabs_;
+
+// enough tiles for a few whole screens, as sized by VNCResize(): viewers at
+// different quality levels, or content that comes back a few frames later
+static const unsigned CachedScreens = 8;
+static VNCTileCache cache_;
+
+// whether a persistently changing region gets streamed as video
+static bool video_;
+static VNCMotion motion_;
+
+// lossy cells a client got are sent again losslessly once they have gone
+// Quiet microseconds without changing, as long as nothing else is pending;
+// lossy_ says whether any client may have such cells left to come back for
+static const uint64_t Quiet = 500000;
+static VNCQuiet quiet_;
+static uint64_t refined_;
+static volatile uint32_t lossy_;
+
+// scale_ is what the preferences ask for, scaled_ what the ring was sized to
+static unsigned scale_ = 1;
+static unsigned scaled_;
+static pthread_mutex_t resize_ = PTHREAD_MUTEX_INITIALIZER;
+static VNCGovernor governor_(1000 / 60, 1000 / 10, 1000 / 25);
+
+static uint64_t VNCMicroseconds() {
+    static mach_timebase_info_data_t timebase;
+    if (_unlikely(timebase.denom == 0))
+        mach_timebase_info(&timebase);
+    return mach_absolute_time() * timebase.numer / timebase.denom / 1000;
+}
+
+// a frame is swapped, captured, encoded (per client) and then delivered,
+// which we can only tell by the client asking for the next one; swapped_
+// is the first swap the capture thread has yet to get to
+
+static volatile uint64_t swapped_;
+static uint64_t frameSwapped_;
+static uint64_t frameCaptured_;
+
+static VNCHistogram captureLatency_;
+static VNCHistogram encodeLatency_;
+static VNCHistogram deliverLatency_;
+static VNCHistogram totalLatency_;
+
+// updates held back because the client's socket was still too full
+static volatile uint32_t holds_;
+
+static volatile uint32_t swaps_;
+static volatile uint32_t idle_;
+static semaphore_t wake_;
+
+static void VNCSignal() {
+    if (idle_ != 0 && __sync_bool_compare_and_swap(&idle_, 1, 0))
+        semaphore_signal(wake_);
+}
+
+static void VNCWake() {
+    __sync_add_and_fetch(&swaps_, 1);
+    VNCSignal();
+}
+
+// clients with an outstanding FramebufferUpdateRequest; while there are
+// none we only remember that the screen changed, and grab it once asked
+static volatile uint32_t requests_;
+static volatile uint32_t stale_;
+
+static void VNCStale() {
+    __sync_lock_test_and_set(&stale_, 1);
+    if (requests_ != 0 && __sync_bool_compare_and_swap(&stale_, 1, 0))
+        VNCWake();
+}
 
 static NSMutableSet *handlers_;
 static rfbScreenInfoPtr screen_;
 static bool running_;
+
+// with the Reactor preference, one thread serves every client; reactive_
+// is what the server was last started with
+static VNCReactor reactor_;
+static bool reactive_;
+
 static int buttons_;
 static int x_, y_;
 
@@ -203,13 +371,6 @@ static unsigned clients_;
 static CFMessagePortRef ashikase_;
 static bool cursor_;
 
-static rfbPixel *black_;
-
-static void VNCBlack() {
-    if (_unlikely(black_ == NULL))
-        black_ = reinterpret_cast<rfbPixel *>(mmap(NULL, sizeof(rfbPixel) * width_ * height_, PROT_READ, MAP_ANON | MAP_PRIVATE | MAP_NOCACHE, VM_FLAGS_PURGABLE, 0));
-    screen_->frameBuffer = reinterpret_cast<char *>(black_);
-}
 
 static bool Ashikase(bool always) {
     if (!always && !cursor_)
@@ -274,22 +435,46 @@ static NSString *DialogFormat(@"Accept connection from\n%s?\n\nVeency VNC Server
 static NSString *DialogAccept(@"Accept");
 static NSString *DialogReject(@"Reject");
 
-static volatile rfbNewClientAction action_ = RFB_CLIENT_ON_HOLD;
 static NSCondition *condition_;
 static NSLock *lock_;
 
+// the client the user is being asked about, and those on hold behind it
 static rfbClientPtr client_;
+static NSMutableArray *waiting_;
 
 static void VNCSetup();
 static void VNCEnabled();
 
+static void VNCAsk();
+static void VNCAccept(rfbClientPtr client);
+
+static void *OnCapture(void *);
+
 float (*$GSMainScreenScaleFactor)();
 
+// with the reactor, the clients belong to its thread; otherwise, one on
+// hold has no thread of its own yet, and libvncserver starts one for it
+static void VNCRelease(rfbClientPtr client, bool accept) {
+    if (reactive_)
+        reactor_.Answer(client, accept);
+    else if (accept)
+        rfbStartOnHoldClient(client);
+    else
+        rfbRefuseOnHoldClient(client);
+}
+
+// client_ is NULL if the server went away (with it) while the user decided
 static void VNCAction(rfbNewClientAction action) {
-    [condition_ lock];
-    action_ = action;
-    [condition_ signal];
-    [condition_ unlock];
+    @synchronized (condition_) {
+        if (rfbClientPtr client = client_) {
+            client_ = NULL;
+            if (action == RFB_CLIENT_ACCEPT)
+                VNCAccept(client);
+            VNCRelease(client, action == RFB_CLIENT_ACCEPT);
+        }
+
+        VNCAsk();
+    }
 }
 
 static void OnUserNotification(CFUserNotificationRef notification, CFOptionFlags flags) {
@@ -313,6 +498,9 @@ static void OnUserNotification(CFUserNotificationRef notification, CFOptionFlags
 @implementation VNCBridge
 
 + (void) askForConnection {
+    if (client_ == NULL)
+        return;
+
     if ($VNCAlertItem != nil) {
         [[$SBAlertItemsController sharedInstance] activateAlertItem:[[[$VNCAlertItem alloc] init] autorelease]];
         return;
@@ -360,9 +548,11 @@ static void OnUserNotification(CFUserNotificationRef notification, CFOptionFlags
             ratio_ = $GSMainScreenScaleFactor();
     }
 
-    ++clients_;
     AshikaseSetEnabled(true, false);
 
+    // the screen may be idle, so do not wait for a swap to capture it
+    VNCWake();
+
     if (SBA_available())
         SBA_addStatusBarImage(const_cast<char *>("Veency"));
     else if ($SBStatusBarController != nil)
@@ -417,6 +607,38 @@ static void FixRecord(GSEventRecord *record) {
         memmove(&record->windowContextId, &record->windowContextId + 1, sizeof(*record) - (reinterpret_cast<uint8_t *>(&record->windowContextId + 1) - reinterpret_cast<uint8_t *>(record)) + record->size);
 }
 
+// only call this while no client is connected: libvncserver would tell them
+// about the new size, but their encoders might still be reading the old ring
+
+static void VNCResize() {
+    pthread_mutex_lock(&resize_);
+
+    scaled_ = scale_;
+    size_t width(width_ / scaled_);
+    size_t height(height_ / scaled_);
+
+    // the software scaler stays ready in case the accelerator fails a frame
+    software_.Resize(width, height, scaled_);
+    if (accelerated_ != NULL && accelerated_->Resize(width, height, scaled_))
+        scaler_ = accelerated_;
+    else
+        scaler_ = &software_;
+
+    capture_.Resize(width, height, &screen_->frameBuffer);
+    sraRgnMakeEmpty(deferred_);
+    scroll_.Resize(width, height);
+    cache_.Resize(VNCTightTiles(width, height) * CachedScreens);
+    motion_.Resize(width, height);
+    quiet_.Resize(width, height);
+    rfbNewFramebuffer(screen_, screen_->frameBuffer, width, height, BitsPerSample, 3, BytesPerPixel);
+
+    screen_->serverFormat.redShift = BitsPerSample * 2;
+    screen_->serverFormat.greenShift = BitsPerSample * 1;
+    screen_->serverFormat.blueShift = BitsPerSample * 0;
+
+    pthread_mutex_unlock(&resize_);
+}
+
 static void VNCSettings() {
     @synchronized (lock_) {
         for (NSValue *handler in handlers_)
@@ -443,8 +665,16 @@ static void VNCSettings() {
         if (!valid)
             cursor_ = true;
 
+        CFIndex scale(CFPreferencesGetAppIntegerValue(CFSTR("Scale"), CFSTR("com.saurik.Veency"), &valid));
+        scale_ = valid && (scale == 2 || scale == 4) ? scale : 1;
+
+        video_ = CFPreferencesGetAppBooleanValue(CFSTR("Video"), CFSTR("com.saurik.Veency"), &valid);
+
         if (clients_ != 0)
             AshikaseSetEnabled(cursor_, true);
+        // XXX: connected clients may be encoding from the old ring; they get the new scale next time around
+        else if (scaled_ != 0 && scaled_ != scale_)
+            VNCResize();
     }
 }
 
@@ -475,6 +705,35 @@ static rfbBool VNCCheck(rfbClientPtr client, const char *data, int size) {
 
 static bool iPad1_;
 
+struct VeencyClient {
+    unsigned parity_;
+    uint64_t start_;
+    bool requested_;
+
+    uint64_t swapped_;
+    uint64_t captured_;
+    uint64_t encoded_;
+
+    // the throttle's counters as the update started
+    uint64_t wrote_;
+    uint64_t waited_;
+
+    // what the last update wrote, and how long it was busy (and blocked)
+    uint64_t bytes_;
+    uint64_t blocked_;
+    uint64_t busy_;
+
+    // since when updates have been held back for a full socket, or 0
+    uint64_t holding_;
+
+    VNCTightHistory tight_;
+    VNCVideoCodec *video_;
+    VNCThrottle throttle_;
+
+    // with the reactor, what the socket has not taken yet
+    VNCQueue queue_;
+};
+
 struct VeencyEvent {
     struct GSEventRecord record;
     struct {
@@ -490,6 +749,9 @@ static void VNCPointer(int buttons, int x, int y, rfbClientPtr client) {
     if (ratio_ == 0)
         return;
 
+    x *= scaled_;
+    y *= scaled_;
+
     CGPoint location = {x, y};
 
     if (width_ > height_) {
@@ -832,35 +1094,179 @@ static void VNCKeyboard(rfbBool down, rfbKeySym key, rfbClientPtr client) {
         CFRelease(string);
 }
 
+static void VNCRequested(rfbClientPtr client) {
+    VeencyClient *data(reinterpret_cast<VeencyClient *>(client->clientData));
+    if (data == NULL)
+        return;
+
+    LOCK(client->updateMutex);
+    bool requested(client->sock != -1 && !sraRgnEmpty(client->requestedRegion));
+    bool changed(requested != data->requested_);
+    data->requested_ = requested;
+
+    uint64_t encoded(0), bytes(0), blocked(0), busy(0);
+    if (changed && requested) {
+        encoded = data->encoded_;
+        data->encoded_ = 0;
+        bytes = data->bytes_;
+        blocked = data->blocked_;
+        busy = data->busy_;
+    }
+    UNLOCK(client->updateMutex);
+
+    if (!changed)
+        return;
+    else if (!requested)
+        __sync_sub_and_fetch(&requests_, 1);
+    else {
+        if (encoded != 0) {
+            uint64_t now(VNCMicroseconds());
+            deliverLatency_.Add(now - encoded);
+            totalLatency_.Add(now - data->swapped_);
+
+            // with quality back up, whatever went out degraded is sent again
+            if (data->throttle_.Update(bytes, blocked, busy, now - encoded) && client->format.bitsPerPixel != 0) {
+                sraRegionPtr region(sraRgnCreate());
+                LOCK(client->updateMutex);
+                VNCLossy(data->tight_, client->scaledScreen->width, client->scaledScreen->height, region);
+                if (!sraRgnEmpty(region)) {
+                    sraRgnOr(client->modifiedRegion, region);
+                    TSIGNAL(client->updateCond);
+                }
+                UNLOCK(client->updateMutex);
+                sraRgnDestroy(region);
+            }
+        }
+
+        __sync_add_and_fetch(&requests_, 1);
+        if (stale_ != 0 && __sync_bool_compare_and_swap(&stale_, 1, 0))
+            VNCWake();
+    }
+}
+
+// only the reactor queues output, and only once a client is accepted (and
+// then through to the end, so nothing can overtake what is queued)
+static VNCQueue *VNCQueued(rfbClientPtr client) {
+    if (!reactive_)
+        return NULL;
+#ifdef LIBVNCSERVER_WITH_WEBSOCKETS
+    // their framing happens inside rfbWriteExact()
+    if (client->webSockets)
+        return NULL;
+#endif
+    VeencyClient *data(reinterpret_cast<VeencyClient *>(client->clientData));
+    return data == NULL ? NULL : &data->queue_;
+}
+
+// what has yet to reach the client: in its socket, and in its queue
+static bool VNCBacklog(rfbClientPtr client, size_t &bytes) {
+    if (!VNCUnsent(client->sock, bytes))
+        return false;
+    if (VNCQueue *queue = VNCQueued(client)) {
+        LOCK(client->outputMutex);
+        bytes += queue->Size();
+        UNLOCK(client->outputMutex);
+    }
+    return true;
+}
+
+static void VNCDisplay(rfbClientPtr client) {
+    VeencyClient *data(reinterpret_cast<VeencyClient *>(client->clientData));
+    data->start_ = VNCMicroseconds();
+    data->swapped_ = frameSwapped_;
+    data->captured_ = frameCaptured_;
+    data->wrote_ = data->throttle_.Bytes();
+    data->waited_ = data->throttle_.Blocked();
+    data->parity_ = capture_.Acquire();
+}
+
+static void VNCDisplayFinished(rfbClientPtr client, int result) {
+    VeencyClient *data(reinterpret_cast<VeencyClient *>(client->clientData));
+    // the capture thread is holding that frame's damage until we let it out
+    if (capture_.Release(data->parity_))
+        VNCSignal();
+
+    uint64_t now(VNCMicroseconds());
+    governor_.Encode(now - data->start_);
+
+    if (data->captured_ != 0) {
+        encodeLatency_.Add(now - data->captured_);
+        LOCK(client->updateMutex);
+        data->encoded_ = now;
+        data->bytes_ = data->throttle_.Bytes() - data->wrote_;
+        data->blocked_ = data->throttle_.Blocked() - data->waited_;
+        data->busy_ = now - data->start_;
+        UNLOCK(client->updateMutex);
+    }
+
+    size_t unsent;
+    if (VNCBacklog(client, unsent))
+        governor_.Backlog(unsent);
+
+    VNCRequested(client);
+}
+
+static void VNCWrote(rfbClientPtr client, size_t bytes, uint64_t elapsed) {
+    if (VeencyClient *data = reinterpret_cast<VeencyClient *>(client->clientData))
+        data->throttle_.Wrote(bytes, elapsed);
+}
+
 static void VNCDisconnect(rfbClientPtr client) {
+    VNCRequested(client);
+    VeencyClient *data(reinterpret_cast<VeencyClient *>(client->clientData));
+
+    // VNCRefine() walks the clients under resize_; without client threads,
+    // libvncserver would not wait for it before freeing this one
+    pthread_mutex_lock(&resize_);
+    client->clientData = NULL;
+    pthread_mutex_unlock(&resize_);
+
+    delete data->video_;
+    delete data;
+
+    // the reactor (or rfbShutdownServer()) may be what the main thread is
+    // waiting on, so this must not wait for it
     @synchronized (condition_) {
         if (--clients_ == 0)
-            [VNCBridge performSelectorOnMainThread:@selector(removeStatusBarItem) withObject:nil waitUntilDone:YES];
+            [VNCBridge performSelectorOnMainThread:@selector(removeStatusBarItem) withObject:nil waitUntilDone:NO];
     }
 }
 
-static rfbNewClientAction VNCClient(rfbClientPtr client) {
-    [condition_ lock];
+// with condition_ held
+static void VNCAccept(rfbClientPtr client) {
+    if (clients_++ == 0 && scaled_ != scale_)
+        VNCResize();
+    [VNCBridge performSelectorOnMainThread:@selector(registerClient) withObject:nil waitUntilDone:NO];
+    client->clientData = new VeencyClient();
+    client->clientGoneHook = &VNCDisconnect;
+}
 
-    rfbNewClientAction action;
-    if (screen_->authPasswdData != NULL && [(NSString *) screen_->authPasswdData length] != 0)
-        action = RFB_CLIENT_ACCEPT;
-    else {
-        client_ = client;
-        [VNCBridge performSelectorOnMainThread:@selector(askForConnection) withObject:nil waitUntilDone:NO];
-        while (action_ == RFB_CLIENT_ON_HOLD)
-            [condition_ wait];
-        action = action_;
-        action_ = RFB_CLIENT_ON_HOLD;
-    }
+// with condition_ held: asks about the next client on hold, if nobody is
+// being asked about already
+static void VNCAsk() {
+    if (client_ != NULL || [waiting_ count] == 0)
+        return;
+    client_ = reinterpret_cast<rfbClientPtr>([[waiting_ objectAtIndex:0] pointerValue]);
+    [waiting_ removeObjectAtIndex:0];
+    [VNCBridge performSelectorOnMainThread:@selector(askForConnection) withObject:nil waitUntilDone:NO];
+}
+
+// a client the user has to be asked about is left on hold, rather than
+// holding up the thread that accepted it (which may be serving everybody)
+static rfbNewClientAction VNCClient(rfbClientPtr client) {
+    @synchronized (condition_) {
+        if (screen_->authPasswdData != NULL && [(NSString *) screen_->authPasswdData length] != 0) {
+            VNCAccept(client);
+            return RFB_CLIENT_ACCEPT;
+        }
 
-    if (action == RFB_CLIENT_ACCEPT) {
-        [VNCBridge performSelectorOnMainThread:@selector(registerClient) withObject:nil waitUntilDone:YES];
-        client->clientGoneHook = &VNCDisconnect;
+        NSAutoreleasePool *pool([[NSAutoreleasePool alloc] init]);
+        [waiting_ addObject:[NSValue valueWithPointer:client]];
+        VNCAsk();
+        [pool release];
     }
 
-    [condition_ unlock];
-    return action;
+    return RFB_CLIENT_ON_HOLD;
 }
 
 extern "C" bool GSSystemHasCapability(NSString *);
@@ -876,6 +1282,41 @@ static void VNCLog(const char *format, ...) {
     va_end(args);
 }
 
+static void VNCReport(NSMutableString *statistics, const char *stage, const VNCHistogram &histogram) {
+    [statistics appendFormat:@"latency.%s.count %llu\n", stage, histogram.Count()];
+    [statistics appendFormat:@"latency.%s.p50 %llu\n", stage, histogram.Percentile(0.50)];
+    [statistics appendFormat:@"latency.%s.p90 %llu\n", stage, histogram.Percentile(0.90)];
+    [statistics appendFormat:@"latency.%s.p99 %llu\n", stage, histogram.Percentile(0.99)];
+    [statistics appendFormat:@"latency.%s.max %llu\n", stage, histogram.maximum_];
+}
+
+static CFDataRef VNCStatistics(CFMessagePortRef port, SInt32 type, CFDataRef data, void *info) {
+    NSMutableString *statistics([NSMutableString string]);
+
+    [statistics appendFormat:@"governor.defer %u\n", governor_.defer_];
+    [statistics appendFormat:@"governor.motion %.4f\n", governor_.motion_];
+    [statistics appendFormat:@"governor.encode %.2f\n", governor_.encode_];
+    [statistics appendFormat:@"governor.backlog %zu\n", governor_.backlog_];
+
+    VNCReport(statistics, "capture", captureLatency_);
+    VNCReport(statistics, "encode", encodeLatency_);
+    VNCReport(statistics, "deliver", deliverLatency_);
+    VNCReport(statistics, "total", totalLatency_);
+
+    [statistics appendFormat:@"zlib.hits %llu\n", slabs_.hits_];
+    [statistics appendFormat:@"zlib.misses %llu\n", slabs_.misses_];
+
+    [statistics appendFormat:@"cache.hits %llu\n", cache_.hits_];
+    [statistics appendFormat:@"cache.misses %llu\n", cache_.misses_];
+    [statistics appendFormat:@"cache.waits %llu\n", cache_.waits_];
+    [statistics appendFormat:@"cache.saved %llu\n", cache_.saved_];
+    [statistics appendFormat:@"cache.bytes %zu\n", cache_.bytes_];
+
+    [statistics appendFormat:@"output.holds %u\n", holds_];
+
+    return (CFDataRef) [[statistics dataUsingEncoding:NSUTF8StringEncoding] retain];
+}
+
 static void VNCSetup() {
     if (true)
         rfbLogEnable(false);
@@ -896,11 +1337,7 @@ static void VNCSetup() {
 
     screen_->alwaysShared = TRUE;
     screen_->handleEventsEagerly = TRUE;
-    screen_->deferUpdateTime = 1000 / 25;
-
-    screen_->serverFormat.redShift = BitsPerSample * 2;
-    screen_->serverFormat.greenShift = BitsPerSample * 1;
-    screen_->serverFormat.blueShift = BitsPerSample * 0;
+    screen_->deferUpdateTime = governor_.defer_;
 
     $GSSystemCopyCapability = reinterpret_cast<CFTypeRef (*)(CFStringRef)>(dlsym(RTLD_DEFAULT, "GSSystemCopyCapability"));
     $GSSystemGetCapability = reinterpret_cast<CFTypeRef (*)(CFStringRef)>(dlsym(RTLD_DEFAULT, "GSSystemGetCapability"));
@@ -928,29 +1365,39 @@ static void VNCSetup() {
     if (opengles2 != NULL)
         CFRelease(opengles2);
 
-    if (accelerator_ == NULL)
-        VNCBlack();
-    else {
-        buffer_ = IOSurfaceCreate((CFDictionaryRef) [NSDictionary dictionaryWithObjectsAndKeys:
-            @"PurpleEDRAM", kIOSurfaceMemoryRegion,
-            [NSNumber numberWithBool:YES], kIOSurfaceIsGlobal,
-            [NSNumber numberWithInt:(width_ * BytesPerPixel)], kIOSurfaceBytesPerRow,
-            [NSNumber numberWithInt:width_], kIOSurfaceWidth,
-            [NSNumber numberWithInt:height_], kIOSurfaceHeight,
-            [NSNumber numberWithInt:'BGRA'], kIOSurfacePixelFormat,
-            [NSNumber numberWithInt:(width_ * height_ * BytesPerPixel)], kIOSurfaceAllocSize,
-        nil]);
+    if (accelerator_ != NULL)
+        accelerated_ = new VNCAcceleratedScaler(accelerator_);
 
-        screen_->frameBuffer = reinterpret_cast<char *>(IOSurfaceGetBaseAddress(buffer_));
-    }
+    deferred_ = sraRgnCreate();
+    VNCResize();
+    semaphore_create(mach_task_self(), &wake_, SYNC_POLICY_FIFO, 0);
 
     screen_->kbdAddEvent = &VNCKeyboard;
     screen_->ptrAddEvent = &VNCPointer;
 
     screen_->newClientHook = &VNCClient;
+    screen_->displayHook = &VNCDisplay;
+    screen_->displayFinishedHook = &VNCDisplayFinished;
+    VNCWroteHook = &VNCWrote;
+    VNCQueueHook = &VNCQueued;
     screen_->passwordCheck = &VNCCheck;
 
     screen_->cursor = NULL;
+
+    if (CFMessagePortRef port = CFMessagePortCreateLocal(kCFAllocatorDefault, CFSTR("com.saurik.Veency.Statistics"), &VNCStatistics, NULL, NULL)) {
+        CFRunLoopSourceRef source(CFMessagePortCreateRunLoopSource(kCFAllocatorDefault, port, 0));
+        CFRunLoopAddSource(CFRunLoopGetMain(), source, kCFRunLoopCommonModes);
+        CFRelease(source);
+    }
+
+    // client threads work alongside the pool, so leave them a core
+    long cores(sysconf(_SC_NPROCESSORS_ONLN));
+    if (cores > 1)
+        pool_.Start(cores - 1);
+
+    pthread_t thread;
+    pthread_create(&thread, NULL, &OnCapture, NULL);
+    pthread_detach(thread);
 }
 
 static void VNCEnabled() {
@@ -964,17 +1411,32 @@ static void VNCEnabled() {
     if (!valid)
         enabled = true;
 
-    if (enabled != running_)
-        if (enabled) {
-            running_ = true;
-            screen_->socketState = RFB_SOCKET_INIT;
-            rfbInitServer(screen_);
-            rfbRunEventLoop(screen_, -1, true);
-        } else {
-            rfbShutdownServer(screen_, true);
-            running_ = false;
+    bool reactor(CFPreferencesGetAppBooleanValue(CFSTR("Reactor"), CFSTR("com.saurik.Veency"), &valid));
+
+    // switching between threading models means starting over
+    if (running_ && (!enabled || reactor != reactive_)) {
+        reactor_.Stop();
+
+        // clients on hold go with the server, so any answer about them is moot
+        @synchronized (condition_) {
+            client_ = NULL;
+            [waiting_ removeAllObjects];
         }
 
+        rfbShutdownServer(screen_, true);
+        running_ = false;
+    }
+
+    if (enabled && !running_) {
+        running_ = true;
+        reactive_ = reactor;
+        screen_->socketState = RFB_SOCKET_INIT;
+        rfbInitServer(screen_);
+        screen_->backgroundLoop = FALSE;
+        if (!reactor || !reactor_.Start(screen_))
+            rfbRunEventLoop(screen_, -1, true);
+    }
+
     }
 }
 
@@ -991,9 +1453,217 @@ static void VNCNotifyEnabled(
 
 
 static IOMobileFramebufferRef main_;
-static IOSurfaceRef layer_;
 
-static void OnLayer(IOMobileFramebufferRef fb, IOSurfaceRef layer) {
+// layer_ owns a reference to the last layer swapped in, which the capture
+// thread borrows (leaving Borrowed in its place) while it reads from it; a
+// swap meanwhile leaves the borrowed layer for the capture thread to drop
+static IOSurfaceRef const Borrowed(reinterpret_cast<IOSurfaceRef>(~uintptr_t(0)));
+static IOSurfaceRef volatile layer_;
+
+// set while the display is off (the compositor swapped in no layer): the
+// ring holds a black frame, which every encoder will send as a solid fill
+static bool dark_;
+
+static bool VNCPublishable() {
+    return !sraRgnEmpty(deferred_) && !capture_.Pending();
+}
+
+// this has to come before the next frame's copies, as rfbScheduleCopyRegion
+// carries damage that is already marked along with whatever it moves
+static void VNCPublish() {
+    if (!VNCPublishable())
+        return;
+    rfbMarkRegionAsModified(screen_, deferred_);
+    sraRgnMakeEmpty(deferred_);
+    reactor_.Wake();
+}
+
+static void OnLayer(IOSurfaceRef layer) {
+    uint64_t swapped(__sync_lock_test_and_set(&swapped_, 0));
+
+    size_t changed;
+    size_t pitch;
+
+    if (layer == NULL) {
+        if (dark_)
+            return;
+        changed = capture_.Blank();
+    } else if (const uint8_t *data = scaler_ == &software_ ? NULL : scaler_->Scale(layer, NULL, 0, pitch))
+        changed = capture_.Produce(data, pitch);
+    else {
+        IOSurfaceLock(layer, kIOSurfaceLockReadOnly, NULL);
+        IOSurfaceFlushProcessorCaches(layer);
+        data = software_.Scale(layer, reinterpret_cast<uint8_t *>(IOSurfaceGetBaseAddress(layer)), IOSurfaceGetBytesPerRow(layer), pitch);
+        changed = capture_.Produce(data, pitch);
+        IOSurfaceUnlock(layer, kIOSurfaceLockReadOnly, NULL);
+    }
+
+    dark_ = layer == NULL;
+
+    const VNCDamage &damage(capture_.damage_);
+
+    uint64_t now(VNCMicroseconds());
+    governor_.Damage(now, changed, damage.columns_ * damage.rows_);
+    motion_.Update(damage, now);
+    quiet_.Update(damage, now);
+
+    // XXX: an encoder may pair these with the frame before or after this one
+    if (changed != 0) {
+        if (swapped != 0)
+            captureLatency_.Add(now - swapped);
+        frameSwapped_ = swapped != 0 ? swapped : now;
+        frameCaptured_ = now;
+    }
+    screen_->deferUpdateTime = governor_.Update(now);
+
+    const uint8_t *previous(capture_.previous_ == VNCCapture::None ? NULL : capture_.slots_[capture_.previous_]);
+    size_t moved(changed == 0 ? 0 : scroll_.Detect(previous, capture_.slots_[capture_.latest_], capture_.width_ * BytesPerPixel, damage));
+
+    // the copies would be sent from the old frame too, so skip them as well
+    if (capture_.Pending()) {
+        for (size_t i(0); i != damage.count_; ++i) {
+            const VNCRect &rect(damage.rects_[i]);
+            sraRegionPtr part(sraRgnCreateRect(rect.x, rect.y, rect.x + rect.w, rect.y + rect.h));
+            sraRgnOr(deferred_, part);
+            sraRgnDestroy(part);
+        }
+        return;
+    }
+
+    VNCPublish();
+
+    if (moved == 0)
+        for (size_t i(0); i != damage.count_; ++i) {
+            const VNCRect &rect(damage.rects_[i]);
+            rfbMarkRectAsModified(screen_, rect.x, rect.y, rect.x + rect.w, rect.y + rect.h);
+        }
+    else {
+        // libvncserver drops whatever part of a copy is also marked modified,
+        // so only the damage the copies do not account for gets marked
+        sraRegionPtr region(sraRgnCreate());
+
+        for (size_t i(0); i != damage.count_; ++i) {
+            const VNCRect &rect(damage.rects_[i]);
+            sraRegionPtr part(sraRgnCreateRect(rect.x, rect.y, rect.x + rect.w, rect.y + rect.h));
+            sraRgnOr(region, part);
+            sraRgnDestroy(part);
+        }
+
+        for (size_t i(0); i != moved; ++i) {
+            const VNCRect &rect(scroll_.rects_[i]);
+            rfbScheduleCopyRect(screen_, rect.x, rect.y, rect.x + rect.w, rect.y + rect.h, scroll_.dx_, scroll_.dy_);
+            sraRegionPtr part(sraRgnCreateRect(rect.x, rect.y, rect.x + rect.w, rect.y + rect.h));
+            sraRgnSubtract(region, part);
+            sraRgnDestroy(part);
+        }
+
+        rfbMarkRegionAsModified(screen_, region);
+        sraRgnDestroy(region);
+    }
+
+    reactor_.Wake();
+}
+
+// true if some client has lossy cells that were not quiet for long enough
+static bool VNCRefine(uint64_t before) {
+    bool pending(false);
+
+    rfbClientIteratorPtr iterator(rfbGetClientIterator(screen_));
+    while (rfbClientPtr client = rfbClientIteratorNext(iterator)) {
+        VeencyClient *data(reinterpret_cast<VeencyClient *>(client->clientData));
+        if (data == NULL || client->sock == -1)
+            continue;
+
+        // XXX: this races the client's own sends, so a cell may at worst get
+        // refined once more than it needed to be
+        LOCK(client->updateMutex);
+        if (!sraRgnEmpty(client->modifiedRegion))
+            pending = true;
+        else {
+            sraRegionPtr region(sraRgnCreate());
+            if (VNCRefinable(data->tight_, quiet_, before, region))
+                pending = true;
+            if (!sraRgnEmpty(region)) {
+                sraRgnOr(client->modifiedRegion, region);
+                TSIGNAL(client->updateCond);
+                reactor_.Wake();
+            }
+            sraRgnDestroy(region);
+        }
+        UNLOCK(client->updateMutex);
+    }
+    rfbReleaseClientIterator(iterator);
+
+    return pending;
+}
+
+// swaps that arrive while we are busy are coalesced: we only ever capture
+// whatever layer_ holds once we get around to it
+
+static void *OnCapture(void *) {
+    uint32_t done(swaps_);
+
+    for (;;) {
+        uint32_t swaps(swaps_);
+
+        uint64_t now(VNCMicroseconds());
+        if (clients_ != 0 && lossy_ != 0 && now - refined_ >= Quiet) {
+            refined_ = now;
+            // cleared first, so that a lossy send during the walk sets it again
+            lossy_ = 0;
+            __sync_synchronize();
+            pthread_mutex_lock(&resize_);
+            if (VNCRefine(now - Quiet))
+                lossy_ = 1;
+            // a screen that stopped changing sends no frames to age it by
+            motion_.Age(now);
+            pthread_mutex_unlock(&resize_);
+        }
+
+        if (VNCPublishable()) {
+            pthread_mutex_lock(&resize_);
+            VNCPublish();
+            pthread_mutex_unlock(&resize_);
+        }
+
+        if (swaps == done) {
+            idle_ = 1;
+            __sync_synchronize();
+
+            // while a client has lossy cells, we also wake up now and then to
+            // refine them; an encoder letting out a deferred frame, or
+            // sending something lossy, wakes us up
+            if ((swaps_ == done && !VNCPublishable()) || !__sync_bool_compare_and_swap(&idle_, 1, 0)) {
+                if (clients_ == 0 || lossy_ == 0)
+                    semaphore_wait(wake_);
+                else {
+                    mach_timespec_t timeout = {0, Quiet * 1000};
+                    semaphore_timedwait(wake_, timeout);
+                }
+            }
+            continue;
+        }
+
+        done = swaps;
+        __sync_synchronize();
+
+        IOSurfaceRef layer(__sync_lock_test_and_set(&layer_, Borrowed));
+
+        pthread_mutex_lock(&resize_);
+        OnLayer(layer);
+        pthread_mutex_unlock(&resize_);
+
+        if (!__sync_bool_compare_and_swap(&layer_, Borrowed, layer) && layer != NULL)
+            CFRelease(layer);
+    }
+
+    return NULL;
+}
+
+// this runs on the compositor's present path, so all it may do is note the
+// layer and, if the capture thread is asleep, wake it up
+
+static void OnSwap(IOMobileFramebufferRef fb) {
     if (_unlikely(width_ == 0 || height_ == 0)) {
         CGSize size;
         IOMobileFramebufferGetDisplaySize(fb, &size);
@@ -1014,32 +1684,9 @@ static void OnLayer(IOMobileFramebufferRef fb, IOSurfaceRef layer) {
 
         [thread start];
     } else if (_unlikely(clients_ != 0)) {
-        if (layer == NULL) {
-            if (accelerator_ != NULL) {
-                IOSurfaceLock(layer, 0, NULL);
-                memset(screen_->frameBuffer, 0, sizeof(rfbPixel) * width_ * height_);
-                IOSurfaceUnlock(layer, 0, NULL);
-            } else
-                VNCBlack();
-        } else {
-            if (accelerator_ != NULL)
-                IOSurfaceAcceleratorTransferSurface(accelerator_, layer, buffer_, NULL, NULL, NULL, NULL);
-            else {
-                IOSurfaceLock(layer, kIOSurfaceLockReadOnly, NULL);
-                rfbPixel *data(reinterpret_cast<rfbPixel *>(IOSurfaceGetBaseAddress(layer)));
-
-                IOSurfaceFlushProcessorCaches(layer);
-
-                /*rfbPixel corner(data[0]);
-                data[0] = 0;
-                data[0] = corner;*/
-
-                screen_->frameBuffer = const_cast<char *>(reinterpret_cast<volatile char *>(data));
-                IOSurfaceUnlock(layer, kIOSurfaceLockReadOnly, NULL);
-            }
-        }
-
-        rfbMarkRectAsModified(screen_, 0, 0, width_, height_);
+        if (swapped_ == 0)
+            __sync_bool_compare_and_swap(&swapped_, 0, VNCMicroseconds());
+        VNCStale();
     }
 }
 
@@ -1069,10 +1716,14 @@ MSHook(kern_return_t, IOMobileFramebufferSwapSetLayer,
 
     if (_likely(main)) {
         main_ = fb;
-        if (wait_)
-            layer_ = buffer;
-        else
-            OnLayer(fb, buffer);
+
+        if (buffer != NULL)
+            CFRetain(buffer);
+        IOSurfaceRef old(__sync_lock_test_and_set(&layer_, buffer));
+        if (old != NULL && old != Borrowed)
+            CFRelease(old);
+        if (!wait_)
+            OnSwap(fb);
     }
 
     return _IOMobileFramebufferSwapSetLayer(fb, layer, buffer, bounds, frame, flags);
@@ -1084,10 +1735,155 @@ extern "C" void *IOMobileFramebufferSwapWait(IOMobileFramebufferRef, void *, uns
 MSHook(void *, IOMobileFramebufferSwapWait, IOMobileFramebufferRef fb, void *arg1, unsigned flags) {
     void *value(_IOMobileFramebufferSwapWait(fb, arg1, flags));
     if (fb == main_)
-        OnLayer(fb, layer_);
+        OnSwap(fb);
     return value;
 }
 
+MSHook(void, rfbProcessClientMessage, rfbClientPtr client) {
+    _rfbProcessClientMessage(client);
+    VNCRequested(client);
+}
+
+// the part of a rect inside the video region goes to the client's codec
+static rfbBool VNCSendRectVideo(rfbClientPtr client, int quality, int x, int y, int w, int h) {
+    VeencyClient *data(reinterpret_cast<VeencyClient *>(client->clientData));
+
+    VNCRect rect = {size_t(x), size_t(y), size_t(w), size_t(h)};
+    VNCRect region, inside;
+    if (!video_ || !VNCTightParallel(client, quality) || !motion_.Region(region) || !VNCIntersect(rect, region, inside))
+        return VNCSendRectTight(pool_, &cache_, _rfbSendRectEncodingTight, data->tight_, client, quality, x, y, w, h);
+
+    VNCRect parts[4];
+    size_t count(VNCSubtract(rect, inside, parts));
+    for (size_t i(0); i != count; ++i)
+        if (!VNCSendRectTight(pool_, &cache_, _rfbSendRectEncodingTight, data->tight_, client, quality, parts[i].x, parts[i].y, parts[i].w, parts[i].h))
+            return FALSE;
+
+    if (data->video_ == NULL)
+        data->video_ = new VNCMotionJpeg(pool_, _rfbSendRectEncodingTight);
+    VNCTightMark(data->tight_, client, inside.x, inside.y, inside.w, inside.h, true);
+    return data->video_->Send(client, quality, inside.x, inside.y, inside.w, inside.h);
+}
+
+// the level we encode at is passed along rather than stored in the client,
+// which SetEncodings may be changing on the input thread as we go
+MSHook(rfbBool, rfbSendRectEncodingTight, rfbClientPtr client, int x, int y, int w, int h) {
+    VeencyClient *data(reinterpret_cast<VeencyClient *>(client->clientData));
+
+    int quality(client->tightQualityLevel);
+    if (quality != -1 && VNCRefining(data->tight_, x, y, w, h))
+        quality = -1;
+    else if (quality > data->throttle_.limit_)
+        quality = data->throttle_.limit_;
+
+    // the capture thread only comes back to refine while this is set
+    if (quality != -1 && lossy_ == 0 && __sync_bool_compare_and_swap(&lossy_, 0, 1))
+        VNCSignal();
+
+    return VNCSendRectVideo(client, quality, x, y, w, h);
+}
+
+// while a client's socket holds more than its budget, nothing new gets
+// encoded for it: modifiedRegion goes on collecting damage, and whatever has
+// changed by the time the socket drains is sent, freshly encoded, in one go;
+// either threading model asks again deferUpdateTime later
+MSHook(rfbBool, rfbSendFramebufferUpdate, rfbClientPtr client, sraRegionPtr region) {
+    if (VeencyClient *data = reinterpret_cast<VeencyClient *>(client->clientData)) {
+        size_t unsent;
+        if (!VNCBacklog(client, unsent) || unsent <= data->throttle_.Budget())
+            data->holding_ = 0;
+        else {
+            uint64_t now(VNCMicroseconds());
+            if (data->holding_ == 0)
+                data->holding_ = now;
+            // a peer that stopped reading is left for rfbWriteExact() (or the
+            // reactor, with a queue) to time out
+            if (now - data->holding_ < uint64_t(rfbMaxClientWait) * 1000) {
+                __sync_add_and_fetch(&holds_, 1);
+                return TRUE;
+            }
+        }
+    }
+
+    return _rfbSendFramebufferUpdate(client, region);
+}
+
+MSHook(int, rfbWriteExact, rfbClientPtr client, const char *buf, int len) {
+    uint64_t start(VNCMicroseconds());
+    int result;
+    if (VNCQueue *queue = VNCQueued(client)) {
+        struct iovec vector = {const_cast<char *>(buf), size_t(len)};
+        LOCK(client->outputMutex);
+        result = queue->Write(client->sock, &vector, 1);
+        UNLOCK(client->outputMutex);
+    } else
+        result = _rfbWriteExact(client, buf, len);
+    VNCWrote(client, len, VNCMicroseconds() - start);
+    return result;
+}
+
+// libvncserver picks a table-driven translation whenever the formats
+// differ; for the common ones, we substitute our own
+MSHook(rfbBool, rfbSetTranslateFunction, rfbClientPtr client) {
+    if (!_rfbSetTranslateFunction(client))
+        return FALSE;
+    if (client->translateFn != &rfbTranslateNone)
+        if (rfbTranslateFnType translate = VNCTranslateFunction(client->screen->serverFormat, client->format))
+            client->translateFn = translate;
+    return TRUE;
+}
+
+// we may send any number of rects, so make the update end with LastRect
+MSHook(int, rfbNumCodedRectsTight, rfbClientPtr client, int x, int y, int w, int h) {
+    if (VNCTightParallel(client, client->tightQualityLevel))
+        return 0;
+    return _rfbNumCodedRectsTight(client, x, y, w, h);
+}
+
+static voidpf VNCZAlloc(voidpf opaque, uInt items, uInt size) {
+    return reinterpret_cast<VNCSlabs *>(opaque)->Allocate(size_t(items) * size);
+}
+
+static void VNCZFree(voidpf opaque, voidpf address) {
+    reinterpret_cast<VNCSlabs *>(opaque)->Free(address);
+}
+
+// libz is shared with the rest of SpringBoard, so only the streams opened
+// by our own (statically linked) libvncserver are pointed at the slabs
+static void VNCZStream(z_streamp strm, void *caller) {
+    static const void *base(NULL);
+    if (base == NULL) {
+        Dl_info info;
+        if (dladdr(reinterpret_cast<void *>(&VNCZStream), &info) == 0)
+            return;
+        base = info.dli_fbase;
+    }
+
+    Dl_info info;
+    if (strm->zalloc != Z_NULL || dladdr(caller, &info) == 0 || info.dli_fbase != base)
+        return;
+
+    strm->zalloc = &VNCZAlloc;
+    strm->zfree = &VNCZFree;
+    strm->opaque = &slabs_;
+}
+
+MSHook(int, deflateInit_, z_streamp strm, int level, const char *version, int stream_size) {
+    VNCZStream(strm, __builtin_return_address(0));
+    return _deflateInit_(strm, level, version, stream_size);
+}
+
+MSHook(int, deflateInit2_, z_streamp strm, int level, int method, int windowBits, int memLevel, int strategy, const char *version, int stream_size) {
+    VNCZStream(strm, __builtin_return_address(0));
+    return _deflateInit2_(strm, level, method, windowBits, memLevel, strategy, version, stream_size);
+}
+
+// both our tiles and libvncserver's own tight.c come through here
+MSHook(void, jpeg_start_compress, j_compress_ptr cinfo, boolean write_all_tables) {
+    _jpeg_start_compress(cinfo, write_all_tables);
+    VNCJpegAccelerate(cinfo);
+}
+
 MSHook(void, rfbRegisterSecurityHandler, rfbSecurityHandler *handler) {
     NSAutoreleasePool *pool([[NSAutoreleasePool alloc] init]);
 
@@ -1135,6 +1931,15 @@ MSInitialize {
 
     MSHookFunction(&IOMobileFramebufferSwapSetLayer, MSHake(IOMobileFramebufferSwapSetLayer));
     MSHookFunction(&rfbRegisterSecurityHandler, MSHake(rfbRegisterSecurityHandler));
+    MSHookFunction(&rfbProcessClientMessage, MSHake(rfbProcessClientMessage));
+    MSHookFunction(&rfbSendRectEncodingTight, MSHake(rfbSendRectEncodingTight));
+    MSHookFunction(&rfbNumCodedRectsTight, MSHake(rfbNumCodedRectsTight));
+    MSHookFunction(&rfbSendFramebufferUpdate, MSHake(rfbSendFramebufferUpdate));
+    MSHookFunction(&rfbWriteExact, MSHake(rfbWriteExact));
+    MSHookFunction(&rfbSetTranslateFunction, MSHake(rfbSetTranslateFunction));
+    MSHookFunction(&jpeg_start_compress, MSHake(jpeg_start_compress));
+    MSHookFunction(&deflateInit_, MSHake(deflateInit_));
+    MSHookFunction(&deflateInit2_, MSHake(deflateInit2_));
 
     if (wait_)
         MSHookFunction(&IOMobileFramebufferSwapWait, MSHake(IOMobileFramebufferSwapWait));
@@ -1160,6 +1965,7 @@ MSInitialize {
     condition_ = [[NSCondition alloc] init];
     lock_ = [[NSLock alloc] init];
     handlers_ = [[NSMutableSet alloc] init];
+    waiting_ = [[NSMutableArray alloc] init];
 
     bool value;
 
@@ -0,0 +1,196 @@
+/* Veency - VNC Remote Access Server for iPhoneOS
+ * Copyright (C) 2008-2014  Jay Freeman (saurik)
+*/
+
+/* GNU Affero General Public License, Version 3 {{{ */
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+/* }}} */
+
+
+#include <string.h>
+
+#include <algorithm>
+
+#include "Video.hpp"
+
+VNCMotion::VNCMotion() :
+    width_(0),
+    height_(0),
+    columns_(0),
+    rows_(0),
+    history_(NULL),
+    updated_(0),
+    stable_(0),
+    active_(false)
+{
+    pthread_mutex_init(&mutex_, NULL);
+    memset(&candidate_, 0, sizeof(candidate_));
+    memset(&region_, 0, sizeof(region_));
+}
+
+VNCMotion::~VNCMotion() {
+    delete [] history_;
+    pthread_mutex_destroy(&mutex_);
+}
+
+void VNCMotion::Resize(size_t width, size_t height) {
+    width_ = width;
+    height_ = height;
+
+    columns_ = (width + TileSize - 1) / TileSize;
+    rows_ = (height + TileSize - 1) / TileSize;
+
+    delete [] history_;
+    history_ = new uint16_t[columns_ * rows_];
+    memset(history_, 0, columns_ * rows_ * sizeof(uint16_t));
+
+    updated_ = 0;
+    stable_ = 0;
+
+    pthread_mutex_lock(&mutex_);
+    active_ = false;
+    pthread_mutex_unlock(&mutex_);
+}
+
+// the periods since the last frame (or since we last counted them)
+unsigned VNCMotion::Missed(uint64_t now) {
+    if (updated_ == 0 || now < updated_) {
+        updated_ = now;
+        return 0;
+    }
+
+    uint64_t missed((now - updated_) / Period);
+    updated_ += missed * Period;
+    return missed < 16 ? missed : 16;
+}
+
+// this frame is one of the periods that went by
+void VNCMotion::Update(const VNCDamage &damage, uint64_t now) {
+    unsigned missed(Missed(now));
+    updated_ = now;
+    Shift(&damage, missed == 0 ? 0 : missed - 1);
+}
+
+void VNCMotion::Age(uint64_t now) {
+    if (unsigned missed = Missed(now))
+        Shift(NULL, missed - 1);
+}
+
+void VNCMotion::Shift(const VNCDamage *damage, unsigned missed) {
+    size_t left(columns_), right(0), top(rows_), bottom(0), hot(0);
+
+    for (size_t row(0); row != rows_; ++row)
+        for (size_t column(0); column != columns_; ++column) {
+            uint16_t &bits(history_[row * columns_ + column]);
+            bits = (uint32_t(bits) << missed << 1) | (damage != NULL && damage->Dirty(column, row) ? 1 : 0);
+            if (unsigned(__builtin_popcount(bits)) < HotFrames)
+                continue;
+
+            ++hot;
+            left = std::min(left, column);
+            right = std::max(right, column + 1);
+            top = std::min(top, row);
+            bottom = std::max(bottom, row + 1);
+        }
+
+    // the hot tiles have to fill most of their bounding box: two small
+    // animations at opposite corners do not make a video
+    size_t tiles(hot == 0 ? 0 : (right - left) * (bottom - top));
+    bool dense(tiles >= MinTiles && hot * 4 >= tiles * 3);
+
+    VNCRect candidate;
+    memset(&candidate, 0, sizeof(candidate));
+    if (dense) {
+        candidate.x = left * TileSize;
+        candidate.y = top * TileSize;
+        candidate.w = std::min(right * TileSize, width_) - candidate.x;
+        candidate.h = std::min(bottom * TileSize, height_) - candidate.y;
+    }
+
+    if (dense && memcmp(&candidate, &candidate_, sizeof(candidate)) == 0)
+        ++stable_;
+    else
+        stable_ = 0;
+    candidate_ = candidate;
+
+    bool active(stable_ >= StableFrames);
+
+    pthread_mutex_lock(&mutex_);
+    if (active)
+        region_ = candidate;
+    active_ = active;
+    pthread_mutex_unlock(&mutex_);
+}
+
+bool VNCMotion::Region(VNCRect &region) {
+    pthread_mutex_lock(&mutex_);
+    bool active(active_);
+    region = region_;
+    pthread_mutex_unlock(&mutex_);
+    return active;
+}
+
+VNCMotionJpeg::VNCMotionJpeg(VNCPool &pool, VNCSendRect fallback) :
+    pool_(pool),
+    fallback_(fallback)
+{
+    memset(&history_, 0, sizeof(history_));
+}
+
+// the quality is only ever lowered
+rfbBool VNCMotionJpeg::Send(rfbClientPtr client, int quality, int x, int y, int w, int h) {
+    return VNCSendRectTight(pool_, NULL, fallback_, history_, client, quality < Quality ? quality : Quality, x, y, w, h);
+}
+
+bool VNCIntersect(const VNCRect &lhs, const VNCRect &rhs, VNCRect &both) {
+    size_t left(std::max(lhs.x, rhs.x)), right(std::min(lhs.x + lhs.w, rhs.x + rhs.w));
+    size_t top(std::max(lhs.y, rhs.y)), bottom(std::min(lhs.y + lhs.h, rhs.y + rhs.h));
+    if (left >= right || top >= bottom)
+        return false;
+
+    both.x = left;
+    both.y = top;
+    both.w = right - left;
+    both.h = bottom - top;
+    return true;
+}
+
+size_t VNCSubtract(const VNCRect &outer, const VNCRect &inner, VNCRect *parts) {
+    size_t count(0);
+
+    // full-width bands above and below, then whatever is left at the sides
+    if (inner.y != outer.y) {
+        VNCRect part = {outer.x, outer.y, outer.w, inner.y - outer.y};
+        parts[count++] = part;
+    }
+
+    if (inner.y + inner.h != outer.y + outer.h) {
+        VNCRect part = {outer.x, inner.y + inner.h, outer.w, outer.y + outer.h - inner.y - inner.h};
+        parts[count++] = part;
+    }
+
+    if (inner.x != outer.x) {
+        VNCRect part = {outer.x, inner.y, inner.x - outer.x, inner.h};
+        parts[count++] = part;
+    }
+
+    if (inner.x + inner.w != outer.x + outer.w) {
+        VNCRect part = {inner.x + inner.w, inner.y, outer.x + outer.w - inner.x - inner.w, inner.h};
+        parts[count++] = part;
+    }
+
+    return count;
+}
@@ -0,0 +1,108 @@
+/* Veency - VNC Remote Access Server for iPhoneOS
+ * Copyright (C) 2008-2014  Jay Freeman (saurik)
+*/
+
+/* GNU Affero General Public License, Version 3 {{{ */
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+/* }}} */
+
+
+#ifndef VEENCY_VIDEO_HPP
+#define VEENCY_VIDEO_HPP
+
+#include <pthread.h>
+#include <stdint.h>
+
+#include "Damage.hpp"
+#include "Tight.hpp"
+
+// watches which tiles keep changing from frame to frame and, once a dense
+// rectangle of them has held still for a while, reports it as a region
+// that is better streamed as video than encoded as independent updates;
+// a screen that stops changing stops swapping, so every Period without a
+// frame counts as a frame in which nothing changed
+
+class VNCMotion {
+  private:
+    static const unsigned HotFrames = 12;
+    static const unsigned StableFrames = 8;
+    static const size_t MinTiles = 6;
+    static const uint64_t Period = 100000;
+
+    size_t width_, height_;
+    size_t columns_, rows_;
+
+    // one bit per frame for each tile, the newest lowest
+    uint16_t *history_;
+
+    uint64_t updated_;
+
+    VNCRect candidate_;
+    unsigned stable_;
+
+    pthread_mutex_t mutex_;
+    VNCRect region_;
+    bool active_;
+
+  public:
+    VNCMotion();
+    ~VNCMotion();
+
+    void Resize(size_t width, size_t height);
+
+    // call for every frame, changed or not; damage must match Resize()
+    void Update(const VNCDamage &damage, uint64_t now);
+    // call now and then, frames or not
+    void Age(uint64_t now);
+
+    bool Region(VNCRect &region);
+
+  private:
+    unsigned Missed(uint64_t now);
+    void Shift(const VNCDamage *damage, unsigned missed);
+};
+
+// how a client's part of the video region gets encoded: a codec with
+// reference frames would keep them here, which is why each client has one
+struct VNCVideoCodec {
+    virtual ~VNCVideoCodec() {}
+    virtual rfbBool Send(rfbClientPtr client, int quality, int x, int y, int w, int h) = 0;
+};
+
+// Tight JPEG at a capped quality level, skipping the tile cache (which
+// video would only churn); it works with any viewer that speaks Tight
+class VNCMotionJpeg :
+    public VNCVideoCodec
+{
+  private:
+    static const int Quality = 3;
+
+    VNCPool &pool_;
+    VNCSendRect fallback_;
+    VNCTightHistory history_;
+
+  public:
+    VNCMotionJpeg(VNCPool &pool, VNCSendRect fallback);
+
+    virtual rfbBool Send(rfbClientPtr client, int quality, int x, int y, int w, int h);
+};
+
+bool VNCIntersect(const VNCRect &lhs, const VNCRect &rhs, VNCRect &both);
+
+// the up to four rects that make up outer minus inner (inside outer)
+size_t VNCSubtract(const VNCRect &outer, const VNCRect &inner, VNCRect *parts);
+
+#endif//VEENCY_VIDEO_HPP
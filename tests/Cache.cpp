@@ -0,0 +1,185 @@
+/* Veency - VNC Remote Access Server for iPhoneOS
+ * Copyright (C) 2008-2014  Jay Freeman (saurik)
+*/
+
+/* GNU Affero General Public License, Version 3 {{{ */
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+/* }}} */
+
+
+#include <string.h>
+#include <unistd.h>
+
+#include <pthread.h>
+
+#include <vector>
+
+#include "Cache.hpp"
+#include "Test.hpp"
+
+static VNCEncoded *Encoded(size_t size, unsigned char value) {
+    unsigned char *data(reinterpret_cast<unsigned char *>(malloc(size)));
+    memset(data, value, size);
+    return new VNCEncoded(data, size);
+}
+
+static void Hash() {
+    std::vector<uint32_t> frame(64 * 64, 0x00123456);
+    uint64_t hash(VNCTileCache::Hash(reinterpret_cast<uint8_t *>(&frame[0]), 64 * 4, 64, 64, 0));
+
+    // the padding byte is not part of the picture
+    frame[100] |= 0xff000000;
+    VNCExpect(VNCTileCache::Hash(reinterpret_cast<uint8_t *>(&frame[0]), 64 * 4, 64, 64, 0) == hash);
+
+    // but every pixel, the size and the seed are
+    frame[4095] ^= 1;
+    VNCExpect(VNCTileCache::Hash(reinterpret_cast<uint8_t *>(&frame[0]), 64 * 4, 64, 64, 0) != hash);
+    frame[4095] ^= 1;
+    VNCExpect(VNCTileCache::Hash(reinterpret_cast<uint8_t *>(&frame[0]), 64 * 4, 64, 63, 0) != hash);
+    VNCExpect(VNCTileCache::Hash(reinterpret_cast<uint8_t *>(&frame[0]), 64 * 4, 64, 64, 1) != hash);
+
+    // odd widths read only the pixels inside
+    VNCExpect(VNCTileCache::Hash(reinterpret_cast<uint8_t *>(&frame[0]), 64 * 4, 63, 64, 0) != hash);
+}
+
+static void Simple() {
+    VNCTileCache cache;
+
+    VNCExpect(cache.Find(1) == NULL);
+    VNCEncoded *encoded(Encoded(100, 1));
+    cache.Insert(1, encoded, 50);
+    encoded->Release();
+
+    VNCEncoded *hit(cache.Find(1));
+    VNCExpect(hit == encoded && hit->size_ == 100 && hit->data_[99] == 1);
+    hit->Release();
+    VNCExpect(cache.hits_ == 1 && cache.misses_ == 1 && cache.saved_ == 50);
+
+    // a miss that gives up leaves the key free for the next one to claim
+    VNCExpect(cache.Find(2) == NULL);
+    cache.Abandon(2);
+    VNCExpect(cache.Find(2) == NULL);
+    cache.Abandon(2);
+
+    // tiles too large to be worth keeping are turned away
+    VNCExpect(cache.Find(3) == NULL);
+    encoded = Encoded(1 << 20, 3);
+    cache.Insert(3, encoded, 50);
+    encoded->Release();
+    VNCExpect(cache.Find(3) == NULL);
+    cache.Abandon(3);
+
+    // keys sharing a set push out the least recently used
+    for (uint64_t key(16); key <= 16 * 5; key += 16) {
+        VNCExpect(cache.Find(key) == NULL);
+        encoded = Encoded(10, key);
+        cache.Insert(key, encoded, 1);
+        encoded->Release();
+        if (key == 16 * 3)
+            cache.Find(16)->Release();
+    }
+
+    hit = cache.Find(16);
+    VNCExpect(hit != NULL);
+    hit->Release();
+    VNCExpect(cache.Find(32) == NULL);
+    cache.Abandon(32);
+}
+
+// sized for a screen, keys that shared a set no longer push each other out,
+// but the tiles together still stay under 16MB, the oldest going first
+static void Sized() {
+    VNCTileCache cache;
+    cache.Resize(1024);
+
+    for (uint64_t key(16); key <= 16 * 5; key += 16) {
+        VNCExpect(cache.Find(key) == NULL);
+        VNCEncoded *encoded(Encoded(10, key));
+        cache.Insert(key, encoded, 1);
+        encoded->Release();
+    }
+
+    for (uint64_t key(16); key <= 16 * 5; key += 16) {
+        VNCEncoded *hit(cache.Find(key));
+        VNCExpect(hit != NULL);
+        hit->Release();
+    }
+
+    VNCExpect(cache.bytes_ == 50);
+
+    for (uint64_t key(1000); key != 1300; ++key) {
+        VNCExpect(cache.Find(key) == NULL);
+        VNCEncoded *encoded(Encoded(60 << 10, key));
+        cache.Insert(key, encoded, 1);
+        encoded->Release();
+    }
+
+    VNCExpect(cache.bytes_ <= 16 << 20 && cache.bytes_ > (16 << 20) - (60 << 10));
+    VNCExpect(cache.Find(16) == NULL);
+    cache.Abandon(16);
+    VNCExpect(cache.Find(1000) == NULL);
+    cache.Abandon(1000);
+
+    VNCEncoded *hit(cache.Find(1299));
+    VNCExpect(hit != NULL);
+    hit->Release();
+
+    // and starting over forgets it all
+    cache.Resize(16);
+    VNCExpect(cache.bytes_ == 0 && cache.Find(1299) == NULL);
+    cache.Abandon(1299);
+}
+
+// viewers in step all want the same tile: one encodes, the rest wait
+
+static VNCTileCache cache_;
+static volatile unsigned encodes_;
+
+static void *View(void *) {
+    for (uint64_t key(1000); key != 1100; ++key) {
+        VNCEncoded *encoded(cache_.Find(key));
+        if (encoded == NULL) {
+            __sync_add_and_fetch(&encodes_, 1);
+            usleep(200);
+            encoded = Encoded(64, key);
+            cache_.Insert(key, encoded, 200);
+        }
+
+        VNCExpect(encoded->size_ == 64 && encoded->data_[0] == static_cast<unsigned char>(key));
+        encoded->Release();
+    }
+
+    return NULL;
+}
+
+static void Threads() {
+    pthread_t threads[4];
+    for (unsigned i(0); i != 4; ++i)
+        pthread_create(&threads[i], NULL, &View, NULL);
+    for (unsigned i(0); i != 4; ++i)
+        pthread_join(threads[i], NULL);
+
+    VNCExpect(encodes_ == 100);
+    VNCExpect(cache_.hits_ == 300 && cache_.misses_ == 100);
+}
+
+int main() {
+    Hash();
+    Simple();
+    Sized();
+    Threads();
+    return 0;
+}
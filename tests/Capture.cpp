@@ -0,0 +1,278 @@
+/* Veency - VNC Remote Access Server for iPhoneOS
+ * Copyright (C) 2008-2014  Jay Freeman (saurik)
+*/
+
+/* GNU Affero General Public License, Version 3 {{{ */
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+/* }}} */
+
+
+#include <string.h>
+#include <unistd.h>
+
+#include <pthread.h>
+
+#include <vector>
+
+#include "Capture.hpp"
+#include "Test.hpp"
+
+static const size_t Width = 200;
+static const size_t Height = 150;
+
+static void Fill(std::vector<uint32_t> &frame, uint32_t value) {
+    frame.assign(Width * Height, value);
+}
+
+static uint32_t Pixel(char *frame, size_t x, size_t y) {
+    return reinterpret_cast<uint32_t *>(frame)[y * Width + x];
+}
+
+static void Simple() {
+    VNCCapture capture;
+    char *target(NULL);
+    capture.Resize(Width, Height, &target);
+    VNCExpect(target != NULL && Pixel(target, 0, 0) == 0);
+
+    std::vector<uint32_t> frame;
+    Fill(frame, 1);
+    VNCExpect(capture.Produce(reinterpret_cast<uint8_t *>(&frame[0]), Width * 4) == 12);
+    VNCExpect(Pixel(target, 0, 0) == 1 && Pixel(target, Width - 1, Height - 1) == 1);
+    VNCExpect(capture.Sequence() == 1);
+
+    // nothing changed, so nothing is published
+    VNCExpect(capture.Produce(reinterpret_cast<uint8_t *>(&frame[0]), Width * 4) == 0);
+    VNCExpect(capture.Sequence() == 1);
+
+    // each slot catches up on the tiles it missed while others were front,
+    // and the one before stays whole for Scroll to check copies against
+    for (uint32_t value(2); value != 8; ++value) {
+        std::vector<uint32_t> before(frame);
+        frame[(value * 20) % Height * Width + (value * 30) % Width] = value;
+        VNCExpect(capture.Produce(reinterpret_cast<uint8_t *>(&frame[0]), Width * 4) == 1);
+        VNCExpect(memcmp(target, &frame[0], Width * Height * 4) == 0);
+        VNCExpect(capture.previous_ != VNCCapture::None && memcmp(capture.slots_[capture.previous_], &before[0], Width * Height * 4) == 0);
+    }
+
+    VNCExpect(capture.Blank() == 12);
+    for (size_t y(0); y != Height; ++y)
+        for (size_t x(0); x != Width; ++x)
+            VNCExpect(Pixel(target, x, y) == 0);
+}
+
+// readers check that the frame they hold stays whole, however long they
+// hold it and whatever the producer does meanwhile
+
+static VNCCapture capture_;
+static char *target_;
+static volatile bool done_;
+
+static void *Read(void *arg) {
+    VNCRandom random(reinterpret_cast<uintptr_t>(arg));
+    unsigned reads(0);
+
+    while (!done_) {
+        unsigned parity(capture_.Acquire());
+        for (unsigned pass(0); pass != 3; ++pass) {
+            const uint32_t *frame(reinterpret_cast<const uint32_t *>(*const_cast<char *volatile *>(&target_)));
+            uint32_t value(frame[0]);
+            for (size_t i(0); i != Width * Height; ++i)
+                VNCExpect(frame[i] == value);
+        }
+        if (random.Below(4) == 0)
+            usleep(random.Below(200));
+        capture_.Release(parity);
+        ++reads;
+    }
+
+    VNCExpect(reads != 0);
+    return NULL;
+}
+
+static void Threads() {
+    capture_.Resize(Width, Height, &target_);
+
+    pthread_t threads[4];
+    for (uintptr_t i(0); i != 4; ++i)
+        pthread_create(&threads[i], NULL, &Read, reinterpret_cast<void *>(i + 1));
+
+    std::vector<uint32_t> frame;
+    for (uint32_t value(1); value != 5000; ++value) {
+        Fill(frame, value);
+        capture_.Produce(reinterpret_cast<uint8_t *>(&frame[0]), Width * 4);
+    }
+
+    done_ = true;
+    for (unsigned i(0); i != 4; ++i)
+        pthread_join(threads[i], NULL);
+
+    // with the readers gone, the last frame has made it to the front
+    VNCExpect(Pixel(target_, 0, 0) == 4999);
+}
+
+// an encoder from before the last flip holds the ring up: the frame after
+// stays ready, and anyone arriving meanwhile still reads the one before
+
+static void Straggler() {
+    VNCCapture capture;
+    char *target(NULL);
+    capture.Resize(Width, Height, &target);
+
+    std::vector<uint32_t> frame;
+    unsigned straggler(capture.Acquire());
+
+    Fill(frame, 1);
+    capture.Produce(reinterpret_cast<uint8_t *>(&frame[0]), Width * 4);
+    VNCExpect(!capture.Pending() && Pixel(target, 0, 0) == 1);
+
+    Fill(frame, 2);
+    capture.Produce(reinterpret_cast<uint8_t *>(&frame[0]), Width * 4);
+    VNCExpect(capture.Pending() && Pixel(target, 0, 0) == 1);
+
+    unsigned reader(capture.Acquire());
+    VNCExpect(Pixel(target, 0, 0) == 1);
+    VNCExpect(!capture.Release(reader));
+    VNCExpect(capture.Pending());
+
+    VNCExpect(capture.Release(straggler));
+    VNCExpect(!capture.Pending() && Pixel(target, 0, 0) == 2);
+    VNCExpect(capture.Sequence() == 2);
+}
+
+// viewers copy whatever was marked modified out of the front, as encoders
+// do, and clear it; marking damage only once Pending() says its frame is
+// out must leave every one of them with the last frame
+
+static pthread_mutex_t mutex_ = PTHREAD_MUTEX_INITIALIZER;
+
+struct Viewer {
+    std::vector<uint32_t> view_;
+    std::vector<VNCRect> modified_;
+};
+
+static Viewer viewers_[4];
+static std::vector<VNCRect> deferred_;
+
+static void Mark(const std::vector<VNCRect> &rects) {
+    pthread_mutex_lock(&mutex_);
+    for (unsigned i(0); i != 4; ++i)
+        viewers_[i].modified_.insert(viewers_[i].modified_.end(), rects.begin(), rects.end());
+    pthread_mutex_unlock(&mutex_);
+}
+
+static void Publish() {
+    if (deferred_.empty() || capture_.Pending())
+        return;
+    Mark(deferred_);
+    deferred_.clear();
+}
+
+static void Update(Viewer &viewer, VNCRandom &random) {
+    unsigned parity(capture_.Acquire());
+
+    pthread_mutex_lock(&mutex_);
+    std::vector<VNCRect> modified;
+    modified.swap(viewer.modified_);
+    pthread_mutex_unlock(&mutex_);
+
+    const uint32_t *frame(reinterpret_cast<const uint32_t *>(*const_cast<char *volatile *>(&target_)));
+    for (size_t i(0); i != modified.size(); ++i) {
+        const VNCRect &rect(modified[i]);
+        for (size_t y(rect.y); y != rect.y + rect.h; ++y)
+            memcpy(&viewer.view_[y * Width + rect.x], &frame[y * Width + rect.x], rect.w * 4);
+    }
+
+    // the encoder is still sending, and the ring is moving on without it
+    usleep(random.Below(300));
+    capture_.Release(parity);
+}
+
+static void *View(void *arg) {
+    Viewer &viewer(*reinterpret_cast<Viewer *>(arg));
+    VNCRandom random(reinterpret_cast<uintptr_t>(arg));
+
+    while (!done_) {
+        Update(viewer, random);
+        usleep(random.Below(100));
+    }
+
+    Update(viewer, random);
+    return NULL;
+}
+
+static void Viewers() {
+    capture_.Resize(Width, Height, &target_);
+
+    std::vector<uint32_t> frame;
+    Fill(frame, 7);
+    capture_.Produce(reinterpret_cast<uint8_t *>(&frame[0]), Width * 4);
+
+    done_ = false;
+    pthread_t threads[4];
+    for (unsigned i(0); i != 4; ++i) {
+        viewers_[i].view_.assign(frame.begin(), frame.end());
+        pthread_create(&threads[i], NULL, &View, &viewers_[i]);
+    }
+
+    VNCRandom random(99);
+    unsigned deferrals(0);
+
+    for (uint32_t value(1); value != 3000; ++value) {
+        Publish();
+
+        size_t x(random.Below(Width - 16)), y(random.Below(Height - 16));
+        for (size_t row(y); row != y + 16; ++row)
+            for (size_t column(x); column != x + 16; ++column)
+                frame[row * Width + column] = value;
+        if (capture_.Produce(reinterpret_cast<uint8_t *>(&frame[0]), Width * 4) == 0)
+            continue;
+
+        std::vector<VNCRect> rects(capture_.damage_.rects_, capture_.damage_.rects_ + capture_.damage_.count_);
+        if (capture_.Pending()) {
+            deferred_.insert(deferred_.end(), rects.begin(), rects.end());
+            ++deferrals;
+        } else {
+            Publish();
+            Mark(rects);
+        }
+
+        usleep(random.Below(50));
+    }
+
+    while (!deferred_.empty()) {
+        Publish();
+        usleep(100);
+    }
+
+    done_ = true;
+    for (unsigned i(0); i != 4; ++i)
+        pthread_join(threads[i], NULL);
+
+    VNCExpect(memcmp(target_, &frame[0], Width * Height * 4) == 0);
+    for (unsigned i(0); i != 4; ++i)
+        VNCExpect(viewers_[i].view_ == frame);
+
+    // otherwise this has not tested anything
+    VNCExpect(deferrals != 0);
+}
+
+int main() {
+    Simple();
+    Straggler();
+    Threads();
+    Viewers();
+    return 0;
+}
@@ -0,0 +1,158 @@
+/* Veency - VNC Remote Access Server for iPhoneOS
+ * Copyright (C) 2008-2014  Jay Freeman (saurik)
+*/
+
+/* GNU Affero General Public License, Version 3 {{{ */
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+/* }}} */
+
+
+#include <fcntl.h>
+#include <string.h>
+
+#include <vector>
+
+#include "Corpus.hpp"
+
+// a small corpus of screens (UI and text, a photo, and half of each) sent
+// as whole frames, drifting a little each time: bytes and encode time per
+// frame as the classifier picks, and with every tile forced to JPEG or to
+// lossless zlib; the history is seeded every frame to force either way
+
+static const int Width = 640;
+static const int Height = 1136;
+static const unsigned Frames = 10;
+
+// white, with a toolbar, rows of text and a few icons
+static void VNCInterface(std::vector<uint32_t> &frame, VNCRandom &random, unsigned number, int top, int bottom) {
+    if (top == bottom)
+        return;
+
+    static const VNCFont font;
+
+    for (int y(top); y != bottom; ++y)
+        for (int x(0); x != Width; ++x)
+            frame[y * Width + x] = y < top + 64 ? 0xf7f7f7 : 0xffffff;
+
+    for (int line(top + 80); line + 16 <= bottom; line += 24)
+        for (int x(16 + (line / 24 + number) % 3 * 8); x + 8 <= Width - 16; x += 8) {
+            unsigned glyph(random.Below(40));
+            if (glyph >= VNCFont::Glyphs)
+                continue;
+            for (int y(0); y != VNCFont::Height; ++y)
+                for (int i(0); i != VNCFont::Width; ++i)
+                    frame[(line + y) * Width + x + i] = font.Pixel(glyph, i, y);
+        }
+
+    for (int icon(0); icon != 4; ++icon)
+        for (int y(top + 8); y != top + 56; ++y)
+            for (int x(0); x != 48; ++x) {
+                uint32_t red(icon * 60 + x * 2), green(0x80 + y - top), blue(0xc0 - x);
+                frame[y * Width + 32 + icon * 150 + x] = red << 16 | green << 8 | blue;
+            }
+}
+
+// smooth gradients under a little sensor noise
+static void VNCPhoto(std::vector<uint32_t> &frame, VNCRandom &random, unsigned number, int top, int bottom) {
+    for (int y(top); y != bottom; ++y)
+        for (int x(0); x != Width; ++x) {
+            uint32_t red((x + number * 7) / 3 & 0xff), green((y + x / 2) / 5 & 0xff), blue((x + y + number * 5) / 8 & 0xff);
+            frame[y * Width + x] = (red << 16 | green << 8 | blue) ^ (random.Next() & 0x070707);
+        }
+}
+
+enum VNCMode {
+    VNCClassify,
+    VNCJpegOnly,
+    VNCLosslessOnly,
+};
+
+static void VNCBench(VNCPool &pool, rfbScreenInfo &screen, std::vector<uint32_t> &frame, const char *name, int photo, int interface) {
+    static const char *Modes[] = {"classified", "all JPEG", "all lossless"};
+    printf("%s:", name);
+
+    for (unsigned mode(VNCClassify); mode <= VNCLosslessOnly; ++mode) {
+        rfbClientRec client;
+        memset(&client, 0, sizeof(client));
+        client.screen = &screen;
+        client.scaledScreen = &screen;
+        client.sock = open("/dev/null", O_WRONLY);
+        client.format = screen.serverFormat;
+        client.enableLastRectEncoding = TRUE;
+        client.tightQualityLevel = 5;
+        pthread_mutex_init(&client.outputMutex, NULL);
+
+        VNCZlibStart();
+
+        VNCTightHistory history;
+        memset(&history, 0, sizeof(history));
+
+        VNCRandom random(15);
+        uint64_t elapsed(0);
+
+        for (unsigned number(0); number != Frames; ++number) {
+            VNCPhoto(frame, random, number, 0, photo);
+            VNCInterface(frame, random, number, photo, photo + interface);
+
+            // a cost of 1 for one and 255 for the other decides every tile
+            if (mode != VNCClassify) {
+                memset(history.jpeg_, mode == VNCJpegOnly ? 1 : 255, sizeof(history.jpeg_));
+                memset(history.lossless_, mode == VNCJpegOnly ? 255 : 1, sizeof(history.lossless_));
+            }
+
+            uint64_t start(VNCMicroseconds());
+            VNCExpect(VNCSendRectTight(pool, NULL, &VNCSendZlib, history, &client, 5, 0, 0, Width, Height));
+            elapsed += VNCMicroseconds() - start;
+        }
+
+        printf("%s %s %.1fKB %.1fms", mode == VNCClassify ? "" : ",", Modes[mode],
+            rfbStatLookupEncoding(&client, rfbEncodingTight)->bytesSent / 1000.0 / Frames, elapsed / 1000.0 / Frames);
+
+        VNCZlibStop();
+        rfbCloseClient(&client);
+        pthread_mutex_destroy(&client.outputMutex);
+    }
+
+    printf(" per frame\n");
+}
+
+int main() {
+    VNCPool pool;
+    pool.Start(0);
+
+    std::vector<uint32_t> frame(Width * Height);
+
+    rfbScreenInfo screen;
+    memset(&screen, 0, sizeof(screen));
+    screen.width = Width;
+    screen.height = Height;
+    screen.paddedWidthInBytes = Width * 4;
+    screen.frameBuffer = reinterpret_cast<char *>(&frame[0]);
+    screen.serverFormat.bitsPerPixel = 32;
+    screen.serverFormat.depth = 24;
+    screen.serverFormat.trueColour = TRUE;
+    screen.serverFormat.redMax = 0xff;
+    screen.serverFormat.greenMax = 0xff;
+    screen.serverFormat.blueMax = 0xff;
+    screen.serverFormat.redShift = 16;
+    screen.serverFormat.greenShift = 8;
+    screen.serverFormat.blueShift = 0;
+
+    VNCBench(pool, screen, frame, "interface", 0, Height);
+    VNCBench(pool, screen, frame, "photo", Height, 0);
+    VNCBench(pool, screen, frame, "half each", Height / 2, Height - Height / 2);
+    return 0;
+}
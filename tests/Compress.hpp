@@ -0,0 +1,117 @@
+/* Veency - VNC Remote Access Server for iPhoneOS
+ * Copyright (C) 2008-2014  Jay Freeman (saurik)
+*/
+
+/* GNU Affero General Public License, Version 3 {{{ */
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+/* }}} */
+
+
+#ifndef VEENCY_TESTS_COMPRESS_HPP
+#define VEENCY_TESTS_COMPRESS_HPP
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <vector>
+
+// so that we can check the hooks took
+#define JPEG_INTERNALS
+
+extern "C" {
+#include <jpeglib.h>
+}
+
+#include "Jpeg.hpp"
+
+// how the pixels reach libjpeg: Stock is jpeg-9a as shipped, Accelerated
+// is what the jpeg_start_compress hook makes of it, and Direct is that plus
+// BGRX rows read straight from the framebuffer, as the tiled encoder does
+enum VNCPath {
+    VNCStock,
+    VNCAccelerated,
+    VNCDirect
+};
+
+// a BGRX image, compressed as Tight.cpp sets up its compressor
+static std::vector<uint8_t> VNCCompress(const std::vector<uint8_t> &image, size_t width, size_t height, int quality, bool subsample, VNCPath path) {
+    jpeg_compress_struct cinfo;
+    jpeg_error_mgr error;
+    cinfo.err = jpeg_std_error(&error);
+
+    jpeg_create_compress(&cinfo);
+
+    unsigned char *data(NULL);
+    unsigned long size(0);
+    jpeg_mem_dest(&cinfo, &data, &size);
+
+    cinfo.image_width = width;
+    cinfo.image_height = height;
+    cinfo.input_components = 3;
+    cinfo.in_color_space = JCS_RGB;
+
+    jpeg_set_defaults(&cinfo);
+    jpeg_set_quality(&cinfo, quality, TRUE);
+
+    if (!subsample) {
+        cinfo.comp_info[0].h_samp_factor = 1;
+        cinfo.comp_info[0].v_samp_factor = 1;
+    }
+
+    jpeg_start_compress(&cinfo, TRUE);
+
+    if (path != VNCStock) {
+        void (*convert)(j_compress_ptr, JSAMPARRAY, JSAMPIMAGE, JDIMENSION, int)(cinfo.cconvert->color_convert);
+        void (*dct)(j_compress_ptr, jpeg_component_info *, JSAMPARRAY, JBLOCKROW, JDIMENSION, JDIMENSION, JDIMENSION)(cinfo.fdct->forward_DCT[0]);
+        VNCJpegAccelerate(&cinfo);
+        if (cinfo.cconvert->color_convert == convert || cinfo.fdct->forward_DCT[0] == dct) {
+            fprintf(stderr, "VNCJpegAccelerate() left libjpeg alone\n");
+            abort();
+        }
+    }
+
+    if (path == VNCDirect && !VNCJpegInputBGRX(&cinfo)) {
+        fprintf(stderr, "VNCJpegInputBGRX() refused an RGB compressor\n");
+        abort();
+    }
+
+    std::vector<uint8_t> row(width * 3);
+    while (cinfo.next_scanline != cinfo.image_height) {
+        const uint8_t *in(&image[cinfo.next_scanline * width * 4]);
+        JSAMPROW rows[1];
+        if (path == VNCDirect)
+            rows[0] = const_cast<uint8_t *>(in);
+        else {
+            for (size_t x(0); x != width; ++x) {
+                row[x * 3 + 0] = in[x * 4 + 2];
+                row[x * 3 + 1] = in[x * 4 + 1];
+                row[x * 3 + 2] = in[x * 4 + 0];
+            }
+            rows[0] = &row[0];
+        }
+        jpeg_write_scanlines(&cinfo, rows, 1);
+    }
+
+    jpeg_finish_compress(&cinfo);
+    jpeg_destroy_compress(&cinfo);
+
+    std::vector<uint8_t> jpeg(data, data + size);
+    free(data);
+    return jpeg;
+}
+
+#endif//VEENCY_TESTS_COMPRESS_HPP
@@ -0,0 +1,103 @@
+/* Veency - VNC Remote Access Server for iPhoneOS
+ * Copyright (C) 2008-2014  Jay Freeman (saurik)
+*/
+
+/* GNU Affero General Public License, Version 3 {{{ */
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+/* }}} */
+
+
+
+#ifndef VEENCY_TESTS_CORPUS_HPP
+#define VEENCY_TESTS_CORPUS_HPP
+
+#include <string.h>
+
+#include <vector>
+
+#include <zlib.h>
+
+#include "Tight.hpp"
+#include "Test.hpp"
+
+// what the benchmarks that count bytes share: a made-up font, as text
+// repeats itself in a way that noise does not, and a stand-in for tight.c
+
+// 32 anti-aliased glyphs of 8x14, the top rows and right column left blank
+struct VNCFont {
+    static const unsigned Glyphs = 32;
+    static const int Width = 8;
+    static const int Height = 14;
+
+    uint8_t ink_[Glyphs][Height][Width];
+
+    VNCFont() {
+        static const uint8_t Inks[] = {0, 0, 0, 0, 0x40, 0x80, 0xc0, 0xff, 0xff};
+        VNCRandom random(32);
+        for (unsigned glyph(0); glyph != Glyphs; ++glyph)
+            for (int y(0); y != Height; ++y)
+                for (int x(0); x != Width; ++x)
+                    ink_[glyph][y][x] = y < 3 || x == Width - 1 ? 0 : Inks[random.Below(sizeof(Inks))];
+    }
+
+    // dark gray on white
+    uint32_t Pixel(unsigned glyph, int x, int y) const {
+        uint32_t level(0xff - ink_[glyph][y][x] * 0xcc / 0xff);
+        return level << 16 | level << 8 | level;
+    }
+};
+
+static z_stream zlib_;
+
+static void VNCZlibStart() {
+    memset(&zlib_, 0, sizeof(zlib_));
+    VNCExpect(deflateInit2(&zlib_, 6, Z_DEFLATED, MAX_WBITS, MAX_MEM_LEVEL, Z_DEFAULT_STRATEGY) == Z_OK);
+}
+
+static void VNCZlibStop() {
+    deflateEnd(&zlib_);
+}
+
+// tight.c's full-color zlib, near enough: pixels packed to 24 bits and
+// run through one stream kept for the client; palette tiles go the same
+// way, which flatters whatever is being compared equally
+static rfbBool VNCSendZlib(rfbClientPtr client, int x, int y, int w, int h) {
+    rfbScreenInfoPtr screen(client->scaledScreen);
+    static std::vector<uint8_t> packed, output;
+    packed.resize(w * h * 3);
+    output.resize(deflateBound(&zlib_, packed.size()) + 16);
+
+    uint8_t *next(&packed[0]);
+    for (int row(0); row != h; ++row) {
+        const uint8_t *pixel(reinterpret_cast<uint8_t *>(screen->frameBuffer) + (y + row) * screen->paddedWidthInBytes + x * 4);
+        for (int column(0); column != w; ++column, pixel += 4) {
+            *next++ = pixel[2];
+            *next++ = pixel[1];
+            *next++ = pixel[0];
+        }
+    }
+
+    zlib_.next_in = &packed[0];
+    zlib_.avail_in = packed.size();
+    zlib_.next_out = &output[0];
+    zlib_.avail_out = output.size();
+    VNCExpect(deflate(&zlib_, Z_SYNC_FLUSH) == Z_OK);
+
+    rfbStatRecordEncodingSent(client, rfbEncodingTight, sz_rfbFramebufferUpdateRectHeader + 4 + output.size() - zlib_.avail_out, w * h * 4);
+    return TRUE;
+}
+
+#endif//VEENCY_TESTS_CORPUS_HPP
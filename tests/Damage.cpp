@@ -0,0 +1,136 @@
+/* Veency - VNC Remote Access Server for iPhoneOS
+ * Copyright (C) 2008-2014  Jay Freeman (saurik)
+*/
+
+/* GNU Affero General Public License, Version 3 {{{ */
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+/* }}} */
+
+
+#include <string.h>
+
+#include <vector>
+
+#include "Damage.hpp"
+#include "Test.hpp"
+
+// the tiles whose pixels differ, found the slow way
+static void Expected(const std::vector<uint32_t> &prev, const std::vector<uint32_t> &next, size_t stride, size_t width, size_t height, std::vector<bool> &dirty) {
+    size_t columns((width + TileSize - 1) / TileSize);
+    size_t rows((height + TileSize - 1) / TileSize);
+    dirty.assign(columns * rows, false);
+
+    for (size_t y(0); y != height; ++y)
+        for (size_t x(0); x != width; ++x)
+            if (prev[y * width + x] != next[y * stride + x])
+                dirty[y / TileSize * columns + x / TileSize] = true;
+}
+
+// every pixel of every dirty tile is covered by exactly one rect, and no
+// rect strays outside the dirty tiles or the frame
+static void Covers(const VNCDamage &damage) {
+    std::vector<unsigned> hits(damage.width_ * damage.height_, 0);
+
+    for (size_t i(0); i != damage.count_; ++i) {
+        const VNCRect &rect(damage.rects_[i]);
+        VNCExpect(rect.w != 0 && rect.h != 0);
+        VNCExpect(rect.x + rect.w <= damage.width_ && rect.y + rect.h <= damage.height_);
+        for (size_t y(rect.y); y != rect.y + rect.h; ++y)
+            for (size_t x(rect.x); x != rect.x + rect.w; ++x) {
+                VNCExpect(damage.Dirty(x / TileSize, y / TileSize));
+                ++hits[y * damage.width_ + x];
+            }
+    }
+
+    for (size_t y(0); y != damage.height_; ++y)
+        for (size_t x(0); x != damage.width_; ++x)
+            VNCExpect(hits[y * damage.width_ + x] == (damage.Dirty(x / TileSize, y / TileSize) ? 1 : 0));
+}
+
+static void Fixed() {
+    size_t width(200), height(130);
+    std::vector<uint32_t> prev(width * height, 0), next(prev);
+
+    VNCDamage damage;
+    damage.Resize(width, height);
+    VNCExpect(damage.columns_ == 4 && damage.rows_ == 3);
+
+    // a fresh (or invalidated) damage reports everything once
+    VNCExpect(damage.Compare(reinterpret_cast<uint8_t *>(&prev[0]), width * 4, reinterpret_cast<uint8_t *>(&next[0]), width * 4) == 12);
+    Covers(damage);
+    VNCExpect(damage.Compare(reinterpret_cast<uint8_t *>(&prev[0]), width * 4, reinterpret_cast<uint8_t *>(&next[0]), width * 4) == 0);
+    VNCExpect(damage.count_ == 0);
+
+    // the ragged right column and bottom row, and a vertical run to merge
+    next[70 * width + 199] = 1;
+    next[10 * width + 5] = 1;
+    next[100 * width + 5] = 1;
+    next[129 * width + 130] = 1;
+    VNCExpect(damage.Compare(reinterpret_cast<uint8_t *>(&prev[0]), width * 4, reinterpret_cast<uint8_t *>(&next[0]), width * 4) == 4);
+    VNCExpect(damage.Dirty(size_t(3), size_t(1)) && damage.Dirty(size_t(0), size_t(0)) && damage.Dirty(size_t(0), size_t(1)) && damage.Dirty(size_t(2), size_t(2)));
+    Covers(damage);
+    VNCExpect(damage.count_ == 3);
+
+    damage.Invalidate();
+    VNCExpect(damage.Compare(reinterpret_cast<uint8_t *>(&next[0]), width * 4, reinterpret_cast<uint8_t *>(&next[0]), width * 4) == 12);
+
+    VNCExpect(damage.All() == 12);
+    VNCExpect(damage.count_ == 1);
+    VNCExpect(damage.rects_[0].w == width && damage.rects_[0].h == height);
+}
+
+static void Random() {
+    VNCRandom random(1);
+
+    for (unsigned round(0); round != 300; ++round) {
+        size_t width(1 + random.Below(400)), height(1 + random.Below(300));
+        size_t stride(width + random.Below(20));
+
+        std::vector<uint32_t> prev(width * height), next(stride * height);
+        for (size_t i(0); i != prev.size(); ++i)
+            prev[i] = random.Next();
+        for (size_t y(0); y != height; ++y)
+            memcpy(&next[y * stride], &prev[y * width], width * 4);
+
+        // a few changes, sometimes in the last byte of a pixel only
+        for (unsigned i(random.Below(8)); i != 0; --i) {
+            size_t x(random.Below(width)), y(random.Below(height));
+            next[y * stride + x] ^= 1u << random.Below(32);
+        }
+
+        VNCDamage damage;
+        damage.Resize(width, height);
+        damage.Compare(reinterpret_cast<uint8_t *>(&prev[0]), width * 4, reinterpret_cast<uint8_t *>(&prev[0]), width * 4);
+
+        std::vector<bool> dirty;
+        Expected(prev, next, stride, width, height, dirty);
+
+        size_t changed(damage.Compare(reinterpret_cast<uint8_t *>(&prev[0]), width * 4, reinterpret_cast<uint8_t *>(&next[0]), stride * 4));
+        size_t count(0);
+        for (size_t tile(0); tile != dirty.size(); ++tile) {
+            VNCExpect(VNCDamage::Dirty(damage.bitmap_, tile) == dirty[tile]);
+            count += dirty[tile];
+        }
+        VNCExpect(changed == count);
+        Covers(damage);
+    }
+}
+
+int main() {
+    Fixed();
+    Random();
+    return 0;
+}
@@ -0,0 +1,93 @@
+/* Veency - VNC Remote Access Server for iPhoneOS
+ * Copyright (C) 2008-2014  Jay Freeman (saurik)
+*/
+
+/* GNU Affero General Public License, Version 3 {{{ */
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+/* }}} */
+
+
+#include <string.h>
+
+#include <vector>
+
+#include "Damage.hpp"
+#include "Test.hpp"
+
+// what one Compare() costs on a full retina iPad frame: when nothing
+// changed (every byte of both frames is read), when only a clock digit
+// in the status bar did, and when everything did (each tile stops early)
+
+static const size_t Width = 2048;
+static const size_t Height = 1536;
+static const unsigned Frames = 50;
+
+// both frames, all of which a compare reads when nothing changed, on one core
+static const double Bytes = 2.0 * Width * Height * 4;
+
+static void VNCBench(const char *name, const std::vector<uint32_t> &prev, const std::vector<uint32_t> &next) {
+    VNCDamage damage;
+    damage.Resize(Width, Height);
+    const uint8_t *lhs(reinterpret_cast<const uint8_t *>(&prev[0]));
+    const uint8_t *rhs(reinterpret_cast<const uint8_t *>(&next[0]));
+    damage.Compare(lhs, Width * 4, lhs, Width * 4);
+
+    size_t changed(0);
+    uint64_t start(VNCMicroseconds());
+    for (unsigned frame(0); frame != Frames; ++frame)
+        changed = damage.Compare(lhs, Width * 4, rhs, Width * 4);
+    double elapsed((VNCMicroseconds() - start) / 1e6 / Frames);
+
+    printf("%s: %zu tiles in %zu rects, %.2fms per frame", name, changed, damage.count_, elapsed * 1e3);
+    if (changed == 0)
+        printf(" (%.1f GB/s)", Bytes / elapsed / 1e9);
+    printf("\n");
+}
+
+// the same unchanged frame, one memcmp() per row, as a baseline
+static void VNCBaseline(const std::vector<uint32_t> &prev, const std::vector<uint32_t> &next) {
+    unsigned differ(0);
+    uint64_t start(VNCMicroseconds());
+    for (unsigned frame(0); frame != Frames; ++frame)
+        for (size_t y(0); y != Height; ++y)
+            differ += memcmp(&prev[y * Width], &next[y * Width], Width * 4) != 0;
+    double elapsed((VNCMicroseconds() - start) / 1e6 / Frames);
+
+    VNCExpect(differ == 0);
+    printf("unchanged, memcmp() per row: %.2fms per frame (%.1f GB/s)\n", elapsed * 1e3, Bytes / elapsed / 1e9);
+}
+
+int main() {
+    VNCRandom random(1);
+    std::vector<uint32_t> prev(Width * Height);
+    for (size_t i(0); i != prev.size(); ++i)
+        prev[i] = random.Next();
+
+    std::vector<uint32_t> next(prev);
+    VNCBench("unchanged", prev, next);
+    VNCBaseline(prev, next);
+
+    for (size_t y(10); y != 30; ++y)
+        for (size_t x(1000); x != 1012; ++x)
+            next[y * Width + x] ^= 0xffffff;
+    VNCBench("clock digit", prev, next);
+
+    for (size_t i(0); i != next.size(); ++i)
+        next[i] = ~prev[i];
+    VNCBench("everything", prev, next);
+
+    return 0;
+}
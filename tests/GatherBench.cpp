@@ -0,0 +1,179 @@
+/* Veency - VNC Remote Access Server for iPhoneOS
+ * Copyright (C) 2008-2014  Jay Freeman (saurik)
+*/
+
+/* GNU Affero General Public License, Version 3 {{{ */
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+/* }}} */
+
+
+#include <pthread.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#include <vector>
+
+#include "Tight.hpp"
+#include "Test.hpp"
+
+// one viewer at the far end of a socketpair: how many write() and writev()
+// calls an update takes, and a hash of the stream, which must not change
+// with the way it is written; linked with --wrap for write and writev
+
+static const int Width = 640;
+static const int Height = 1136;
+static const unsigned Frames = 20;
+
+static unsigned writes_;
+static unsigned vectors_;
+
+extern "C" ssize_t __real_write(int fd, const void *data, size_t size);
+extern "C" ssize_t __real_writev(int fd, const struct iovec *iov, int count);
+
+extern "C" ssize_t __wrap_write(int fd, const void *data, size_t size) {
+    ++writes_;
+    return __real_write(fd, data, size);
+}
+
+extern "C" ssize_t __wrap_writev(int fd, const struct iovec *iov, int count) {
+    ++vectors_;
+    return __real_writev(fd, iov, count);
+}
+
+// stands in for tight.c, writing a third of a byte per pixel through updateBuf
+static rfbBool VNCSendFallback(rfbClientPtr client, int x, int y, int w, int h) {
+    for (int i(0); i != w * h / 3; ++i) {
+        if (client->ublen == UPDATE_BUF_SIZE && !rfbSendUpdateBuf(client))
+            return FALSE;
+        client->updateBuf[client->ublen++] = char(x + y + i);
+    }
+
+    return TRUE;
+}
+
+struct VNCDrain {
+    int sock_;
+    uint64_t bytes_;
+    uint64_t hash_;
+};
+
+static void *VNCRead(void *arg) {
+    VNCDrain *drain(reinterpret_cast<VNCDrain *>(arg));
+    drain->bytes_ = 0;
+    drain->hash_ = 5381;
+
+    char data[65536];
+    for (;;) {
+        ssize_t size(read(drain->sock_, data, sizeof(data)));
+        if (size <= 0)
+            break;
+        drain->bytes_ += size;
+        for (ssize_t i(0); i != size; ++i)
+            drain->hash_ = drain->hash_ * 33 + uint8_t(data[i]);
+    }
+
+    return NULL;
+}
+
+static uint32_t VNCPhoto(VNCRandom &random, unsigned number, int x, int y) {
+    uint32_t red((x + number * 7) / 3 & 0xff), green((y + x / 2) / 5 & 0xff), blue((x + y + number * 5) / 8 & 0xff);
+    return (red << 16 | green << 8 | blue) ^ (random.Next() & 0x0f0f0f);
+}
+
+// bands of text, of a solid color and of photo, 100 rows each
+static uint32_t VNCMixed(VNCRandom &random, unsigned number, int x, int y) {
+    switch (y / 100 % 3) {
+        case 0: return (x / 7 + y / 5) % 4 != 0 ? 0xffffff : 0x000000;
+        case 1: return 0x336699;
+        default: return VNCPhoto(random, number, x, y);
+    }
+}
+
+static void VNCBench(rfbScreenInfo &screen, std::vector<uint32_t> &frame, VNCPool &pool, const char *name, uint32_t (*pixel)(VNCRandom &, unsigned, int, int)) {
+    int pair[2];
+    VNCExpect(socketpair(AF_UNIX, SOCK_STREAM, 0, pair) == 0);
+
+    VNCDrain drain;
+    drain.sock_ = pair[1];
+    pthread_t thread;
+    pthread_create(&thread, NULL, &VNCRead, &drain);
+
+    rfbClientRec client;
+    memset(&client, 0, sizeof(client));
+    client.screen = &screen;
+    client.scaledScreen = &screen;
+    client.sock = pair[0];
+    client.format = screen.serverFormat;
+    client.enableLastRectEncoding = TRUE;
+    client.tightQualityLevel = 5;
+    pthread_mutex_init(&client.outputMutex, NULL);
+
+    VNCTightHistory history;
+    VNCRandom random(1);
+    writes_ = 0;
+    vectors_ = 0;
+
+    for (unsigned number(0); number != Frames; ++number) {
+        for (int y(0); y != Height; ++y)
+            for (int x(0); x != Width; ++x)
+                frame[y * Width + x] = (*pixel)(random, number, x, y);
+        // as rfbSendFramebufferUpdate() does after the last rect
+        VNCExpect(VNCSendRectTight(pool, NULL, &VNCSendFallback, history, &client, 5, 0, 0, Width, Height));
+        VNCExpect(rfbSendUpdateBuf(&client));
+    }
+
+    unsigned writes(writes_), vectors(vectors_);
+
+    shutdown(pair[0], SHUT_WR);
+    pthread_join(thread, NULL);
+    rfbCloseClient(&client);
+    close(pair[1]);
+    pthread_mutex_destroy(&client.outputMutex);
+
+    printf("%s: %.1f write() and %.1f writev() per update, %llu bytes, hash %016llx\n", name, double(writes) / Frames, double(vectors) / Frames,
+        (unsigned long long) drain.bytes_ / Frames, (unsigned long long) drain.hash_);
+}
+
+int main() {
+    VNCPool pool;
+    pool.Start(4);
+
+    std::vector<uint32_t> frame(Width * Height);
+
+    rfbScreenInfo screen;
+    memset(&screen, 0, sizeof(screen));
+    screen.width = Width;
+    screen.height = Height;
+    screen.paddedWidthInBytes = Width * 4;
+    screen.frameBuffer = reinterpret_cast<char *>(&frame[0]);
+    screen.serverFormat.bitsPerPixel = 32;
+    screen.serverFormat.depth = 24;
+    screen.serverFormat.trueColour = TRUE;
+    screen.serverFormat.redMax = 0xff;
+    screen.serverFormat.greenMax = 0xff;
+    screen.serverFormat.blueMax = 0xff;
+    screen.serverFormat.redShift = 16;
+    screen.serverFormat.greenShift = 8;
+    screen.serverFormat.blueShift = 0;
+
+    VNCBench(screen, frame, pool, "photo", &VNCPhoto);
+    VNCBench(screen, frame, pool, "mixed", &VNCMixed);
+
+    return 0;
+}
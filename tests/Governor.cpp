@@ -0,0 +1,182 @@
+/* Veency - VNC Remote Access Server for iPhoneOS
+ * Copyright (C) 2008-2014  Jay Freeman (saurik)
+*/
+
+/* GNU Affero General Public License, Version 3 {{{ */
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+/* }}} */
+
+
+#include <string>
+#include <vector>
+
+#include "Governor.hpp"
+#include "Test.hpp"
+
+static const uint64_t Frame = 1000000 / 60;
+
+// a run of frames with changed of tiles tiles damaged, each update taking
+// encode microseconds and leaving backlog bytes unsent
+static unsigned Run(VNCGovernor &governor, uint64_t &now, unsigned frames, size_t changed, uint64_t encode, size_t backlog) {
+    unsigned defer(governor.defer_);
+    for (unsigned frame(0); frame != frames; ++frame) {
+        now += Frame;
+        governor.Damage(now, changed, 768);
+        if (encode != 0)
+            governor.Encode(encode);
+        if (backlog != 0)
+            governor.Backlog(backlog);
+        defer = governor.Update(now);
+        VNCExpect(defer >= governor.floor_ && defer <= governor.ceiling_);
+    }
+    return defer;
+}
+
+// the defer times one scene of Governor.trace went through
+struct VNCScene {
+    std::string name_;
+    std::vector<unsigned> defers_;
+    double encode_;
+    size_t backlog_;
+
+    unsigned Last() const {
+        return defers_.back();
+    }
+
+    unsigned Least() const {
+        unsigned least(defers_[0]);
+        for (size_t i(1); i != defers_.size(); ++i)
+            if (least > defers_[i])
+                least = defers_[i];
+        return least;
+    }
+
+    unsigned Most() const {
+        unsigned most(defers_[0]);
+        for (size_t i(1); i != defers_.size(); ++i)
+            if (most < defers_[i])
+                most = defers_[i];
+        return most;
+    }
+};
+
+// plays the recorded calls back into a governor set up as Tweak.mm's is
+static std::vector<VNCScene> Replay(const char *path) {
+    FILE *trace(fopen(path, "r"));
+    VNCExpect(trace != NULL);
+
+    VNCGovernor governor(1000 / 60, 1000 / 10, 1000 / 25);
+    std::vector<VNCScene> scenes;
+
+    char line[256];
+    while (fgets(line, sizeof(line), trace) != NULL) {
+        char name[64];
+        unsigned long long now, value;
+        size_t changed, tiles;
+
+        if (line[0] == '#')
+            continue;
+        else if (sscanf(line, "scene %63s", name) == 1) {
+            scenes.push_back(VNCScene());
+            scenes.back().name_ = name;
+            scenes.back().encode_ = 0;
+            scenes.back().backlog_ = 0;
+        } else if (sscanf(line, "damage %llu %zu %zu", &now, &changed, &tiles) == 3) {
+            // the recording starts at 0, which the governor takes as unset
+            governor.Damage(now + 1, changed, tiles);
+            scenes.back().defers_.push_back(governor.Update(now + 1));
+            if (scenes.back().encode_ < governor.encode_)
+                scenes.back().encode_ = governor.encode_;
+            if (scenes.back().backlog_ < governor.backlog_)
+                scenes.back().backlog_ = governor.backlog_;
+        } else if (sscanf(line, "encode %llu %llu", &now, &value) == 2)
+            governor.Encode(value);
+        else if (sscanf(line, "backlog %llu %llu", &now, &value) == 2)
+            governor.Backlog(value);
+        else
+            VNCExpect(false);
+    }
+
+    fclose(trace);
+    return scenes;
+}
+
+int main() {
+    uint64_t now(1);
+
+    {
+        VNCGovernor governor(16, 100, 40);
+
+        // nothing happens until there is a window's worth of samples
+        governor.Damage(now, 768, 768);
+        VNCExpect(governor.Update(now + 1000) == 40);
+
+        // full-screen motion goes to the floor, and idleness to the ceiling
+        VNCExpect(Run(governor, now, 120, 768, 1000, 0) == 16);
+        VNCExpect(Run(governor, now, 300, 0, 0, 0) == 100);
+
+        // from the ceiling, it comes back down gradually
+        unsigned first(Run(governor, now, 16, 768, 1000, 0));
+        VNCExpect(first > 16 && first < 100);
+        VNCExpect(Run(governor, now, 120, 768, 1000, 0) == 16);
+
+        // a sporadic change (a clock, say) stays batched near the ceiling
+        unsigned clock(0);
+        for (unsigned second(0); second != 10; ++second) {
+            Run(governor, now, 59, 0, 0, 0);
+            clock = Run(governor, now, 1, 1, 1000, 0);
+        }
+        VNCExpect(clock > 80);
+    }
+
+    {
+        // updates that take 40ms to encode hold the defer time above that
+        VNCGovernor governor(16, 100, 40);
+        VNCExpect(Run(governor, now, 120, 768, 40000, 0) > 40);
+    }
+
+    {
+        // and a socket that stays backed up pushes it up to the ceiling
+        VNCGovernor governor(16, 100, 40);
+        VNCExpect(Run(governor, now, 120, 768, 1000, 0) == 16);
+        VNCExpect(Run(governor, now, 240, 768, 1000, 1 << 20) == 100);
+        VNCExpect(governor.backlog_ == 1 << 20);
+    }
+
+    {
+        // a screen recorded with GovernorRecord, over a 1MB/s link
+        std::vector<VNCScene> scenes(Replay("Governor.trace"));
+        VNCExpect(scenes.size() == 4);
+
+        // idle but for the clock, it settles at the ceiling
+        VNCExpect(scenes[0].name_ == "idle" && scenes[0].Last() == 100);
+
+        // scrolling is full-screen motion, which brings it down from there,
+        // but the link cannot keep up: the backlog keeps it off the floor
+        VNCExpect(scenes[1].name_ == "scroll" && scenes[1].backlog_ > 64 * 1024);
+        VNCExpect(scenes[1].Last() < 100 && scenes[1].Least() > 30);
+
+        // the video starts by backing the socket up to the ceiling, and once
+        // that drains, it runs at the floor: its encodes take a few ms
+        VNCExpect(scenes[2].name_ == "video" && scenes[2].Most() == 100);
+        VNCExpect(scenes[2].Last() == 16 && scenes[2].encode_ * 5 / 4 < 100);
+
+        // then, idle again, it climbs back up
+        VNCExpect(scenes[3].name_ == "idle" && scenes[3].Last() > 40);
+    }
+
+    return 0;
+}
@@ -0,0 +1,281 @@
+/* Veency - VNC Remote Access Server for iPhoneOS
+ * Copyright (C) 2008-2014  Jay Freeman (saurik)
+*/
+
+/* GNU Affero General Public License, Version 3 {{{ */
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+/* }}} */
+
+
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include <vector>
+
+#include "Damage.hpp"
+#include "Governor.hpp"
+#include "Output.hpp"
+#include "Test.hpp"
+#include "Tight.hpp"
+
+// records the trace tests/Governor.cpp replays: a 640x1136 screen at 60Hz,
+// idle but for a clock, then scrolling text, then a video, then idle; the
+// damage of each frame, and the time each update really took to encode
+// and write to a viewer reading 1MB/s over TCP loopback, with what it left
+// unsent. Tweak.mm's governor paces the updates as it does on the device;
+// capture and encoding share one thread here, so a slow update delays the
+// next frame. `GovernorRecord Governor.trace` rewrites the trace
+
+static const int Width = 640;
+static const int Height = 1136;
+static const uint64_t Frame = 1000000 / 60;
+static const uint64_t Rate = 1000000;
+
+static FILE *trace_;
+
+struct VNCScene {
+    const char *name_;
+    unsigned seconds_;
+};
+
+static const VNCScene Scenes[] = {
+    {"idle", 3},
+    {"scroll", 2},
+    {"video", 3},
+    {"idle", 2},
+};
+
+static void *VNCRead(void *arg) {
+    int sock(*reinterpret_cast<int *>(arg));
+    uint64_t start(VNCMicroseconds()), total(0);
+
+    char data[4096];
+    for (;;) {
+        ssize_t size(read(sock, data, sizeof(data)));
+        if (size <= 0)
+            break;
+        total += size;
+        uint64_t due(start + total * 1000000 / Rate), now(VNCMicroseconds());
+        if (due > now)
+            usleep(due - now);
+    }
+
+    return NULL;
+}
+
+// tight.c's share of an update, at about what zlib gets out of UI content
+static rfbBool VNCSendFallback(rfbClientPtr client, int x, int y, int w, int h) {
+    for (int i(0); i != w * h / 4; ++i) {
+        if (client->ublen == UPDATE_BUF_SIZE && !rfbSendUpdateBuf(client))
+            return FALSE;
+        client->updateBuf[client->ublen++] = char(x + y + i);
+    }
+
+    return TRUE;
+}
+
+static uint32_t VNCPhoto(VNCRandom &random, unsigned number, int x, int y) {
+    uint32_t red((x + number * 7) / 3 & 0xff), green((y + x / 2) / 5 & 0xff), blue((x + y + number * 5) / 8 & 0xff);
+    return (red << 16 | green << 8 | blue) ^ (random.Next() & 0x0f0f0f);
+}
+
+// lines of "text", scrolled up by offset rows
+static uint32_t VNCText(int x, int y, unsigned offset) {
+    unsigned row(y + offset);
+    return row % 44 < 30 && x > 20 && (x / 9 * 7 + row / 44 * 13) % 5 != 0 && row % 44 > 8 ? 0x202020 : 0xffffff;
+}
+
+static void VNCDraw(std::vector<uint32_t> &frame, VNCRandom &random, const char *scene, unsigned number) {
+    for (int y(0); y != Height; ++y)
+        for (int x(0); x != Width; ++x) {
+            uint32_t &pixel(frame[y * Width + x]);
+            if (y < 40)
+                // the status bar, with a clock that ticks once a second
+                pixel = x >= 300 && x < 340 && y > 10 && y < 30 && (x + y + number / 60) % 3 == 0 ? 0x000000 : 0xf8f8f8;
+            else if (strcmp(scene, "scroll") == 0)
+                pixel = VNCText(x, y, number * 8);
+            else if (strcmp(scene, "video") == 0 && y >= 400 && y < 760)
+                pixel = VNCPhoto(random, number, x, y);
+            else
+                pixel = VNCText(x, y, 0);
+        }
+}
+
+int main(int argc, char *argv[]) {
+    trace_ = argc > 1 ? fopen(argv[1], "w") : NULL;
+
+    int listener(socket(AF_INET, SOCK_STREAM, 0));
+    struct sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    VNCExpect(bind(listener, reinterpret_cast<struct sockaddr *>(&address), sizeof(address)) == 0);
+    socklen_t length(sizeof(address));
+    VNCExpect(getsockname(listener, reinterpret_cast<struct sockaddr *>(&address), &length) == 0);
+    VNCExpect(listen(listener, 1) == 0);
+
+    int viewer(socket(AF_INET, SOCK_STREAM, 0));
+    VNCExpect(connect(viewer, reinterpret_cast<struct sockaddr *>(&address), sizeof(address)) == 0);
+    int sock(accept(listener, NULL, NULL));
+    VNCExpect(sock != -1);
+    close(listener);
+    int send(256 * 1024);
+    setsockopt(sock, SOL_SOCKET, SO_SNDBUF, &send, sizeof(send));
+
+    pthread_t thread;
+    pthread_create(&thread, NULL, &VNCRead, &viewer);
+
+    std::vector<uint32_t> frames[2];
+    frames[0].resize(Width * Height);
+    frames[1].resize(Width * Height);
+
+    rfbScreenInfo screen;
+    memset(&screen, 0, sizeof(screen));
+    screen.width = Width;
+    screen.height = Height;
+    screen.paddedWidthInBytes = Width * 4;
+    screen.serverFormat.bitsPerPixel = 32;
+    screen.serverFormat.depth = 24;
+    screen.serverFormat.trueColour = TRUE;
+    screen.serverFormat.redMax = 0xff;
+    screen.serverFormat.greenMax = 0xff;
+    screen.serverFormat.blueMax = 0xff;
+    screen.serverFormat.redShift = 16;
+    screen.serverFormat.greenShift = 8;
+    screen.serverFormat.blueShift = 0;
+
+    rfbClientRec client;
+    memset(&client, 0, sizeof(client));
+    client.screen = &screen;
+    client.scaledScreen = &screen;
+    client.sock = sock;
+    client.format = screen.serverFormat;
+    client.enableLastRectEncoding = TRUE;
+    client.tightQualityLevel = 5;
+    pthread_mutex_init(&client.outputMutex, NULL);
+
+    VNCPool pool;
+    pool.Start(2);
+    VNCTightHistory history;
+    VNCRandom random(1);
+
+    VNCDamage damage;
+    damage.Resize(Width, Height);
+
+    // what the client has not been sent yet, as damage tiles
+    std::vector<uint32_t> pending(damage.Words(), 0);
+
+    VNCGovernor governor(1000 / 60, 1000 / 10, 1000 / 25);
+
+    uint64_t start(VNCMicroseconds()), sent(start);
+    unsigned number(0), updates(0);
+    size_t parity(0);
+
+    for (size_t scene(0); scene != sizeof(Scenes) / sizeof(Scenes[0]); ++scene) {
+        const char *name(Scenes[scene].name_);
+        if (trace_ != NULL)
+            fprintf(trace_, "scene %s\n", name);
+
+        for (uint64_t end(VNCMicroseconds() + Scenes[scene].seconds_ * 1000000); ; ) {
+            uint64_t now(VNCMicroseconds());
+            if (now >= end)
+                break;
+
+            // the frame due now; any that were missed are skipped
+            number = (now - start) / Frame;
+            std::vector<uint32_t> &prev(frames[parity]), &next(frames[parity ^ 1]);
+            VNCDraw(next, random, name, number);
+            parity ^= 1;
+
+            size_t changed(damage.Compare(reinterpret_cast<uint8_t *>(&prev[0]), Width * 4, reinterpret_cast<uint8_t *>(&next[0]), Width * 4));
+            size_t tiles(damage.columns_ * damage.rows_);
+            for (size_t i(0); i != pending.size(); ++i)
+                pending[i] |= damage.bitmap_[i];
+
+            now = VNCMicroseconds();
+            governor.Damage(now, changed, tiles);
+            unsigned defer(governor.Update(now));
+            if (trace_ != NULL)
+                fprintf(trace_, "damage %llu %zu %zu\n", (unsigned long long) (now - start), changed, tiles);
+
+            bool dirty(false);
+            for (size_t i(0); i != pending.size(); ++i)
+                dirty |= pending[i] != 0;
+
+            // as libvncserver does: once deferUpdateTime has passed, one
+            // update with a rect for each run of pending tiles in a row
+            if (dirty && now - sent >= defer * 1000) {
+                screen.frameBuffer = reinterpret_cast<char *>(&next[0]);
+                uint64_t begin(VNCMicroseconds());
+
+                for (size_t row(0); row != damage.rows_; ++row)
+                    for (size_t column(0); column != damage.columns_; ) {
+                        if (!VNCDamage::Dirty(&pending[0], row * damage.columns_ + column)) {
+                            ++column;
+                            continue;
+                        }
+
+                        size_t left(column);
+                        while (column != damage.columns_ && VNCDamage::Dirty(&pending[0], row * damage.columns_ + column))
+                            ++column;
+
+                        int x(left * TileSize), y(row * TileSize);
+                        int w(column * TileSize > size_t(Width) ? Width - x : (column - left) * TileSize);
+                        int h(y + int(TileSize) > Height ? Height - y : int(TileSize));
+                        VNCExpect(VNCSendRectTight(pool, NULL, &VNCSendFallback, history, &client, 5, x, y, w, h));
+                    }
+                VNCExpect(rfbSendUpdateBuf(&client));
+
+                sent = VNCMicroseconds();
+                governor.Encode(sent - begin);
+                if (trace_ != NULL)
+                    fprintf(trace_, "encode %llu %llu\n", (unsigned long long) (sent - start), (unsigned long long) (sent - begin));
+
+                size_t unsent;
+                if (VNCUnsent(sock, unsent)) {
+                    governor.Backlog(unsent);
+                    if (trace_ != NULL)
+                        fprintf(trace_, "backlog %llu %zu\n", (unsigned long long) (sent - start), unsent);
+                }
+
+                std::fill(pending.begin(), pending.end(), 0);
+                ++updates;
+            }
+
+            uint64_t due(start + (number + 1) * Frame);
+            now = VNCMicroseconds();
+            if (due > now)
+                usleep(due - now);
+        }
+
+        printf("%s: %u updates so far, defer %ums, motion %.3f, encode %.1fms, backlog %zu\n", name, updates, governor.defer_, governor.motion_, governor.encode_, governor.backlog_);
+    }
+
+    shutdown(sock, SHUT_WR);
+    pthread_join(thread, NULL);
+    close(sock);
+    close(viewer);
+
+    if (trace_ != NULL)
+        fclose(trace_);
+    return 0;
+}
@@ -0,0 +1,72 @@
+/* Veency - VNC Remote Access Server for iPhoneOS
+ * Copyright (C) 2008-2014  Jay Freeman (saurik)
+*/
+
+/* GNU Affero General Public License, Version 3 {{{ */
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+/* }}} */
+
+
+#include <pthread.h>
+
+#include "Histogram.hpp"
+#include "Test.hpp"
+
+static VNCHistogram histogram_;
+
+static void *Add(void *) {
+    for (uint64_t value(1); value <= 100000; ++value)
+        histogram_.Add(value);
+    return NULL;
+}
+
+int main() {
+    // buckets are ordered, adjacent, and every value lands in its own
+    for (unsigned index(0); index + 1 != VNCHistogram::Buckets; ++index)
+        VNCExpect(VNCHistogram::Lowest(index) < VNCHistogram::Lowest(index + 1));
+    for (uint64_t value(0); value != 1 << 20; ++value) {
+        unsigned index(VNCHistogram::Index(value));
+        VNCExpect(index < VNCHistogram::Buckets);
+        VNCExpect(VNCHistogram::Lowest(index) <= value && value < VNCHistogram::Lowest(index + 1));
+    }
+    VNCExpect(VNCHistogram::Index(~uint64_t(0)) == VNCHistogram::Buckets - 1);
+
+    // small values are exact
+    for (uint64_t value(0); value != 2 * VNCHistogram::Sub; ++value)
+        VNCExpect(VNCHistogram::Lowest(VNCHistogram::Index(value)) == value);
+
+    VNCExpect(histogram_.Count() == 0 && histogram_.Percentile(0.5) == 0);
+
+    pthread_t threads[4];
+    for (unsigned i(0); i != 4; ++i)
+        pthread_create(&threads[i], NULL, &Add, NULL);
+    for (unsigned i(0); i != 4; ++i)
+        pthread_join(threads[i], NULL);
+
+    VNCExpect(histogram_.Count() == 400000);
+    VNCExpect(histogram_.maximum_ == 100000);
+    VNCExpect(histogram_.Percentile(1) == 100000);
+
+    // within a bucket's width (1/Sub) above the true value
+    double fractions[] = {0.5, 0.9, 0.99};
+    for (unsigned i(0); i != 3; ++i) {
+        uint64_t value(histogram_.Percentile(fractions[i]));
+        double exact(fractions[i] * 100000);
+        VNCExpect(value >= exact && value <= exact * (1 + 1.0 / VNCHistogram::Sub));
+    }
+
+    return 0;
+}
@@ -0,0 +1,72 @@
+/* Veency - VNC Remote Access Server for iPhoneOS
+ * Copyright (C) 2008-2014  Jay Freeman (saurik)
+*/
+
+/* GNU Affero General Public License, Version 3 {{{ */
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+/* }}} */
+
+
+// Jpeg.cpp is written against jpeg-9a's internals; where jpeg-9a is not
+// around, benchmarks that only need Tight.cpp to produce JPEG link this
+// instead, against whatever libjpeg the host has: no SIMD, but the same
+// BGRX input, so that what Tight.cpp hands libjpeg is unchanged
+
+#include <stdint.h>
+#include <stdio.h>
+
+#define JPEG_INTERNALS
+
+extern "C" {
+#include <jpeglib.h>
+}
+
+#include "Jpeg.hpp"
+
+// jccolor.c's arithmetic, without its tables
+static const int ScaleBits = 16;
+static const int32_t OneHalf = 1 << (ScaleBits - 1);
+static const int32_t Offset = CENTERJSAMPLE << ScaleBits;
+
+static void VNCColorConvertBGRX(j_compress_ptr cinfo, JSAMPARRAY input_buf, JSAMPIMAGE output_buf, JDIMENSION output_row, int num_rows) {
+    JDIMENSION width(cinfo->image_width);
+
+    while (--num_rows >= 0) {
+        const JSAMPLE *in(*input_buf++);
+        JSAMPLE *y(output_buf[0][output_row]);
+        JSAMPLE *cb(output_buf[1][output_row]);
+        JSAMPLE *cr(output_buf[2][output_row]);
+        ++output_row;
+
+        for (JDIMENSION col(0); col != width; ++col, in += 4) {
+            int32_t r(in[2]), g(in[1]), b(in[0]);
+            y[col] = (19595 * r + 38470 * g + 7471 * b + OneHalf) >> ScaleBits;
+            cb[col] = (-11058 * r - 21710 * g + 32768 * b + Offset + OneHalf - 1) >> ScaleBits;
+            cr[col] = (32768 * r - 27439 * g - 5329 * b + Offset + OneHalf - 1) >> ScaleBits;
+        }
+    }
+}
+
+void VNCJpegAccelerate(jpeg_compress_struct *) {
+}
+
+bool VNCJpegInputBGRX(jpeg_compress_struct *cinfo) {
+    if (cinfo->in_color_space != JCS_RGB || cinfo->input_components != 3 ||
+        cinfo->jpeg_color_space != JCS_YCbCr || cinfo->num_components != 3)
+        return false;
+    cinfo->cconvert->color_convert = &VNCColorConvertBGRX;
+    return true;
+}
@@ -0,0 +1,83 @@
+/* Veency - VNC Remote Access Server for iPhoneOS
+ * Copyright (C) 2008-2014  Jay Freeman (saurik)
+*/
+
+/* GNU Affero General Public License, Version 3 {{{ */
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+/* }}} */
+
+
+
+#include <vector>
+
+#include "Compress.hpp"
+#include "Test.hpp"
+
+// frames that push the DCT about: smooth gradients (a photo), flat areas
+// with hard edges (UI and text), and noise, which saturates coefficients
+
+static std::vector<uint8_t> Image(size_t width, size_t height, unsigned kind) {
+    VNCRandom random(kind + 1);
+    std::vector<uint8_t> image(width * height * 4);
+
+    for (size_t y(0); y != height; ++y)
+        for (size_t x(0); x != width; ++x) {
+            uint8_t *pixel(&image[(y * width + x) * 4]);
+            for (unsigned channel(0); channel != 4; ++channel)
+                switch (kind) {
+                    case 0:
+                        pixel[channel] = (x * (channel + 1) + y * (3 - channel) + random.Below(9)) & 0xff;
+                    break;
+
+                    case 1:
+                        pixel[channel] = (x / 13 + y / 7) % 3 == 0 ? 0x20 * channel : (x ^ y) % 5 == 0 ? 0xff : 0xf0;
+                    break;
+
+                    default:
+                        pixel[channel] = random.Next();
+                    break;
+                }
+        }
+
+    return image;
+}
+
+int main() {
+    // the Quality[] levels Tight.cpp uses, with and without subsampling,
+    // on sizes that do and do not fill whole MCUs
+    static const int Qualities[] = {15, 41, 62, 79, 92, 100};
+    static const size_t Sizes[][2] = {{256, 128}, {67, 45}, {8, 8}, {1, 1}};
+
+    unsigned compared(0);
+
+    for (unsigned kind(0); kind != 3; ++kind)
+        for (size_t size(0); size != sizeof(Sizes) / sizeof(Sizes[0]); ++size) {
+            size_t width(Sizes[size][0]), height(Sizes[size][1]);
+            std::vector<uint8_t> image(Image(width, height, kind));
+
+            for (size_t quality(0); quality != sizeof(Qualities) / sizeof(Qualities[0]); ++quality)
+                for (unsigned subsample(0); subsample != 2; ++subsample) {
+                    std::vector<uint8_t> stock(VNCCompress(image, width, height, Qualities[quality], subsample != 0, VNCStock));
+                    VNCExpect(stock.size() > 2 && stock[0] == 0xff && stock[1] == 0xd8);
+                    VNCExpect(VNCCompress(image, width, height, Qualities[quality], subsample != 0, VNCAccelerated) == stock);
+                    VNCExpect(VNCCompress(image, width, height, Qualities[quality], subsample != 0, VNCDirect) == stock);
+                    ++compared;
+                }
+        }
+
+    VNCExpect(compared == 3 * 4 * 6 * 2);
+    return 0;
+}
@@ -0,0 +1,61 @@
+/* Veency - VNC Remote Access Server for iPhoneOS
+ * Copyright (C) 2008-2014  Jay Freeman (saurik)
+*/
+
+/* GNU Affero General Public License, Version 3 {{{ */
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+/* }}} */
+
+
+
+#include <vector>
+
+#include "Compress.hpp"
+#include "Test.hpp"
+
+// a full iPhone 5 screen of photo-like content, encoded as one image at
+// the levels a fast and a slow link end up with
+
+static const size_t Width = 640;
+static const size_t Height = 1136;
+static const unsigned Frames = 20;
+
+static double Time(const std::vector<uint8_t> &image, int quality, bool subsample, VNCPath path) {
+    uint64_t start(VNCMicroseconds());
+    for (unsigned frame(0); frame != Frames; ++frame)
+        VNCCompress(image, Width, Height, quality, subsample, path);
+    return (VNCMicroseconds() - start) / 1000.0 / Frames;
+}
+
+int main() {
+    VNCRandom random(1);
+    std::vector<uint8_t> image(Width * Height * 4);
+    for (size_t y(0); y != Height; ++y)
+        for (size_t x(0); x != Width; ++x)
+            for (unsigned channel(0); channel != 4; ++channel)
+                image[(y * Width + x) * 4 + channel] = x / 3 + y * channel / 5 + random.Below(16);
+
+    static const int Qualities[] = {41, 79};
+    static const bool Subsampled[] = {true, false};
+
+    for (unsigned i(0); i != 2; ++i) {
+        double stock(Time(image, Qualities[i], Subsampled[i], VNCStock));
+        double direct(Time(image, Qualities[i], Subsampled[i], VNCDirect));
+        printf("quality %d%s: jpeg-9a %.2fms, accelerated %.2fms (%.2fx)\n", Qualities[i], Subsampled[i] ? " 4:2:0" : "", stock, direct, stock / direct);
+    }
+
+    return 0;
+}
@@ -0,0 +1,160 @@
+/* Veency - VNC Remote Access Server for iPhoneOS
+ * Copyright (C) 2008-2014  Jay Freeman (saurik)
+*/
+
+/* GNU Affero General Public License, Version 3 {{{ */
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+/* }}} */
+
+
+#include <vector>
+
+#include "Kernels.hpp"
+#include "Test.hpp"
+
+// Jpeg.cpp's kernels against jpeg-9a's C, without jpeg-9a: the Jpeg check
+// compares whole JPEG files, but needs the library's source
+
+// rows of RGB or BGRX, with the extremes mixed into noise
+static std::vector<JSAMPLE> VNCPixels(VNCRandom &random, size_t count) {
+    std::vector<JSAMPLE> pixels(count);
+    for (size_t i(0); i != count; ++i)
+        switch (random.Below(4)) {
+            case 0: pixels[i] = 0; break;
+            case 1: pixels[i] = 255; break;
+            default: pixels[i] = random.Next(); break;
+        }
+    return pixels;
+}
+
+static void VNCConvert(VNCRandom &random, JDIMENSION width, int rows) {
+    std::vector<JSAMPLE> bgrx(VNCPixels(random, width * 4 * rows)), rgb(width * 3 * rows);
+    for (size_t i(0); i != size_t(width) * rows; ++i) {
+        rgb[i * 3 + 0] = bgrx[i * 4 + 2];
+        rgb[i * 3 + 1] = bgrx[i * 4 + 1];
+        rgb[i * 3 + 2] = bgrx[i * 4 + 0];
+    }
+
+    std::vector<JSAMPROW> ins(rows), directs(rows);
+    for (int i(0); i != rows; ++i) {
+        ins[i] = &rgb[i * width * 3];
+        directs[i] = &bgrx[i * width * 4];
+    }
+
+    // three compressors' worth of output planes, each rows tall
+    std::vector<JSAMPLE> planes[3][3];
+    std::vector<JSAMPROW> pointers[3][3];
+    JSAMPARRAY arrays[3][3];
+    for (int path(0); path != 3; ++path)
+        for (int plane(0); plane != 3; ++plane) {
+            planes[path][plane].assign(width * rows, 0);
+            pointers[path][plane].resize(rows);
+            for (int i(0); i != rows; ++i)
+                pointers[path][plane][i] = &planes[path][plane][i * width];
+            arrays[path][plane] = &pointers[path][plane][0];
+        }
+
+    VNCStockCompressor stock(width, 75), accelerated(width, 75), direct(width, 75);
+    VNCJpegAccelerate(&accelerated.cinfo_);
+    VNCExpect(accelerated.cconvert_.color_convert != &VNCStockConvert);
+    VNCExpect(VNCJpegInputBGRX(&direct.cinfo_));
+
+    stock.cconvert_.color_convert(&stock.cinfo_, &ins[0], arrays[0], 0, rows);
+    accelerated.cconvert_.color_convert(&accelerated.cinfo_, &ins[0], arrays[1], 0, rows);
+    direct.cconvert_.color_convert(&direct.cinfo_, &directs[0], arrays[2], 0, rows);
+
+    for (int plane(0); plane != 3; ++plane) {
+        VNCExpect(planes[1][plane] == planes[0][plane]);
+        VNCExpect(planes[2][plane] == planes[0][plane]);
+    }
+}
+
+static void VNCTransform(VNCRandom &random, int quality, JDIMENSION blocks) {
+    JDIMENSION width(blocks * DCTSIZE + DCTSIZE);
+    std::vector<JSAMPLE> samples(VNCPixels(random, width * DCTSIZE * 2));
+    std::vector<JSAMPROW> rows(DCTSIZE * 2);
+    for (int i(0); i != DCTSIZE * 2; ++i)
+        rows[i] = &samples[i * width];
+
+    VNCStockCompressor stock(width, quality), accelerated(width, quality);
+    VNCJpegAccelerate(&accelerated.cinfo_);
+
+    // an offset row and column, as jccoefct.c passes for later blocks
+    JDIMENSION row(random.Below(DCTSIZE + 1)), column(random.Below(2) * DCTSIZE);
+
+    for (int ci(0); ci != 3; ++ci) {
+        VNCExpect(accelerated.fdct_.pub.forward_DCT[ci] != &VNCStockDCT);
+
+        std::vector<JBLOCK> expected(blocks), actual(blocks);
+        memset(&expected[0], 0x55, blocks * sizeof(JBLOCK));
+        memset(&actual[0], 0xaa, blocks * sizeof(JBLOCK));
+
+        stock.fdct_.pub.forward_DCT[ci](&stock.cinfo_, &stock.components_[ci], &rows[0], &expected[0], row, column, blocks);
+        accelerated.fdct_.pub.forward_DCT[ci](&accelerated.cinfo_, &accelerated.components_[ci], &rows[0], &actual[0], row, column, blocks);
+        VNCExpect(memcmp(&expected[0], &actual[0], blocks * sizeof(JBLOCK)) == 0);
+    }
+}
+
+// what VNCJpegAccelerate() must leave to jpeg-9a
+static void VNCRefuse() {
+    {
+        VNCStockCompressor compressor(64, 75);
+        compressor.cinfo_.dct_method = JDCT_IFAST;
+        VNCJpegAccelerate(&compressor.cinfo_);
+        VNCExpect(compressor.cconvert_.color_convert != &VNCStockConvert);
+        for (int ci(0); ci != 3; ++ci)
+            VNCExpect(compressor.fdct_.pub.forward_DCT[ci] == &VNCStockDCT);
+    }
+
+    {
+        VNCStockCompressor compressor(64, 75);
+        compressor.components_[1].DCT_h_scaled_size = 4;
+        compressor.components_[2].DCT_v_scaled_size = 16;
+        VNCJpegAccelerate(&compressor.cinfo_);
+        VNCExpect(compressor.fdct_.pub.forward_DCT[0] != &VNCStockDCT);
+        VNCExpect(compressor.fdct_.pub.forward_DCT[1] == &VNCStockDCT);
+        VNCExpect(compressor.fdct_.pub.forward_DCT[2] == &VNCStockDCT);
+    }
+
+    {
+        VNCStockCompressor compressor(64, 75);
+        compressor.fdct_.do_dct[0] = NULL;
+        compressor.cinfo_.color_transform = JCT_SUBTRACT_GREEN;
+        VNCJpegAccelerate(&compressor.cinfo_);
+        VNCExpect(compressor.cconvert_.color_convert == &VNCStockConvert);
+        VNCExpect(compressor.fdct_.pub.forward_DCT[0] == &VNCStockDCT);
+        VNCExpect(!VNCJpegInputBGRX(&compressor.cinfo_));
+    }
+}
+
+int main() {
+    VNCRandom random(1);
+
+    static const JDIMENSION Widths[] = {1, 7, 8, 15, 16, 17, 67, 640};
+    for (size_t i(0); i != sizeof(Widths) / sizeof(Widths[0]); ++i)
+        for (int rows(1); rows <= 3; ++rows)
+            VNCConvert(random, Widths[i], rows);
+
+    // the Quality[] levels Tight.cpp uses
+    static const int Qualities[] = {15, 41, 62, 79, 92, 100};
+    for (size_t i(0); i != sizeof(Qualities) / sizeof(Qualities[0]); ++i)
+        for (JDIMENSION blocks(1); blocks <= 9; blocks += 4)
+            for (unsigned round(0); round != 20; ++round)
+                VNCTransform(random, Qualities[i], blocks);
+
+    VNCRefuse();
+    return 0;
+}
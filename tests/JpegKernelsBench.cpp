@@ -0,0 +1,137 @@
+/* Veency - VNC Remote Access Server for iPhoneOS
+ * Copyright (C) 2008-2014  Jay Freeman (saurik)
+*/
+
+/* GNU Affero General Public License, Version 3 {{{ */
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+/* }}} */
+
+
+#include <vector>
+
+#include "Kernels.hpp"
+#include "Test.hpp"
+
+// Jpeg.cpp's kernels against jpeg-9a's C, built with the same compiler and
+// flags, over a full 640x1136 frame of photo-like content: pixels per
+// second for the color conversion, and MB/s of samples for DCT+quantization;
+// and what reading BGRX directly saves over repacking rows into RGB
+
+static const JDIMENSION Width = 640;
+static const int Height = 1136;
+static const unsigned Frames = 100;
+
+typedef void (*VNCConvertFunction)(j_compress_ptr, JSAMPARRAY, JSAMPIMAGE, JDIMENSION, int);
+typedef void (*VNCTransformFunction)(j_compress_ptr, jpeg_component_info *, JSAMPARRAY, JBLOCKROW, JDIMENSION, JDIMENSION, JDIMENSION);
+
+static double VNCConvert(VNCStockCompressor &compressor, std::vector<JSAMPROW> &rows, JSAMPIMAGE planes) {
+    VNCConvertFunction convert(compressor.cconvert_.color_convert);
+    uint64_t start(VNCMicroseconds());
+    for (unsigned frame(0); frame != Frames; ++frame)
+        for (int y(0); y != Height; y += DCTSIZE)
+            convert(&compressor.cinfo_, &rows[y], planes, 0, DCTSIZE);
+    return double(Width) * Height * Frames / (VNCMicroseconds() - start);
+}
+
+// Tight.cpp before it fed BGRX rows in: each row repacked into a 24-bit
+// RGB scanline, then converted
+static double VNCRepack(VNCStockCompressor &compressor, std::vector<JSAMPROW> &directs, JSAMPIMAGE planes) {
+    std::vector<JSAMPLE> rgb(Width * 3 * DCTSIZE);
+    std::vector<JSAMPROW> rows(DCTSIZE);
+    for (int i(0); i != DCTSIZE; ++i)
+        rows[i] = &rgb[i * Width * 3];
+
+    VNCConvertFunction convert(compressor.cconvert_.color_convert);
+    uint64_t start(VNCMicroseconds());
+    for (unsigned frame(0); frame != Frames; ++frame)
+        for (int y(0); y != Height; y += DCTSIZE) {
+            for (int i(0); i != DCTSIZE; ++i) {
+                const JSAMPLE *in(directs[y + i]);
+                JSAMPLE *out(rows[i]);
+                for (JDIMENSION x(0); x != Width; ++x) {
+                    out[x * 3 + 0] = in[x * 4 + 2];
+                    out[x * 3 + 1] = in[x * 4 + 1];
+                    out[x * 3 + 2] = in[x * 4 + 0];
+                }
+            }
+            convert(&compressor.cinfo_, &rows[0], planes, 0, DCTSIZE);
+        }
+    return double(Width) * Height * Frames / (VNCMicroseconds() - start);
+}
+
+static double VNCTransform(VNCStockCompressor &compressor, std::vector<JSAMPROW> &rows, std::vector<JBLOCK> &blocks) {
+    uint64_t start(VNCMicroseconds());
+    for (unsigned frame(0); frame != Frames; ++frame)
+        for (int ci(0); ci != 3; ++ci) {
+            VNCTransformFunction transform(compressor.fdct_.pub.forward_DCT[ci]);
+            for (int y(0); y != Height; y += DCTSIZE)
+                transform(&compressor.cinfo_, &compressor.components_[ci], &rows[y], &blocks[0], 0, 0, Width / DCTSIZE);
+        }
+    return 3.0 * Width * Height * Frames / (VNCMicroseconds() - start);
+}
+
+int main() {
+    VNCRandom random(1);
+    std::vector<JSAMPLE> bgrx(Width * Height * 4), rgb(Width * Height * 3);
+    for (JDIMENSION y(0); y != JDIMENSION(Height); ++y)
+        for (JDIMENSION x(0); x != Width; ++x)
+            for (unsigned channel(0); channel != 4; ++channel)
+                bgrx[(y * Width + x) * 4 + channel] = x / 3 + y * channel / 5 + random.Below(16);
+    for (size_t i(0); i != size_t(Width) * Height; ++i)
+        for (unsigned channel(0); channel != 3; ++channel)
+            rgb[i * 3 + channel] = bgrx[i * 4 + 2 - channel];
+
+    std::vector<JSAMPROW> ins(Height), directs(Height);
+    for (int y(0); y != Height; ++y) {
+        ins[y] = &rgb[y * Width * 3];
+        directs[y] = &bgrx[y * Width * 4];
+    }
+
+    // one MCU row of planes, as jcprepct.c converts into
+    std::vector<JSAMPLE> planes(3 * DCTSIZE * Width);
+    std::vector<JSAMPROW> pointers(3 * DCTSIZE);
+    for (int i(0); i != 3 * DCTSIZE; ++i)
+        pointers[i] = &planes[i * Width];
+    JSAMPARRAY arrays[3] = {&pointers[0], &pointers[DCTSIZE], &pointers[2 * DCTSIZE]};
+
+    VNCStockCompressor stock(Width, 79), accelerated(Width, 79), direct(Width, 79);
+    VNCJpegAccelerate(&accelerated.cinfo_);
+    VNCExpect(VNCJpegInputBGRX(&direct.cinfo_));
+
+    double from(VNCConvert(stock, ins, arrays));
+    double to(VNCConvert(accelerated, ins, arrays));
+    double bgr(VNCConvert(direct, directs, arrays));
+    printf("color conversion: jpeg-9a %.0f Mpixel/s, accelerated %.0f Mpixel/s (%.2fx), from BGRX %.0f Mpixel/s\n", from, to, to / from, bgr);
+
+    // the repacking wrote, and the converter then read, 3 bytes a pixel
+    double repack(VNCRepack(accelerated, directs, arrays));
+    printf("BGRX in: repacked to RGB %.0f Mpixel/s, read directly %.0f Mpixel/s (%.2fx), %.1fMB less copied per frame\n", repack, bgr, bgr / repack, 2.0 * 3 * Width * Height / 1e6);
+
+    // the Y plane of the frame, transformed as each of three components
+    std::vector<JSAMPLE> samples(Width * Height);
+    std::vector<JSAMPROW> rows(Height);
+    for (int y(0); y != Height; ++y)
+        rows[y] = &samples[y * Width];
+    for (size_t i(0); i != samples.size(); ++i)
+        samples[i] = rgb[i * 3 + 1];
+
+    std::vector<JBLOCK> blocks(Width / DCTSIZE);
+    double islow(VNCTransform(stock, rows, blocks));
+    double fast(VNCTransform(accelerated, rows, blocks));
+    printf("DCT and quantization: jpeg-9a %.0f MB/s, accelerated %.0f MB/s (%.2fx)\n", islow, fast, fast / islow);
+
+    return 0;
+}
@@ -0,0 +1,270 @@
+/* Veency - VNC Remote Access Server for iPhoneOS
+ * Copyright (C) 2008-2014  Jay Freeman (saurik)
+*/
+
+/* GNU Affero General Public License, Version 3 {{{ */
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+/* }}} */
+
+
+#ifndef VEENCY_TESTS_KERNELS_HPP
+#define VEENCY_TESTS_KERNELS_HPP
+
+#include <stdint.h>
+#include <string.h>
+
+#define JPEG_INTERNALS
+
+extern "C" {
+#include <jpeglib.h>
+#include <jdct.h>
+}
+
+#include "Jpeg.hpp"
+
+// jpeg-9a's own C for what Jpeg.cpp replaces, built against the headers in
+// include/jpeg: jccolor.c's table-driven RGB->YCbCr, jfdctint.c's integer
+// DCT and jcdctmgr.c's quantization; with a compressor that has only those
+// modules, Jpeg.cpp's kernels can be checked and timed without jpeg-9a
+
+static const int ScaleBits = 16;
+static const int32_t OneHalf = int32_t(1) << (ScaleBits - 1);
+
+#define FIX(x) (int32_t((x) * (1L << ScaleBits) + 0.5))
+
+// R_Y_OFF and so on: jpeg-9 shares B=>Cb with R=>Cr, as they are equal
+static int32_t table_[8 * 256];
+
+static void VNCStockStart() {
+    for (int32_t i(0); i != 256; ++i) {
+        table_[i + 0 * 256] = FIX(0.299) * i;
+        table_[i + 1 * 256] = FIX(0.587) * i;
+        table_[i + 2 * 256] = FIX(0.114) * i + OneHalf;
+        table_[i + 3 * 256] = -FIX(0.168735892) * i;
+        table_[i + 4 * 256] = -FIX(0.331264108) * i;
+        table_[i + 5 * 256] = FIX(0.5) * i + (CENTERJSAMPLE << ScaleBits) + OneHalf - 1;
+        table_[i + 6 * 256] = -FIX(0.418687589) * i;
+        table_[i + 7 * 256] = -FIX(0.081312411) * i;
+    }
+}
+
+static void VNCStockConvert(j_compress_ptr cinfo, JSAMPARRAY input_buf, JSAMPIMAGE output_buf, JDIMENSION output_row, int num_rows) {
+    while (--num_rows >= 0) {
+        JSAMPROW in(*input_buf++);
+        JSAMPROW y(output_buf[0][output_row]), cb(output_buf[1][output_row]), cr(output_buf[2][output_row]);
+        ++output_row;
+
+        for (JDIMENSION col(0); col != cinfo->image_width; ++col, in += RGB_PIXELSIZE) {
+            int r(in[RGB_RED]), g(in[RGB_GREEN]), b(in[RGB_BLUE]);
+            y[col] = (table_[r] + table_[g + 256] + table_[b + 2 * 256]) >> ScaleBits;
+            cb[col] = (table_[r + 3 * 256] + table_[g + 4 * 256] + table_[b + 5 * 256]) >> ScaleBits;
+            cr[col] = (table_[r + 5 * 256] + table_[g + 6 * 256] + table_[b + 7 * 256]) >> ScaleBits;
+        }
+    }
+}
+
+static const int ConstBits = 13;
+static const int Pass1Bits = 2;
+
+extern "C" void jpeg_fdct_islow(DCTELEM *data, JSAMPARRAY sample_data, JDIMENSION start_col) {
+    DCTELEM *dataptr(data);
+    for (int ctr(0); ctr != DCTSIZE; ++ctr, dataptr += DCTSIZE) {
+        JSAMPROW elemptr(sample_data[ctr] + start_col);
+
+        int32_t tmp0(elemptr[0] + elemptr[7]);
+        int32_t tmp1(elemptr[1] + elemptr[6]);
+        int32_t tmp2(elemptr[2] + elemptr[5]);
+        int32_t tmp3(elemptr[3] + elemptr[4]);
+
+        int32_t tmp10(tmp0 + tmp3);
+        int32_t tmp12(tmp0 - tmp3);
+        int32_t tmp11(tmp1 + tmp2);
+        int32_t tmp13(tmp1 - tmp2);
+
+        tmp0 = elemptr[0] - elemptr[7];
+        tmp1 = elemptr[1] - elemptr[6];
+        tmp2 = elemptr[2] - elemptr[5];
+        tmp3 = elemptr[3] - elemptr[4];
+
+        dataptr[0] = (tmp10 + tmp11 - 8 * CENTERJSAMPLE) << Pass1Bits;
+        dataptr[4] = (tmp10 - tmp11) << Pass1Bits;
+
+        int32_t z1((tmp12 + tmp13) * 4433 + (1 << (ConstBits - Pass1Bits - 1)));
+        dataptr[2] = (z1 + tmp12 * 6270) >> (ConstBits - Pass1Bits);
+        dataptr[6] = (z1 - tmp13 * 15137) >> (ConstBits - Pass1Bits);
+
+        tmp12 = tmp0 + tmp2;
+        tmp13 = tmp1 + tmp3;
+
+        z1 = (tmp12 + tmp13) * 9633 + (1 << (ConstBits - Pass1Bits - 1));
+        tmp12 = tmp12 * -3196 + z1;
+        tmp13 = tmp13 * -16069 + z1;
+
+        z1 = (tmp0 + tmp3) * -7373;
+        tmp0 = tmp0 * 12299 + z1 + tmp12;
+        tmp3 = tmp3 * 2446 + z1 + tmp13;
+
+        z1 = (tmp1 + tmp2) * -20995;
+        tmp1 = tmp1 * 25172 + z1 + tmp13;
+        tmp2 = tmp2 * 16819 + z1 + tmp12;
+
+        dataptr[1] = tmp0 >> (ConstBits - Pass1Bits);
+        dataptr[3] = tmp1 >> (ConstBits - Pass1Bits);
+        dataptr[5] = tmp2 >> (ConstBits - Pass1Bits);
+        dataptr[7] = tmp3 >> (ConstBits - Pass1Bits);
+    }
+
+    dataptr = data;
+    for (int ctr(0); ctr != DCTSIZE; ++ctr, ++dataptr) {
+        int32_t tmp0(dataptr[DCTSIZE * 0] + dataptr[DCTSIZE * 7]);
+        int32_t tmp1(dataptr[DCTSIZE * 1] + dataptr[DCTSIZE * 6]);
+        int32_t tmp2(dataptr[DCTSIZE * 2] + dataptr[DCTSIZE * 5]);
+        int32_t tmp3(dataptr[DCTSIZE * 3] + dataptr[DCTSIZE * 4]);
+
+        int32_t tmp10(tmp0 + tmp3 + (1 << (Pass1Bits - 1)));
+        int32_t tmp12(tmp0 - tmp3);
+        int32_t tmp11(tmp1 + tmp2);
+        int32_t tmp13(tmp1 - tmp2);
+
+        tmp0 = dataptr[DCTSIZE * 0] - dataptr[DCTSIZE * 7];
+        tmp1 = dataptr[DCTSIZE * 1] - dataptr[DCTSIZE * 6];
+        tmp2 = dataptr[DCTSIZE * 2] - dataptr[DCTSIZE * 5];
+        tmp3 = dataptr[DCTSIZE * 3] - dataptr[DCTSIZE * 4];
+
+        dataptr[DCTSIZE * 0] = (tmp10 + tmp11) >> Pass1Bits;
+        dataptr[DCTSIZE * 4] = (tmp10 - tmp11) >> Pass1Bits;
+
+        int32_t z1((tmp12 + tmp13) * 4433 + (1 << (ConstBits + Pass1Bits - 1)));
+        dataptr[DCTSIZE * 2] = (z1 + tmp12 * 6270) >> (ConstBits + Pass1Bits);
+        dataptr[DCTSIZE * 6] = (z1 - tmp13 * 15137) >> (ConstBits + Pass1Bits);
+
+        tmp12 = tmp0 + tmp2;
+        tmp13 = tmp1 + tmp3;
+
+        z1 = (tmp12 + tmp13) * 9633 + (1 << (ConstBits + Pass1Bits - 1));
+        tmp12 = tmp12 * -3196 + z1;
+        tmp13 = tmp13 * -16069 + z1;
+
+        z1 = (tmp0 + tmp3) * -7373;
+        tmp0 = tmp0 * 12299 + z1 + tmp12;
+        tmp3 = tmp3 * 2446 + z1 + tmp13;
+
+        z1 = (tmp1 + tmp2) * -20995;
+        tmp1 = tmp1 * 25172 + z1 + tmp13;
+        tmp2 = tmp2 * 16819 + z1 + tmp12;
+
+        dataptr[DCTSIZE * 1] = tmp0 >> (ConstBits + Pass1Bits);
+        dataptr[DCTSIZE * 3] = tmp1 >> (ConstBits + Pass1Bits);
+        dataptr[DCTSIZE * 5] = tmp2 >> (ConstBits + Pass1Bits);
+        dataptr[DCTSIZE * 7] = tmp3 >> (ConstBits + Pass1Bits);
+    }
+}
+
+// jcdctmgr.c's my_fdct_controller, without the float DCT
+struct VNCStockFdct {
+    struct jpeg_forward_dct pub;
+    forward_DCT_method_ptr do_dct[MAX_COMPONENTS];
+};
+
+static void VNCStockDCT(j_compress_ptr cinfo, jpeg_component_info *compptr, JSAMPARRAY sample_data, JBLOCKROW coef_blocks, JDIMENSION start_row, JDIMENSION start_col, JDIMENSION num_blocks) {
+    forward_DCT_method_ptr do_dct(reinterpret_cast<VNCStockFdct *>(cinfo->fdct)->do_dct[compptr->component_index]);
+    const DCTELEM *divisors(reinterpret_cast<const DCTELEM *>(compptr->dct_table));
+    DCTELEM workspace[DCTSIZE2];
+
+    sample_data += start_row;
+
+    for (JDIMENSION bi(0); bi != num_blocks; ++bi, start_col += compptr->DCT_h_scaled_size) {
+        (*do_dct)(workspace, sample_data, start_col);
+
+        JCOEF *output(coef_blocks[bi]);
+        for (int i(0); i != DCTSIZE2; ++i) {
+            DCTELEM qval(divisors[i]), temp(workspace[i]);
+            if (temp < 0) {
+                temp = -temp + (qval >> 1);
+                temp = temp >= qval ? temp / qval : 0;
+                temp = -temp;
+            } else {
+                temp += qval >> 1;
+                temp = temp >= qval ? temp / qval : 0;
+            }
+            output[i] = temp;
+        }
+    }
+}
+
+// a compressor as jpeg_start_compress() leaves it for 3-component RGB in,
+// YCbCr out, with the integer DCT and quantization tables quality gives
+struct VNCStockCompressor {
+    jpeg_compress_struct cinfo_;
+    jpeg_component_info components_[3];
+    jpeg_color_converter cconvert_;
+    VNCStockFdct fdct_;
+    DCTELEM divisors_[3][DCTSIZE2];
+
+    VNCStockCompressor(JDIMENSION width, int quality) {
+        memset(this, 0, sizeof(*this));
+        VNCStockStart();
+
+        cinfo_.image_width = width;
+        cinfo_.input_components = 3;
+        cinfo_.in_color_space = JCS_RGB;
+        cinfo_.num_components = 3;
+        cinfo_.jpeg_color_space = JCS_YCbCr;
+        cinfo_.comp_info = components_;
+        cinfo_.dct_method = JDCT_ISLOW;
+        cinfo_.color_transform = JCT_NONE;
+
+        cconvert_.color_convert = &VNCStockConvert;
+        cinfo_.cconvert = &cconvert_;
+        cinfo_.fdct = &fdct_.pub;
+
+        // jcparam.c's tables at this quality; jcdctmgr.c scales them by 8
+        static const unsigned Luminance[DCTSIZE2] = {
+            16, 11, 10, 16, 24, 40, 51, 61, 12, 12, 14, 19, 26, 58, 60, 55,
+            14, 13, 16, 24, 40, 57, 69, 56, 14, 17, 22, 29, 51, 87, 80, 62,
+            18, 22, 37, 56, 68, 109, 103, 77, 24, 35, 55, 64, 81, 104, 113, 92,
+            49, 64, 78, 87, 103, 121, 120, 101, 72, 92, 95, 98, 112, 100, 103, 99,
+        };
+        static const unsigned Chrominance[DCTSIZE2] = {
+            17, 18, 24, 47, 99, 99, 99, 99, 18, 21, 26, 66, 99, 99, 99, 99,
+            24, 26, 56, 99, 99, 99, 99, 99, 47, 66, 99, 99, 99, 99, 99, 99,
+            99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99,
+            99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99,
+        };
+
+        int scale(quality < 50 ? 5000 / quality : 200 - quality * 2);
+
+        // natural order, which is how the DCT leaves its output
+        for (int ci(0); ci != 3; ++ci) {
+            jpeg_component_info &component(components_[ci]);
+            component.component_index = ci;
+            component.DCT_h_scaled_size = DCTSIZE;
+            component.DCT_v_scaled_size = DCTSIZE;
+            component.dct_table = divisors_[ci];
+
+            for (int i(0); i != DCTSIZE2; ++i) {
+                long value(((ci == 0 ? Luminance : Chrominance)[i] * scale + 50) / 100);
+                value = value <= 0 ? 1 : value > 255 ? 255 : value;
+                divisors_[ci][i] = DCTELEM(value) << 3;
+            }
+
+            fdct_.do_dct[ci] = &jpeg_fdct_islow;
+            fdct_.pub.forward_DCT[ci] = &VNCStockDCT;
+        }
+    }
+};
+
+#endif//VEENCY_TESTS_KERNELS_HPP
@@ -0,0 +1,82 @@
+/* Veency - VNC Remote Access Server for iPhoneOS
+ * Copyright (C) 2008-2014  Jay Freeman (saurik)
+*/
+
+/* GNU Affero General Public License, Version 3 {{{ */
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+/* }}} */
+
+
+#include <pthread.h>
+
+#include "Pool.hpp"
+#include "Test.hpp"
+
+struct VNCCount :
+    public VNCTask
+{
+    volatile unsigned runs_;
+
+    VNCCount() :
+        runs_(0)
+    {
+    }
+
+    virtual void Run() {
+        for (volatile unsigned spin(0); spin != 1000; ++spin);
+        __sync_add_and_fetch(&runs_, 1);
+    }
+};
+
+// every task of every batch runs exactly once, and before Run() returns
+static void Batches(VNCPool &pool, unsigned rounds) {
+    for (unsigned round(0); round != rounds; ++round) {
+        size_t count(1 + round % 23);
+        VNCCount counts[23];
+        VNCTask *tasks[23];
+        for (size_t i(0); i != count; ++i)
+            tasks[i] = &counts[i];
+
+        pool.Run(tasks, count);
+        for (size_t i(0); i != count; ++i)
+            VNCExpect(counts[i].runs_ == 1);
+    }
+}
+
+static VNCPool pool_;
+
+static void *Client(void *) {
+    Batches(pool_, 2000);
+    return NULL;
+}
+
+int main() {
+    // without threads, the caller does all the work itself
+    VNCPool inline_;
+    VNCExpect(inline_.Threads() == 0);
+    Batches(inline_, 100);
+
+    pool_.Start(3);
+    VNCExpect(pool_.Threads() == 3);
+
+    pthread_t clients[4];
+    for (unsigned i(0); i != 4; ++i)
+        pthread_create(&clients[i], NULL, &Client, NULL);
+    for (unsigned i(0); i != 4; ++i)
+        pthread_join(clients[i], NULL);
+
+    return 0;
+}
@@ -0,0 +1,335 @@
+/* Veency - VNC Remote Access Server for iPhoneOS
+ * Copyright (C) 2008-2014  Jay Freeman (saurik)
+*/
+
+/* GNU Affero General Public License, Version 3 {{{ */
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+/* }}} */
+
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+
+#include <string>
+#include <vector>
+
+#include "Output.hpp"
+#include "Reactor.hpp"
+#include "Test.hpp"
+
+// the reactor around a stand-in for libvncserver's event loop, over real
+// loopback sockets: a client sending 'w' gets Blob bytes written to it
+
+static const unsigned Clients = 300;
+static const size_t Blob = 1 << 20;
+
+static rfbScreenInfo screen_;
+static std::vector<char> blob_;
+
+static volatile unsigned updates_;
+static volatile unsigned messages_;
+static volatile unsigned checks_;
+static volatile unsigned reads_;
+static volatile unsigned clients_;
+
+// whether newClientHook leaves clients on hold, and the last one it saw
+static volatile bool park_;
+static rfbClientPtr volatile last_;
+
+static void Gone(rfbClientPtr client) {
+    delete reinterpret_cast<VNCQueue *>(client->clientData);
+    __sync_sub_and_fetch(&clients_, 1);
+}
+
+static rfbNewClientAction Hook(rfbClientPtr client) {
+    client->clientData = new VNCQueue();
+    client->clientGoneHook = &Gone;
+    last_ = client;
+    __sync_add_and_fetch(&clients_, 1);
+    return park_ ? RFB_CLIENT_ON_HOLD : RFB_CLIENT_ACCEPT;
+}
+
+static VNCQueue *Queued(rfbClientPtr client) {
+    return reinterpret_cast<VNCQueue *>(client->clientData);
+}
+
+// one message is one read of whatever the client sent
+void rfbProcessClientMessage(rfbClientPtr client) {
+    __sync_add_and_fetch(&messages_, 1);
+
+    char buffer[64];
+    ssize_t count(read(client->sock, buffer, sizeof(buffer)));
+    if (count <= 0) {
+        rfbCloseClient(client);
+        return;
+    }
+
+    __sync_add_and_fetch(&reads_, count);
+    for (ssize_t i(0); i != count; ++i)
+        if (buffer[i] == 'w') {
+            struct iovec vector = {&blob_[0], Blob};
+            if (VNCWriteVector(client, &vector, 1) <= 0)
+                rfbCloseClient(client);
+        }
+}
+
+// the select() over every socket that the reactor is there to avoid
+int rfbCheckFds(rfbScreenInfoPtr screen, long) {
+    __sync_add_and_fetch(&checks_, 1);
+
+    fd_set fds;
+    FD_ZERO(&fds);
+    FD_SET(screen->listenSock, &fds);
+    int top(screen->listenSock);
+    for (rfbClientPtr client(screen->clientHead); client != NULL; client = client->next)
+        if (client->sock != -1 && !client->onHold) {
+            FD_SET(client->sock, &fds);
+            top = std::max(top, client->sock);
+        }
+
+    struct timeval timeout = {0, 0};
+    int count(select(top + 1, &fds, NULL, NULL, &timeout));
+    if (count <= 0)
+        return count;
+
+    if (FD_ISSET(screen->listenSock, &fds)) {
+        int sock(accept(screen->listenSock, NULL, NULL));
+        if (sock != -1) {
+            // a small buffer, so that Blob has to be queued
+            int size(16384);
+            setsockopt(sock, SOL_SOCKET, SO_SNDBUF, &size, sizeof(size));
+            rfbNewClient(screen, sock);
+        }
+    }
+
+    rfbClientIteratorPtr iterator(rfbGetClientIterator(screen));
+    while (rfbClientPtr client = rfbClientIteratorNext(iterator))
+        if (!client->onHold && FD_ISSET(client->sock, &fds))
+            rfbProcessClientMessage(client);
+    rfbReleaseClientIterator(iterator);
+
+    return count;
+}
+
+void rfbHttpCheckFds(rfbScreenInfoPtr) {
+}
+
+// each pass of the reactor gets here once for every client
+rfbBool rfbUpdateClient(rfbClientPtr client) {
+    if (client->sock != -1)
+        __sync_add_and_fetch(&updates_, 1);
+    return TRUE;
+}
+
+static void Await(volatile unsigned &value, unsigned target) {
+    for (unsigned waited(0); value != target && waited != 5000; ++waited)
+        usleep(1000);
+    VNCExpect(value == target);
+}
+
+static unsigned Passes(unsigned milliseconds) {
+    unsigned updates(updates_);
+    usleep(milliseconds * 1000);
+    return (updates_ - updates) / clients_;
+}
+
+static int Connect(const struct sockaddr_in &address, bool slow) {
+    int sock(socket(AF_INET, SOCK_STREAM, 0));
+    VNCExpect(sock != -1);
+    if (slow) {
+        int size(4096);
+        setsockopt(sock, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+    }
+    VNCExpect(connect(sock, reinterpret_cast<const struct sockaddr *>(&address), sizeof(address)) == 0);
+    return sock;
+}
+
+static void Send(int sock, char byte) {
+    VNCExpect(write(sock, &byte, 1) == 1);
+}
+
+static size_t Queue(rfbClientPtr client) {
+    LOCK(client->outputMutex);
+    size_t size(Queued(client)->Size());
+    UNLOCK(client->outputMutex);
+    return size;
+}
+
+int main() {
+    blob_.resize(Blob);
+    for (size_t i(0); i != Blob; ++i)
+        blob_[i] = i * 7 % 251;
+
+    int listener(socket(AF_INET, SOCK_STREAM, 0));
+    struct sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t length(sizeof(address));
+    VNCExpect(bind(listener, reinterpret_cast<struct sockaddr *>(&address), sizeof(address)) == 0);
+    VNCExpect(listen(listener, 512) == 0);
+    VNCExpect(getsockname(listener, reinterpret_cast<struct sockaddr *>(&address), &length) == 0);
+
+    screen_.width = 64;
+    screen_.height = 64;
+    screen_.socketState = RFB_SOCKET_READY;
+    screen_.listenSock = listener;
+    screen_.listen6Sock = -1;
+    screen_.httpListenSock = -1;
+    screen_.httpListen6Sock = -1;
+    screen_.httpSock = -1;
+    screen_.deferUpdateTime = 5;
+    screen_.newClientHook = &Hook;
+
+    VNCQueueHook = &Queued;
+    rfbMaxClientWait = 1000;
+
+    VNCReactor reactor;
+    VNCExpect(reactor.Start(&screen_));
+
+    // everyone gets in and is read from; with nothing to do, nothing runs
+    int socks[Clients];
+    for (unsigned i(0); i != Clients; ++i)
+        socks[i] = Connect(address, false);
+    Await(clients_, Clients);
+    Passes(50);
+    VNCExpect(Passes(300) == 0);
+
+    // each is read from just the once, and by itself
+    unsigned checks(checks_);
+    unsigned messages(messages_);
+    for (unsigned i(0); i != Clients; ++i)
+        Send(socks[i], 'x');
+    Await(reads_, Clients);
+    VNCExpect(messages_ - messages == Clients);
+    VNCExpect(checks_ == checks);
+
+    Passes(50);
+    unsigned updates(updates_);
+    reactor.Wake();
+    usleep(50000);
+    VNCExpect(updates_ - updates == Clients);
+
+    // descriptors are reused by the next clients
+    for (unsigned i(0); i != Clients / 2; ++i)
+        close(socks[i]);
+    Await(clients_, Clients / 2);
+    for (unsigned i(0); i != Clients / 2; ++i)
+        socks[i] = Connect(address, false);
+    Await(clients_, Clients);
+    for (unsigned i(0); i != Clients; ++i)
+        Send(socks[i], 'y');
+    Await(reads_, Clients * 2);
+
+    // a requested update is looked at once per defer time until it is sent
+    rfbClientPtr client(screen_.clientHead);
+    sraRegionPtr whole(sraRgnCreateRect(0, 0, 64, 64));
+    LOCK(client->updateMutex);
+    sraRgnOr(client->requestedRegion, whole);
+    UNLOCK(client->updateMutex);
+    updates = updates_;
+    reactor.Wake();
+    usleep(100000);
+    unsigned passes((updates_ - updates) / Clients);
+    printf("%u passes in 100ms with an update pending at a 5ms defer time\n", passes);
+    VNCExpect(passes >= 5 && passes <= 40);
+    LOCK(client->updateMutex);
+    sraRgnMakeEmpty(client->requestedRegion);
+    UNLOCK(client->updateMutex);
+    sraRgnDestroy(whole);
+    Passes(50);
+    VNCExpect(Passes(200) == 0);
+
+    // a client on hold is not even listened to until it is answered for
+    park_ = true;
+    int parked(Connect(address, false));
+    Await(clients_, Clients + 1);
+    rfbClientPtr held(last_);
+    Send(parked, 'p');
+    Passes(50);
+    VNCExpect(Passes(200) == 0);
+    VNCExpect(reads_ == Clients * 2);
+    reactor.Answer(held, true);
+    Await(reads_, Clients * 2 + 1);
+
+    int refused(Connect(address, false));
+    Await(clients_, Clients + 2);
+    reactor.Answer(last_, false);
+    Await(clients_, Clients + 1);
+    char byte;
+    VNCExpect(read(refused, &byte, 1) == 0);
+    close(refused);
+    park_ = false;
+
+    // a client that does not read holds up neither the reactor nor anyone
+    // else, and is not polled while its socket stays full
+    int slow(Connect(address, true));
+    Await(clients_, Clients + 2);
+    rfbClientPtr behind(last_);
+    Send(slow, 'w');
+    Await(reads_, Clients * 2 + 2);
+    Passes(50);
+    VNCExpect(Queue(behind) != 0);
+    VNCExpect(Passes(200) == 0);
+    Send(socks[0], 'z');
+    Await(reads_, Clients * 2 + 3);
+
+    std::vector<char> received(Blob);
+    for (size_t offset(0); offset != Blob; ) {
+        ssize_t count(read(slow, &received[offset], Blob - offset));
+        VNCExpect(count > 0);
+        offset += count;
+    }
+    VNCExpect(received == blob_);
+    VNCExpect(Queue(behind) == 0);
+
+    // but one that stops reading altogether is dropped after rfbMaxClientWait
+    uint64_t start(VNCMicroseconds());
+    Send(slow, 'w');
+    Await(clients_, Clients + 1);
+    uint64_t elapsed(VNCMicroseconds() - start);
+    printf("a client that stopped reading was dropped after %.2fs\n", elapsed / 1000000.0);
+    VNCExpect(elapsed >= 900000);
+    close(slow);
+
+    // and one that lets more than a queue may hold pile up goes right away
+    int full(Connect(address, true));
+    Await(clients_, Clients + 2);
+    std::string writes(VNCQueue::Limit / Blob + 1, 'w');
+    start = VNCMicroseconds();
+    VNCExpect(write(full, writes.data(), writes.size()) == ssize_t(writes.size()));
+    Await(clients_, Clients + 1);
+    elapsed = VNCMicroseconds() - start;
+    printf("a client that let %zuMB pile up was dropped after %.2fs\n", writes.size() * Blob >> 20, elapsed / 1000000.0);
+    VNCExpect(elapsed < 500000);
+    close(full);
+
+    reactor.Stop();
+    VNCExpect(!reactor.Running());
+
+    for (unsigned i(0); i != Clients; ++i)
+        close(socks[i]);
+    close(parked);
+    close(listener);
+
+    return 0;
+}
@@ -0,0 +1,108 @@
+/* Veency - VNC Remote Access Server for iPhoneOS
+ * Copyright (C) 2008-2014  Jay Freeman (saurik)
+*/
+
+/* GNU Affero General Public License, Version 3 {{{ */
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+/* }}} */
+
+
+#include <string.h>
+
+#include <vector>
+
+#include "Refine.hpp"
+#include "Test.hpp"
+
+static const size_t Width = 640;
+static const size_t Height = 1136;
+
+int main() {
+    static VNCTightHistory history;
+    memset(&history, 0, sizeof(history));
+
+    VNCQuiet quiet;
+    quiet.Resize(Width, Height);
+    VNCExpect(quiet.columns_ == 10 && quiet.rows_ == 18);
+
+    // two tiles change at 100, and one of them again at 300
+    VNCDamage damage;
+    damage.Resize(Width, Height);
+    std::vector<uint32_t> prev(Width * Height, 0), next(prev);
+    damage.Compare(reinterpret_cast<uint8_t *>(&prev[0]), Width * 4, reinterpret_cast<uint8_t *>(&next[0]), Width * 4);
+    quiet.Update(damage, 50);
+
+    next[10 * Width + 10] = 1;
+    next[200 * Width + 200] = 1;
+    damage.Compare(reinterpret_cast<uint8_t *>(&prev[0]), Width * 4, reinterpret_cast<uint8_t *>(&next[0]), Width * 4);
+    quiet.Update(damage, 100);
+    VNCExpect(quiet.changed_[0] == 100 && quiet.changed_[3 * 10 + 3] == 100 && quiet.changed_[1] == 50);
+
+    prev = next;
+    next[10 * Width + 10] = 2;
+    damage.Compare(reinterpret_cast<uint8_t *>(&prev[0]), Width * 4, reinterpret_cast<uint8_t *>(&next[0]), Width * 4);
+    quiet.Update(damage, 300);
+    VNCExpect(quiet.changed_[0] == 300 && quiet.changed_[3 * 10 + 3] == 100);
+
+    // both went out lossy, but only the one quiet since 200 gets refined
+    history.lossy_[0][0] = true;
+    history.lossy_[3][3] = true;
+
+    // and the other is still to come back for
+    sraRegionPtr region(sraRgnCreate());
+    VNCExpect(VNCRefinable(history, quiet, 200, region));
+    VNCExpect(history.refine_[3][3] && !history.refine_[0][0]);
+    VNCExpect(sraRgnContains(region, 3 * 64, 3 * 64) && sraRgnContains(region, 4 * 64 - 1, 4 * 64 - 1));
+    VNCExpect(!sraRgnContains(region, 10, 10) && !sraRgnContains(region, 4 * 64, 3 * 64));
+    sraRgnDestroy(region);
+
+    // a cell on the bottom row stops at the screen's edge: 1136 is not a
+    // multiple of 64
+    history.lossy_[17][9] = true;
+    region = sraRgnCreate();
+    VNCExpect(VNCRefinable(history, quiet, 200, region));
+    VNCExpect(history.refine_[17][9]);
+    VNCExpect(sraRgnContains(region, 9 * 64, 17 * 64) && sraRgnContains(region, Width - 1, Height - 1));
+    sraRect edge(sraRgnBBox(region));
+    VNCExpect(edge.x2 == int(Width) && edge.y2 == int(Height));
+    sraRgnDestroy(region);
+
+    // once everything lossy has been quiet long enough, nothing is left to
+    // come back for
+    region = sraRgnCreate();
+    VNCExpect(!VNCRefinable(history, quiet, 300, region));
+    VNCExpect(history.refine_[0][0] && sraRgnContains(region, 10, 10));
+    sraRgnDestroy(region);
+    history.refine_[0][0] = false;
+
+    // a rect is refining only if every cell under it is
+    VNCExpect(VNCRefining(history, 3 * 64, 3 * 64, 64, 64));
+    VNCExpect(VNCRefining(history, 3 * 64 + 8, 3 * 64 + 8, 16, 16));
+    VNCExpect(!VNCRefining(history, 3 * 64, 3 * 64, 65, 64));
+    VNCExpect(!VNCRefining(history, 0, 0, 64, 64));
+
+    // when the throttle lets quality back up, only the lossy cells go again,
+    // and those along the edges no further than the screen
+    region = sraRgnCreate();
+    VNCLossy(history, Width, Height, region);
+    VNCExpect(sraRgnContains(region, 0, 0) && sraRgnContains(region, 3 * 64, 3 * 64) && sraRgnContains(region, Width - 1, Height - 1));
+    VNCExpect(!sraRgnContains(region, 64, 0) && !sraRgnContains(region, 2 * 64, 3 * 64));
+    sraRect box(sraRgnBBox(region));
+    VNCExpect(box.x1 == 0 && box.y1 == 0 && box.x2 == int(Width) && box.y2 == int(Height));
+    sraRgnDestroy(region);
+
+    return 0;
+}
@@ -0,0 +1,78 @@
+/* Veency - VNC Remote Access Server for iPhoneOS
+ * Copyright (C) 2008-2014  Jay Freeman (saurik)
+*/
+
+/* GNU Affero General Public License, Version 3 {{{ */
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+/* }}} */
+
+
+#include <string.h>
+
+#include <vector>
+
+#include "Scale.hpp"
+#include "Test.hpp"
+
+// each output channel is the rounded mean of its factor x factor box
+static void Expected(const uint8_t *in, size_t stride, uint8_t *out, size_t pitch, size_t width, size_t height, unsigned factor) {
+    for (size_t y(0); y != height; ++y)
+        for (size_t x(0); x != width; ++x)
+            for (size_t c(0); c != 4; ++c) {
+                unsigned sum(factor * factor / 2);
+                for (unsigned r(0); r != factor; ++r)
+                    for (unsigned i(0); i != factor; ++i)
+                        sum += in[(y * factor + r) * stride + (x * factor + i) * 4 + c];
+                out[y * pitch + x * 4 + c] = sum / (factor * factor);
+            }
+}
+
+int main() {
+    VNCRandom random(2);
+
+    for (unsigned round(0); round != 500; ++round) {
+        unsigned factors[] = {2, 3, 4};
+        unsigned factor(factors[random.Below(3)]);
+
+        size_t width(1 + random.Below(90)), height(1 + random.Below(20));
+        size_t stride((width * factor + random.Below(5)) * 4);
+
+        std::vector<uint8_t> in(stride * height * factor);
+        for (size_t i(0); i != in.size(); ++i)
+            in[i] = random.Below(4) == 0 ? 255 : random.Next();
+
+        std::vector<uint8_t> actual(width * height * 4), expected(actual.size());
+        VNCDownscale(&in[0], stride, &actual[0], width * 4, width, height, factor);
+        Expected(&in[0], stride, &expected[0], width * 4, width, height, factor);
+        VNCExpect(actual == expected);
+    }
+
+    VNCSoftwareScaler scaler;
+    std::vector<uint8_t> frame(64 * 32 * 4, 7);
+    size_t pitch;
+
+    // at full size, frames pass straight through
+    VNCExpect(scaler.Resize(64, 32, 1));
+    VNCExpect(scaler.Scale(NULL, &frame[0], 64 * 4, pitch) == &frame[0] && pitch == 64 * 4);
+
+    VNCExpect(scaler.Resize(32, 16, 2));
+    const uint8_t *half(scaler.Scale(NULL, &frame[0], 64 * 4, pitch));
+    VNCExpect(half != &frame[0] && pitch == 32 * 4);
+    for (size_t i(0); i != 32 * 16 * 4; ++i)
+        VNCExpect(half[i] == 7);
+
+    return 0;
+}
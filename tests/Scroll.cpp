@@ -0,0 +1,151 @@
+/* Veency - VNC Remote Access Server for iPhoneOS
+ * Copyright (C) 2008-2014  Jay Freeman (saurik)
+*/
+
+/* GNU Affero General Public License, Version 3 {{{ */
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+/* }}} */
+
+
+#include <vector>
+
+#include "Scroll.hpp"
+#include "Test.hpp"
+
+static const size_t Width = 640;
+static const size_t Height = 1136;
+
+// text-like: mostly white, with rules every 40 rows and scattered ink
+static uint32_t Page(size_t x, size_t y) {
+    uint32_t hash(x * 2654435761u ^ y * 40503u);
+    hash ^= hash >> 13;
+    hash *= 0x5bd1e995;
+    hash ^= hash >> 15;
+    if (y % 40 < 2)
+        return 0xcccccc;
+    if (hash % 7 == 0 && x > 20 && x < 500)
+        return hash & 0xffffff;
+    return 0xffffff;
+}
+
+// a fixed header, a page scrolled by (left, top), and a scrollbar
+static void Render(std::vector<uint32_t> &frame, size_t left, size_t top, size_t bar) {
+    for (size_t y(0); y != Height; ++y)
+        for (size_t x(0); x != Width; ++x) {
+            uint32_t pixel(y < 128 ? 0x2040ff : Page(x + left, y + top));
+            if (x >= 630 && y >= bar && y < bar + 200)
+                pixel = 0x555555;
+            frame[y * Width + x] = pixel;
+        }
+}
+
+// every copy must reproduce the new frame from the old one, exactly
+static size_t Copied(const VNCScroll &scroll, const std::vector<uint32_t> &prev, const std::vector<uint32_t> &next) {
+    size_t area(0);
+    for (size_t i(0); i != scroll.count_; ++i) {
+        const VNCRect &rect(scroll.rects_[i]);
+        VNCExpect(rect.x + rect.w <= Width && rect.y + rect.h <= Height);
+        for (size_t y(rect.y); y != rect.y + rect.h; ++y)
+            for (size_t x(rect.x); x != rect.x + rect.w; ++x)
+                VNCExpect(next[y * Width + x] == prev[(y - scroll.dy_) * Width + (x - scroll.dx_)]);
+        area += rect.w * rect.h;
+    }
+    return area;
+}
+
+static void Motion(int dx, int dy) {
+    VNCDamage damage;
+    VNCScroll scroll;
+    damage.Resize(Width, Height);
+    scroll.Resize(Width, Height);
+
+    std::vector<uint32_t> prev(Width * Height), next(Width * Height);
+    size_t left(100), top(100);
+
+    Render(next, left, top, 300);
+    damage.Compare(reinterpret_cast<uint8_t *>(&prev[0]), Width * 4, reinterpret_cast<uint8_t *>(&next[0]), Width * 4);
+    scroll.Detect(reinterpret_cast<uint8_t *>(&prev[0]), reinterpret_cast<uint8_t *>(&next[0]), Width * 4, damage);
+
+    for (unsigned frame(0); frame != 6; ++frame) {
+        prev.swap(next);
+        int sign(frame % 2 == 0 ? 1 : -1);
+        left += dx * sign;
+        top += dy * sign;
+        Render(next, left, top, 300 + frame * 20);
+
+        damage.Compare(reinterpret_cast<uint8_t *>(&prev[0]), Width * 4, reinterpret_cast<uint8_t *>(&next[0]), Width * 4);
+        scroll.Detect(reinterpret_cast<uint8_t *>(&prev[0]), reinterpret_cast<uint8_t *>(&next[0]), Width * 4, damage);
+
+        // content moving by (dx, dy) is now at (-dx, -dy) from where it was
+        VNCExpect(scroll.count_ != 0);
+        VNCExpect(scroll.dx_ == -dx * sign && scroll.dy_ == -dy * sign);
+        VNCExpect(Copied(scroll, prev, next) > Width * Height / 2);
+    }
+
+    // hashes that match over pixels that do not, as a collision would have
+    // it: one pixel in every 8x16 of the frame before, and no copies
+    prev.swap(next);
+    top += dy;
+    left += dx;
+    Render(next, left, top, 300);
+    damage.Compare(reinterpret_cast<uint8_t *>(&prev[0]), Width * 4, reinterpret_cast<uint8_t *>(&next[0]), Width * 4);
+    std::vector<uint32_t> forged(prev);
+    for (size_t y(0); y < Height; y += 8)
+        for (size_t x(0); x < Width; x += 16)
+            forged[y * Width + x] ^= 0x010101;
+    VNCExpect(scroll.Detect(reinterpret_cast<uint8_t *>(&forged[0]), reinterpret_cast<uint8_t *>(&next[0]), Width * 4, damage) == 0);
+
+    // nor when the frame before is gone
+    prev.swap(next);
+    top -= dy;
+    left -= dx;
+    Render(next, left, top, 300);
+    damage.Compare(reinterpret_cast<uint8_t *>(&prev[0]), Width * 4, reinterpret_cast<uint8_t *>(&next[0]), Width * 4);
+    VNCExpect(scroll.Detect(NULL, reinterpret_cast<uint8_t *>(&next[0]), Width * 4, damage) == 0);
+
+    // nothing moved: nothing is copied
+    prev = next;
+    next[500 * Width + 50] ^= 0xff;
+    damage.Compare(reinterpret_cast<uint8_t *>(&prev[0]), Width * 4, reinterpret_cast<uint8_t *>(&next[0]), Width * 4);
+    VNCExpect(scroll.Detect(reinterpret_cast<uint8_t *>(&prev[0]), reinterpret_cast<uint8_t *>(&next[0]), Width * 4, damage) == 0);
+}
+
+// noise must not be mistaken for motion
+static void Noise() {
+    VNCDamage damage;
+    VNCScroll scroll;
+    damage.Resize(Width, Height);
+    scroll.Resize(Width, Height);
+
+    VNCRandom random(3);
+    std::vector<uint32_t> prev(Width * Height), next(Width * Height);
+    for (unsigned frame(0); frame != 4; ++frame) {
+        prev.swap(next);
+        for (size_t i(0); i != next.size(); ++i)
+            next[i] = random.Below(2) == 0 ? 0 : random.Next();
+        damage.Compare(reinterpret_cast<uint8_t *>(&prev[0]), Width * 4, reinterpret_cast<uint8_t *>(&next[0]), Width * 4);
+        scroll.Detect(reinterpret_cast<uint8_t *>(&prev[0]), reinterpret_cast<uint8_t *>(&next[0]), Width * 4, damage);
+        Copied(scroll, prev, next);
+    }
+}
+
+int main() {
+    Motion(0, 37);
+    Motion(0, 12);
+    Motion(45, 0);
+    Noise();
+    return 0;
+}
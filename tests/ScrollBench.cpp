@@ -0,0 +1,189 @@
+/* Veency - VNC Remote Access Server for iPhoneOS
+ * Copyright (C) 2008-2014  Jay Freeman (saurik)
+*/
+
+/* GNU Affero General Public License, Version 3 {{{ */
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+/* }}} */
+
+
+
+#include <fcntl.h>
+#include <string.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "Corpus.hpp"
+#include "Scroll.hpp"
+
+// a page of text under a fixed toolbar, scrolled by so many rows a frame:
+// what VNCScroll costs, how much of the damage it turns into CopyRect, and
+// the bytes per frame to send the damage through Tight with and without
+// those copies (each copy being a 16-byte rect)
+
+static const int Width = 640;
+static const int Height = 1136;
+static const unsigned Frames = 40;
+
+static const int Toolbar = 128;
+
+static void VNCRender(std::vector<uint32_t> &frame, int top) {
+    static const VNCFont font;
+
+    for (int y(0); y != Height; ++y)
+        for (int x(0); x != Width; ++x) {
+            uint32_t pixel(0xffffff);
+            int page(y - Toolbar + top);
+
+            if (y < Toolbar)
+                pixel = 0xf7f7f7;
+            else if (page % 24 < VNCFont::Height && x >= 16 && x < Width - 16) {
+                // the same line always has the same text
+                unsigned hash((page / 24) * 2654435761u ^ ((x - 16) / VNCFont::Width) * 40503u);
+                hash ^= hash >> 15;
+                hash *= 0x5bd1e995;
+                hash ^= hash >> 13;
+                unsigned glyph(hash % 40);
+                if (glyph < VNCFont::Glyphs)
+                    pixel = font.Pixel(glyph, (x - 16) % VNCFont::Width, page % 24);
+            }
+
+            frame[y * Width + x] = pixel;
+        }
+}
+
+// sends rect, less whatever the copies (each one column of tiles wide)
+// already account for
+static void VNCSendRest(VNCPool &pool, VNCTightHistory &history, rfbClientPtr client, const VNCRect &rect, const VNCScroll *scroll) {
+    const VNCRect *copy(NULL);
+    for (size_t i(0); scroll != NULL && i != scroll->count_; ++i) {
+        const VNCRect &moved(scroll->rects_[i]);
+        if (moved.x >= rect.x && moved.x < rect.x + rect.w && moved.y < rect.y + rect.h && moved.y + moved.h > rect.y)
+            copy = &moved;
+    }
+
+    if (copy == NULL) {
+        VNCExpect(VNCSendRectTight(pool, NULL, &VNCSendZlib, history, client, 5, rect.x, rect.y, rect.w, rect.h));
+        return;
+    }
+
+    // split around the copy's column, and above and below it in its column
+    VNCRect parts[4] = {
+        {rect.x, rect.y, copy->x - rect.x, rect.h},
+        {copy->x + copy->w, rect.y, rect.x + rect.w - copy->x - copy->w, rect.h},
+        {copy->x, rect.y, copy->w, copy->y > rect.y ? copy->y - rect.y : 0},
+        {copy->x, copy->y + copy->h, copy->w, rect.y + rect.h > copy->y + copy->h ? rect.y + rect.h - copy->y - copy->h : 0},
+    };
+
+    for (unsigned i(0); i != 4; ++i)
+        if (parts[i].w != 0 && parts[i].h != 0)
+            VNCSendRest(pool, history, client, parts[i], i < 2 ? scroll : NULL);
+}
+
+static void VNCBench(VNCPool &pool, rfbScreenInfo &screen, std::vector<uint32_t> &prev, std::vector<uint32_t> &next, int step, bool copies) {
+    rfbClientRec client;
+    memset(&client, 0, sizeof(client));
+    client.screen = &screen;
+    client.scaledScreen = &screen;
+    client.sock = open("/dev/null", O_WRONLY);
+    client.format = screen.serverFormat;
+    client.enableLastRectEncoding = TRUE;
+    client.tightQualityLevel = 5;
+    pthread_mutex_init(&client.outputMutex, NULL);
+    VNCZlibStart();
+
+    VNCTightHistory history;
+    memset(&history, 0, sizeof(history));
+
+    VNCDamage damage;
+    VNCScroll scroll;
+    damage.Resize(Width, Height);
+    scroll.Resize(Width, Height);
+
+    VNCRender(next, 0);
+    damage.Compare(reinterpret_cast<uint8_t *>(&prev[0]), Width * 4, reinterpret_cast<uint8_t *>(&next[0]), Width * 4);
+    scroll.Detect(NULL, reinterpret_cast<uint8_t *>(&next[0]), Width * 4, damage);
+
+    uint64_t detect(0), copied(0), rects(0), bytes(0);
+
+    for (unsigned frame(1); frame <= Frames; ++frame) {
+        prev.swap(next);
+        VNCRender(next, frame * step);
+        screen.frameBuffer = reinterpret_cast<char *>(&next[0]);
+
+        damage.Compare(reinterpret_cast<uint8_t *>(&prev[0]), Width * 4, reinterpret_cast<uint8_t *>(&next[0]), Width * 4);
+
+        uint64_t start(VNCMicroseconds());
+        size_t moved(scroll.Detect(reinterpret_cast<uint8_t *>(&prev[0]), reinterpret_cast<uint8_t *>(&next[0]), Width * 4, damage));
+        detect += VNCMicroseconds() - start;
+
+        // only vertical copies are accounted for below, as only they happen
+        VNCExpect(scroll.dx_ == 0);
+        if (!copies)
+            moved = 0;
+
+        for (size_t i(0); i != moved; ++i)
+            copied += scroll.rects_[i].w * scroll.rects_[i].h;
+        rects += moved;
+        bytes += moved * (sz_rfbFramebufferUpdateRectHeader + 4);
+
+        for (size_t i(0); i != damage.count_; ++i)
+            VNCSendRest(pool, history, &client, damage.rects_[i], moved == 0 ? NULL : &scroll);
+    }
+
+    bytes += rfbStatLookupEncoding(&client, rfbEncodingTight)->bytesSent;
+
+    if (copies)
+        printf("%d rows a frame: detect %.2fms, %.1f copies covering %.0f%% of the screen; %.1fKB", step, detect / 1000.0 / Frames,
+            double(rects) / Frames, 100.0 * copied / Frames / (Width * Height), bytes / 1000.0 / Frames);
+    else
+        printf(" per frame, against %.1fKB without copies\n", bytes / 1000.0 / Frames);
+
+    VNCZlibStop();
+    rfbCloseClient(&client);
+    pthread_mutex_destroy(&client.outputMutex);
+}
+
+int main() {
+    VNCPool pool;
+    pool.Start(0);
+
+    std::vector<uint32_t> prev(Width * Height), next(Width * Height);
+
+    rfbScreenInfo screen;
+    memset(&screen, 0, sizeof(screen));
+    screen.width = Width;
+    screen.height = Height;
+    screen.paddedWidthInBytes = Width * 4;
+    screen.serverFormat.bitsPerPixel = 32;
+    screen.serverFormat.depth = 24;
+    screen.serverFormat.trueColour = TRUE;
+    screen.serverFormat.redMax = 0xff;
+    screen.serverFormat.greenMax = 0xff;
+    screen.serverFormat.blueMax = 0xff;
+    screen.serverFormat.redShift = 16;
+    screen.serverFormat.greenShift = 8;
+    screen.serverFormat.blueShift = 0;
+
+    static const int Steps[] = {4, 12, 40, 120};
+    for (unsigned i(0); i != sizeof(Steps) / sizeof(Steps[0]); ++i) {
+        VNCBench(pool, screen, prev, next, Steps[i], true);
+        VNCBench(pool, screen, prev, next, Steps[i], false);
+    }
+
+    return 0;
+}
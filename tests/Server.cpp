@@ -0,0 +1,263 @@
+/* Veency - VNC Remote Access Server for iPhoneOS
+ * Copyright (C) 2008-2014  Jay Freeman (saurik)
+*/
+
+/* GNU Affero General Public License, Version 3 {{{ */
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+/* }}} */
+
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <vector>
+
+#include <rfb/rfb.h>
+
+char rfbEndianTest = 1;
+
+int rfbMaxClientWait = 20000;
+
+int rfbWriteExact(rfbClientPtr cl, const char *buf, int len) {
+    while (len > 0) {
+        ssize_t n(write(cl->sock, buf, len));
+        if (n > 0) {
+            buf += n;
+            len -= n;
+        } else if (n == 0)
+            return 0;
+        else if (errno != EINTR)
+            return -1;
+    }
+    return 1;
+}
+
+rfbBool rfbSendUpdateBuf(rfbClientPtr cl) {
+    if (cl->sock < 0)
+        return FALSE;
+    if (rfbWriteExact(cl, cl->updateBuf, cl->ublen) < 0) {
+        rfbLogPerror("rfbSendUpdateBuf: write");
+        rfbCloseClient(cl);
+        return FALSE;
+    }
+    cl->ublen = 0;
+    return TRUE;
+}
+
+void rfbCloseClient(rfbClientPtr cl) {
+    if (cl->sock >= 0)
+        close(cl->sock);
+    cl->sock = -1;
+}
+
+void rfbLogPerror(const char *str) {
+    perror(str);
+}
+
+struct rfbClientIterator {
+    rfbScreenInfoPtr screen;
+    rfbClientPtr next;
+    bool started;
+    bool closed;
+};
+
+rfbClientIteratorPtr rfbGetClientIterator(rfbScreenInfoPtr rfbScreen) {
+    rfbClientIteratorPtr iterator(new rfbClientIterator());
+    iterator->screen = rfbScreen;
+    iterator->next = NULL;
+    iterator->started = false;
+    iterator->closed = false;
+    return iterator;
+}
+
+rfbClientIteratorPtr rfbGetClientIteratorWithClosed(rfbScreenInfoPtr rfbScreen) {
+    rfbClientIteratorPtr iterator(rfbGetClientIterator(rfbScreen));
+    iterator->closed = true;
+    return iterator;
+}
+
+// closed clients are skipped, as they are by libvncserver's, unless asked for
+rfbClientPtr rfbClientIteratorNext(rfbClientIteratorPtr iterator) {
+    if (!iterator->started) {
+        iterator->next = iterator->screen->clientHead;
+        iterator->started = true;
+    } else if (iterator->next != NULL)
+        iterator->next = iterator->next->next;
+    while (!iterator->closed && iterator->next != NULL && iterator->next->sock == -1)
+        iterator->next = iterator->next->next;
+    return iterator->next;
+}
+
+void rfbReleaseClientIterator(rfbClientIteratorPtr iterator) {
+    delete iterator;
+}
+
+rfbClientPtr rfbNewClient(rfbScreenInfoPtr rfbScreen, int sock) {
+    rfbClientPtr cl(static_cast<rfbClientPtr>(calloc(1, sizeof(rfbClientRec))));
+    cl->screen = rfbScreen;
+    cl->scaledScreen = rfbScreen;
+    cl->sock = sock;
+    cl->lastPtrX = -1;
+    cl->modifiedRegion = sraRgnCreateRect(0, 0, rfbScreen->width, rfbScreen->height);
+    cl->requestedRegion = sraRgnCreate();
+    cl->copyRegion = sraRgnCreate();
+    pthread_mutex_init(&cl->outputMutex, NULL);
+    pthread_mutex_init(&cl->updateMutex, NULL);
+
+    cl->next = rfbScreen->clientHead;
+    rfbScreen->clientHead = cl;
+
+    switch (rfbScreen->newClientHook == NULL ? RFB_CLIENT_ACCEPT : (*rfbScreen->newClientHook)(cl)) {
+        case RFB_CLIENT_ON_HOLD:
+            cl->onHold = TRUE;
+        break;
+
+        case RFB_CLIENT_ACCEPT:
+            cl->onHold = FALSE;
+        break;
+
+        case RFB_CLIENT_REFUSE:
+            rfbCloseClient(cl);
+            rfbClientConnectionGone(cl);
+            cl = NULL;
+        break;
+    }
+
+    return cl;
+}
+
+void rfbClientConnectionGone(rfbClientPtr cl) {
+    for (rfbClientPtr *next(&cl->screen->clientHead); *next != NULL; next = &(*next)->next)
+        if (*next == cl) {
+            *next = cl->next;
+            break;
+        }
+
+    if (cl->sock != -1)
+        close(cl->sock);
+    if (cl->clientGoneHook != NULL)
+        (*cl->clientGoneHook)(cl);
+
+    sraRgnDestroy(cl->modifiedRegion);
+    sraRgnDestroy(cl->requestedRegion);
+    sraRgnDestroy(cl->copyRegion);
+    pthread_mutex_destroy(&cl->outputMutex);
+    pthread_mutex_destroy(&cl->updateMutex);
+
+    while (rfbStatList *stats = cl->statEncList) {
+        cl->statEncList = stats->Next;
+        free(stats);
+    }
+
+    free(cl);
+}
+
+void rfbStartOnHoldClient(rfbClientPtr cl) {
+    cl->onHold = FALSE;
+}
+
+void rfbRefuseOnHoldClient(rfbClientPtr cl) {
+    rfbCloseClient(cl);
+    rfbClientConnectionGone(cl);
+}
+
+rfbBool rfbIsActive(rfbScreenInfoPtr screenInfo) {
+    return screenInfo->socketState != RFB_SOCKET_SHUTDOWN || screenInfo->clientHead != NULL;
+}
+
+// like stats.c, a list per client, so that client threads need not lock
+rfbStatList *rfbStatLookupEncoding(rfbClientPtr cl, uint32_t type) {
+    for (rfbStatList *stats(cl->statEncList); stats != NULL; stats = stats->Next)
+        if (stats->type == type)
+            return stats;
+    rfbStatList *stats(static_cast<rfbStatList *>(calloc(1, sizeof(rfbStatList))));
+    stats->type = type;
+    stats->Next = cl->statEncList;
+    cl->statEncList = stats;
+    return stats;
+}
+
+void rfbStatRecordEncodingSent(rfbClientPtr cl, int type, int byteCount, int byteIfRaw) {
+    rfbStatList *stats(rfbStatLookupEncoding(cl, type));
+    ++stats->sentCount;
+    stats->bytesSent += byteCount;
+    stats->bytesSentIfRaw += byteIfRaw;
+}
+
+void rfbStatRecordEncodingSentAdd(rfbClientPtr cl, int type, int byteCount) {
+    rfbStatLookupEncoding(cl, type)->bytesSent += byteCount;
+}
+
+struct sraRegion {
+    std::vector<sraRect> rects_;
+};
+
+sraRegionPtr sraRgnCreate() {
+    return new sraRegion();
+}
+
+sraRegionPtr sraRgnCreateRect(int x1, int y1, int x2, int y2) {
+    sraRegionPtr region(sraRgnCreate());
+    if (x1 < x2 && y1 < y2) {
+        sraRect rect = {x1, y1, x2, y2};
+        region->rects_.push_back(rect);
+    }
+    return region;
+}
+
+void sraRgnDestroy(sraRegionPtr region) {
+    delete region;
+}
+
+void sraRgnMakeEmpty(sraRegionPtr region) {
+    region->rects_.clear();
+}
+
+void sraRgnOr(sraRegionPtr dst, sraRegionPtr src) {
+    dst->rects_.insert(dst->rects_.end(), src->rects_.begin(), src->rects_.end());
+}
+
+rfbBool sraRgnEmpty(sraRegionPtr region) {
+    return region->rects_.empty() ? TRUE : FALSE;
+}
+
+sraRect sraRgnBBox(sraRegionPtr region) {
+    sraRect box = {0, 0, 0, 0};
+    for (size_t i(0); i != region->rects_.size(); ++i) {
+        const sraRect &rect(region->rects_[i]);
+        if (i == 0)
+            box = rect;
+        else {
+            box.x1 = std::min(box.x1, rect.x1);
+            box.y1 = std::min(box.y1, rect.y1);
+            box.x2 = std::max(box.x2, rect.x2);
+            box.y2 = std::max(box.y2, rect.y2);
+        }
+    }
+    return box;
+}
+
+bool sraRgnContains(sraRegionPtr region, int x, int y) {
+    for (size_t i(0); i != region->rects_.size(); ++i) {
+        const sraRect &rect(region->rects_[i]);
+        if (x >= rect.x1 && x < rect.x2 && y >= rect.y1 && y < rect.y2)
+            return true;
+    }
+    return false;
+}
@@ -0,0 +1,93 @@
+/* Veency - VNC Remote Access Server for iPhoneOS
+ * Copyright (C) 2008-2014  Jay Freeman (saurik)
+*/
+
+/* GNU Affero General Public License, Version 3 {{{ */
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+/* }}} */
+
+
+#include <string.h>
+
+#include <zlib.h>
+
+#include "Slab.hpp"
+#include "Test.hpp"
+
+static voidpf VNCAllocate(voidpf opaque, uInt items, uInt size) {
+    return reinterpret_cast<VNCSlabs *>(opaque)->Allocate(size_t(items) * size);
+}
+
+static void VNCFree(voidpf opaque, voidpf address) {
+    reinterpret_cast<VNCSlabs *>(opaque)->Free(address);
+}
+
+int main() {
+    {
+        VNCSlabs slabs;
+
+        // a block comes back to whoever next asks for exactly its size
+        void *block(slabs.Allocate(1000));
+        memset(block, 1, 1000);
+        slabs.Free(block);
+        VNCExpect(slabs.Allocate(999) != block);
+        VNCExpect(slabs.Allocate(1000) == block);
+        VNCExpect(slabs.hits_ == 1 && slabs.misses_ == 2);
+
+        slabs.Free(NULL);
+
+        // and nothing is kept past the limit
+        void *huge(slabs.Allocate(8 << 20));
+        slabs.Free(huge);
+        slabs.Allocate(8 << 20);
+        VNCExpect(slabs.hits_ == 1);
+    }
+
+    // zlib's streams, as the Tight encoder sets them up for each client
+    VNCSlabs slabs;
+    static unsigned char input[100000], output[200000], check[100000];
+    for (size_t i(0); i != sizeof(input); ++i)
+        input[i] = i * 7 % 251;
+
+    for (unsigned session(0); session != 20; ++session) {
+        z_stream streams[4];
+        for (unsigned i(0); i != 4; ++i) {
+            z_stream &stream(streams[i]);
+            memset(&stream, 0, sizeof(stream));
+            stream.zalloc = &VNCAllocate;
+            stream.zfree = &VNCFree;
+            stream.opaque = &slabs;
+            VNCExpect(deflateInit2(&stream, 6, Z_DEFLATED, MAX_WBITS, MAX_MEM_LEVEL, Z_DEFAULT_STRATEGY) == Z_OK);
+
+            stream.next_in = input;
+            stream.avail_in = sizeof(input);
+            stream.next_out = output;
+            stream.avail_out = sizeof(output);
+            VNCExpect(deflate(&stream, Z_FINISH) == Z_STREAM_END);
+
+            uLongf size(sizeof(check));
+            VNCExpect(uncompress(check, &size, output, stream.total_out) == Z_OK);
+            VNCExpect(size == sizeof(input) && memcmp(check, input, size) == 0);
+        }
+
+        for (unsigned i(0); i != 4; ++i)
+            deflateEnd(&streams[i]);
+    }
+
+    // after the first session, every stream is built from recycled blocks
+    VNCExpect(slabs.hits_ != 0 && slabs.misses_ * 10 < slabs.hits_);
+    return 0;
+}
@@ -0,0 +1,90 @@
+/* Veency - VNC Remote Access Server for iPhoneOS
+ * Copyright (C) 2008-2014  Jay Freeman (saurik)
+*/
+
+/* GNU Affero General Public License, Version 3 {{{ */
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+/* }}} */
+
+
+
+#include <string.h>
+
+#include <zlib.h>
+
+#include "Slab.hpp"
+#include "Test.hpp"
+
+// a viewer that keeps reconnecting: each session sets up the four Tight
+// streams plus one each for Zlib and ZRLE, as libvncserver does for a
+// new client, deflates one small update through each and tears them all
+// down again; timed with zlib's own malloc() and with VNCSlabs behind it
+
+static const unsigned Sessions = 2000;
+static const unsigned Streams = 6;
+
+static voidpf VNCAllocate(voidpf opaque, uInt items, uInt size) {
+    return reinterpret_cast<VNCSlabs *>(opaque)->Allocate(size_t(items) * size);
+}
+
+static void VNCFree(voidpf opaque, voidpf address) {
+    reinterpret_cast<VNCSlabs *>(opaque)->Free(address);
+}
+
+static double VNCStorm(VNCSlabs *slabs) {
+    static unsigned char input[4096], output[8192];
+    VNCRandom random(14);
+    for (size_t i(0); i != sizeof(input); ++i)
+        input[i] = random.Below(16);
+
+    uint64_t start(VNCMicroseconds());
+
+    for (unsigned session(0); session != Sessions; ++session) {
+        z_stream streams[Streams];
+        for (unsigned i(0); i != Streams; ++i) {
+            z_stream &stream(streams[i]);
+            memset(&stream, 0, sizeof(stream));
+            if (slabs != NULL) {
+                stream.zalloc = &VNCAllocate;
+                stream.zfree = &VNCFree;
+                stream.opaque = slabs;
+            }
+
+            VNCExpect(deflateInit2(&stream, 6, Z_DEFLATED, MAX_WBITS, MAX_MEM_LEVEL, Z_DEFAULT_STRATEGY) == Z_OK);
+            stream.next_in = input;
+            stream.avail_in = sizeof(input);
+            stream.next_out = output;
+            stream.avail_out = sizeof(output);
+            VNCExpect(deflate(&stream, Z_SYNC_FLUSH) == Z_OK);
+        }
+
+        for (unsigned i(0); i != Streams; ++i)
+            deflateEnd(&streams[i]);
+    }
+
+    return double(VNCMicroseconds() - start) / Sessions;
+}
+
+int main() {
+    double plain(VNCStorm(NULL));
+
+    VNCSlabs slabs;
+    double pooled(VNCStorm(&slabs));
+
+    printf("%u reconnects: malloc %.0fus per session, slabs %.0fus (%.2fx); %llu hits, %llu misses\n", Sessions, plain, pooled, plain / pooled,
+        (unsigned long long) slabs.hits_, (unsigned long long) slabs.misses_);
+    return 0;
+}
@@ -0,0 +1,69 @@
+/* Veency - VNC Remote Access Server for iPhoneOS
+ * Copyright (C) 2008-2014  Jay Freeman (saurik)
+*/
+
+/* GNU Affero General Public License, Version 3 {{{ */
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+/* }}} */
+
+
+#ifndef VEENCY_TEST_HPP
+#define VEENCY_TEST_HPP
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <sys/time.h>
+
+// stops the run at the first expectation that does not hold
+#define VNCExpect(condition) do { \
+    if (!(condition)) { \
+        fprintf(stderr, "%s:%u: failed: %s\n", __FILE__, __LINE__, #condition); \
+        abort(); \
+    } \
+} while (false)
+
+// xorshift, so that every run sees the same "random" frames
+class VNCRandom {
+  private:
+    uint64_t state_;
+
+  public:
+    VNCRandom(uint64_t seed) :
+        state_(seed * 0x9e3779b97f4a7c15ull | 1)
+    {
+    }
+
+    uint32_t Next() {
+        state_ ^= state_ << 13;
+        state_ ^= state_ >> 7;
+        state_ ^= state_ << 17;
+        return state_ >> 32;
+    }
+
+    uint32_t Below(uint32_t limit) {
+        return Next() % limit;
+    }
+};
+
+static inline uint64_t VNCMicroseconds() {
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    return uint64_t(now.tv_sec) * 1000000 + now.tv_usec;
+}
+
+#endif//VEENCY_TEST_HPP
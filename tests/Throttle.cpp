@@ -0,0 +1,71 @@
+/* Veency - VNC Remote Access Server for iPhoneOS
+ * Copyright (C) 2008-2014  Jay Freeman (saurik)
+*/
+
+/* GNU Affero General Public License, Version 3 {{{ */
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+/* }}} */
+
+
+#include "Test.hpp"
+#include "Throttle.hpp"
+
+// a link of so many bytes per second behind a 256KB socket buffer, with
+// updates that grow with the quality level they are allowed
+static void Update(VNCThrottle &throttle, double bandwidth) {
+    static const double Sizes[VNCThrottle::Levels] = {20e3, 30e3, 40e3, 42e3, 60e3, 80e3, 85e3, 100e3, 130e3, 250e3};
+    static const double Buffer = 256e3;
+    static const double Trip = 40000;
+
+    double bytes(Sizes[throttle.limit_]);
+    double blocked(bytes > Buffer ? (bytes - Buffer) / bandwidth * 1e6 : 0);
+    double busy(2000 + blocked);
+    double deliver(Trip + (bytes > Buffer ? Buffer : bytes) / bandwidth * 1e6);
+    throttle.Update(bytes, blocked, busy, deliver);
+}
+
+int main() {
+    VNCThrottle throttle;
+    VNCExpect(throttle.limit_ == VNCThrottle::Levels - 1);
+    VNCExpect(throttle.Budget() == 64 * 1024);
+
+    throttle.Wrote(1000, 10);
+    throttle.Wrote(500, 5);
+    VNCExpect(throttle.Bytes() == 1500 && throttle.Blocked() == 15);
+
+    // a fast link keeps the top level
+    for (unsigned update(0); update != 60; ++update)
+        Update(throttle, 20e6);
+    VNCExpect(throttle.limit_ == VNCThrottle::Levels - 1);
+    VNCExpect(throttle.Budget() > 64 * 1024);
+
+    // a slow one costs levels quickly
+    for (unsigned update(0); update != 20; ++update)
+        Update(throttle, 300e3);
+    VNCExpect(throttle.limit_ < 4);
+    VNCExpect(throttle.Budget() == 64 * 1024);
+
+    // and once it recovers, they come back one at a time
+    int before(throttle.limit_);
+    for (unsigned update(0); update != 8; ++update)
+        Update(throttle, 20e6);
+    VNCExpect(throttle.limit_ <= before + 1);
+    for (unsigned update(0); update != 200; ++update)
+        Update(throttle, 20e6);
+    VNCExpect(throttle.limit_ == VNCThrottle::Levels - 1);
+
+    return 0;
+}
@@ -0,0 +1,159 @@
+/* Veency - VNC Remote Access Server for iPhoneOS
+ * Copyright (C) 2008-2014  Jay Freeman (saurik)
+*/
+
+/* GNU Affero General Public License, Version 3 {{{ */
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+/* }}} */
+
+
+#include <pthread.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include "Output.hpp"
+#include "Test.hpp"
+#include "Throttle.hpp"
+
+// a 40KB update every 16ms over TCP loopback to a viewer that reads only
+// 400KB/s: how long each update waits to be read, with and without
+// holding updates back while the socket has more than the budget unsent
+
+static const size_t Frame = 40000;
+static const uint64_t Interval = 16000;
+static const uint64_t Rate = 400000;
+static const uint64_t Duration = 8000000;
+
+struct VNCViewer {
+    int sock_;
+    uint64_t frames_;
+    uint64_t delay_;
+    uint64_t worst_;
+};
+
+// every update starts with when it was sent
+static void *VNCRead(void *arg) {
+    VNCViewer *viewer(reinterpret_cast<VNCViewer *>(arg));
+    viewer->frames_ = 0;
+    viewer->delay_ = 0;
+    viewer->worst_ = 0;
+
+    static char frame[Frame];
+    size_t offset(0), total(0);
+    uint64_t start(VNCMicroseconds());
+
+    char data[4096];
+    for (;;) {
+        ssize_t size(read(viewer->sock_, data, sizeof(data)));
+        if (size <= 0)
+            break;
+
+        for (ssize_t i(0); i != size; ++i) {
+            frame[offset++] = data[i];
+            if (offset == Frame) {
+                uint64_t sent;
+                memcpy(&sent, frame, sizeof(sent));
+                uint64_t delay(VNCMicroseconds() - sent);
+                viewer->delay_ += delay;
+                if (viewer->worst_ < delay)
+                    viewer->worst_ = delay;
+                ++viewer->frames_;
+                offset = 0;
+            }
+        }
+
+        total += size;
+        uint64_t due(start + total * 1000000 / Rate), now(VNCMicroseconds());
+        if (due > now)
+            usleep(due - now);
+    }
+
+    return NULL;
+}
+
+static void VNCBench(bool hold) {
+    int listener(socket(AF_INET, SOCK_STREAM, 0));
+    struct sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    VNCExpect(bind(listener, reinterpret_cast<struct sockaddr *>(&address), sizeof(address)) == 0);
+    socklen_t length(sizeof(address));
+    VNCExpect(getsockname(listener, reinterpret_cast<struct sockaddr *>(&address), &length) == 0);
+    VNCExpect(listen(listener, 1) == 0);
+
+    VNCViewer viewer;
+    viewer.sock_ = socket(AF_INET, SOCK_STREAM, 0);
+    int receive(64 * 1024);
+    setsockopt(viewer.sock_, SOL_SOCKET, SO_RCVBUF, &receive, sizeof(receive));
+    VNCExpect(connect(viewer.sock_, reinterpret_cast<struct sockaddr *>(&address), sizeof(address)) == 0);
+
+    int sock(accept(listener, NULL, NULL));
+    VNCExpect(sock != -1);
+    close(listener);
+    int send(1024 * 1024);
+    setsockopt(sock, SOL_SOCKET, SO_SNDBUF, &send, sizeof(send));
+
+    pthread_t thread;
+    pthread_create(&thread, NULL, &VNCRead, &viewer);
+
+    // the rate the throttle would have measured for this link
+    VNCThrottle throttle;
+    throttle.rate_ = Rate;
+
+    static char frame[Frame];
+    memset(frame, 1, sizeof(frame));
+
+    unsigned sent(0), held(0);
+    for (uint64_t end(VNCMicroseconds() + Duration); VNCMicroseconds() < end; ) {
+        usleep(Interval);
+
+        size_t unsent;
+        if (hold && VNCUnsent(sock, unsent) && unsent > throttle.Budget()) {
+            ++held;
+            continue;
+        }
+
+        uint64_t now(VNCMicroseconds());
+        memcpy(frame, &now, sizeof(now));
+        for (size_t offset(0); offset != Frame; ) {
+            ssize_t size(write(sock, frame + offset, Frame - offset));
+            VNCExpect(size > 0);
+            offset += size;
+        }
+
+        ++sent;
+    }
+
+    shutdown(sock, SHUT_WR);
+    pthread_join(thread, NULL);
+    close(sock);
+    close(viewer.sock_);
+
+    VNCExpect(viewer.frames_ == sent);
+    printf("%s: %u updates sent, %u held; %llums average delay, %llums worst\n", hold ? "hold" : "no hold", sent, held,
+        (unsigned long long) (viewer.delay_ / viewer.frames_ / 1000), (unsigned long long) (viewer.worst_ / 1000));
+}
+
+int main() {
+    VNCBench(false);
+    VNCBench(true);
+    return 0;
+}
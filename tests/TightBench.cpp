@@ -0,0 +1,249 @@
+/* Veency - VNC Remote Access Server for iPhoneOS
+ * Copyright (C) 2008-2014  Jay Freeman (saurik)
+*/
+
+/* GNU Affero General Public License, Version 3 {{{ */
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+/* }}} */
+
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <vector>
+
+#include "Tight.hpp"
+#include "Test.hpp"
+
+// several viewers, each on its own thread as libvncserver would run them,
+// sending the same full frames of photo-like content through one cache:
+// how many tiles get encoded per frame, and how many are shared; then how
+// many tiles of an iPad-sized screen come back from the cache, as it was
+// and as sized for the screen; then how fast one viewer's frames encode on
+// pools of 1, 2, 4 (or more) threads
+
+static const int Width = 640;
+static const int Height = 1136;
+static const unsigned Frames = 20;
+
+static const int Offset = 100;
+
+// the tiles VNCSendRectTight() leaves to tight.c are not counted here
+static rfbBool VNCSendNothing(rfbClientPtr, int, int, int, int) {
+    return TRUE;
+}
+
+struct VNCViewer {
+    rfbClientRec client_;
+    VNCTightHistory history_;
+    int offset_;
+    pthread_t thread_;
+};
+
+static VNCPool pool_;
+static VNCTileCache cache_;
+
+static void *VNCView(void *arg) {
+    VNCViewer *viewer(reinterpret_cast<VNCViewer *>(arg));
+    int offset(viewer->offset_);
+    VNCExpect(VNCSendRectTight(pool_, &cache_, &VNCSendNothing, viewer->history_, &viewer->client_, 5, 0, offset, Width, Height - offset));
+    return NULL;
+}
+
+// noise is the low bits of each channel, so more of it means more tiles
+// that are worth JPEG
+static void VNCFrame(std::vector<uint32_t> &frame, VNCRandom &random, unsigned number, uint32_t noise = 3) {
+    for (int y(0); y != Height; ++y)
+        for (int x(0); x != Width; ++x) {
+            uint32_t red((x + number * 7) / 3 & 0xff), green((y + x / 2) / 5 & 0xff), blue((x + y + number * 5) / 8 & 0xff);
+            frame[y * Width + x] = (red << 16 | green << 8 | blue) ^ (noise == 3 ? random.Below(4) : random.Next() & noise * 0x010101);
+        }
+}
+
+static void VNCBench(rfbScreenInfo &screen, std::vector<uint32_t> &frame, unsigned viewers, bool offset) {
+    std::vector<VNCViewer> clients(viewers);
+    for (unsigned i(0); i != viewers; ++i) {
+        VNCViewer &viewer(clients[i]);
+        memset(&viewer, 0, sizeof(viewer));
+        rfbClientPtr client(&viewer.client_);
+        client->screen = &screen;
+        client->scaledScreen = &screen;
+        client->sock = open("/dev/null", O_WRONLY);
+        client->format = screen.serverFormat;
+        client->enableLastRectEncoding = TRUE;
+        client->tightQualityLevel = 5;
+        pthread_mutex_init(&client->outputMutex, NULL);
+        viewer.offset_ = offset && i % 2 != 0 ? Offset : 0;
+    }
+
+    VNCRandom random(1);
+    uint64_t misses(cache_.misses_), hits(cache_.hits_), waits(cache_.waits_);
+
+    for (unsigned number(0); number != Frames; ++number) {
+        VNCFrame(frame, random, number);
+        for (unsigned i(0); i != viewers; ++i)
+            pthread_create(&clients[i].thread_, NULL, &VNCView, &clients[i]);
+        for (unsigned i(0); i != viewers; ++i)
+            pthread_join(clients[i].thread_, NULL);
+    }
+
+    printf("%u viewer%s%s: %.1f encodes, %.1f hits (%.1f after waiting) per frame\n", viewers, viewers == 1 ? "" : "s", offset ? ", every other one 100 rows down" : "",
+        double(cache_.misses_ - misses) / Frames, double(cache_.hits_ - hits) / Frames, double(cache_.waits_ - waits) / Frames);
+
+    for (unsigned i(0); i != viewers; ++i) {
+        rfbCloseClient(&clients[i].client_);
+        pthread_mutex_destroy(&clients[i].client_.outputMutex);
+    }
+}
+
+// one viewer and no cache, on a pool of so many threads, counting the
+// caller, which works through each batch alongside them
+static void VNCScale(rfbScreenInfo &screen, std::vector<uint32_t> &frame, unsigned threads) {
+    // pools keep their threads for good, so each size gets its own
+    VNCPool *pool(new VNCPool());
+    pool->Start(threads - 1);
+
+    VNCViewer viewer;
+    memset(&viewer, 0, sizeof(viewer));
+    rfbClientPtr client(&viewer.client_);
+    client->screen = &screen;
+    client->scaledScreen = &screen;
+    client->sock = open("/dev/null", O_WRONLY);
+    client->format = screen.serverFormat;
+    client->enableLastRectEncoding = TRUE;
+    client->tightQualityLevel = 5;
+    pthread_mutex_init(&client->outputMutex, NULL);
+
+    VNCRandom random(1);
+    uint64_t elapsed(0);
+
+    for (unsigned number(0); number != Frames; ++number) {
+        VNCFrame(frame, random, number, 0x0f);
+        uint64_t start(VNCMicroseconds());
+        VNCExpect(VNCSendRectTight(*pool, NULL, &VNCSendNothing, viewer.history_, client, 5, 0, 0, Width, Height));
+        elapsed += VNCMicroseconds() - start;
+    }
+
+    printf("%u thread%s: %.2fms per frame (%.1fKB of JPEG), %.1f MB/s of framebuffer\n", threads, threads == 1 ? "" : "s",
+        elapsed / 1000.0 / Frames, rfbStatLookupEncoding(client, rfbEncodingTight)->bytesSent / 1000.0 / Frames, double(Width) * Height * 4 * Frames / elapsed);
+
+    rfbCloseClient(client);
+    pthread_mutex_destroy(&client->outputMutex);
+}
+
+// two viewers at different quality levels, on a 2048x1536 screen that
+// cycles between three pictures (such as when switching between apps)
+static void VNCReturn(size_t tiles) {
+    static const int Width = 2048;
+    static const int Height = 1536;
+    static const unsigned Pictures = 3;
+
+    VNCTileCache cache;
+    if (tiles != 0)
+        cache.Resize(tiles);
+
+    std::vector<uint32_t> pictures[Pictures];
+    VNCRandom random(17);
+    for (unsigned i(0); i != Pictures; ++i) {
+        pictures[i].resize(Width * Height);
+        for (int y(0); y != Height; ++y)
+            for (int x(0); x != Width; ++x)
+                pictures[i][y * Width + x] = ((x + i * 40) / 9 & 0xff) << 16 | ((y + x) / 11 & 0xff) << 8 | (((y + i * 70) / 7 & 0xff) ^ random.Below(4));
+    }
+
+    rfbScreenInfo screen;
+    memset(&screen, 0, sizeof(screen));
+    screen.width = Width;
+    screen.height = Height;
+    screen.paddedWidthInBytes = Width * 4;
+    screen.serverFormat.bitsPerPixel = 32;
+    screen.serverFormat.depth = 24;
+    screen.serverFormat.trueColour = TRUE;
+    screen.serverFormat.redMax = 0xff;
+    screen.serverFormat.greenMax = 0xff;
+    screen.serverFormat.blueMax = 0xff;
+    screen.serverFormat.redShift = 16;
+    screen.serverFormat.greenShift = 8;
+    screen.serverFormat.blueShift = 0;
+
+    VNCViewer viewers[2];
+    for (unsigned i(0); i != 2; ++i) {
+        memset(&viewers[i], 0, sizeof(viewers[i]));
+        rfbClientPtr client(&viewers[i].client_);
+        client->screen = &screen;
+        client->scaledScreen = &screen;
+        client->sock = open("/dev/null", O_WRONLY);
+        client->format = screen.serverFormat;
+        client->enableLastRectEncoding = TRUE;
+        client->tightQualityLevel = 9;
+        pthread_mutex_init(&client->outputMutex, NULL);
+    }
+
+    uint64_t elapsed(0);
+    for (unsigned frame(0); frame != Frames; ++frame) {
+        screen.frameBuffer = reinterpret_cast<char *>(&pictures[frame % Pictures][0]);
+        uint64_t start(VNCMicroseconds());
+        for (unsigned i(0); i != 2; ++i)
+            VNCExpect(VNCSendRectTight(pool_, &cache, &VNCSendNothing, viewers[i].history_, &viewers[i].client_, i == 0 ? 5 : 8, 0, 0, Width, Height));
+        elapsed += VNCMicroseconds() - start;
+    }
+
+    printf("2048x1536, 3 pictures, 2 quality levels, cache %s: %.1f encodes, %.1f hits, %.1fms per frame, %.1fMB held\n", tiles == 0 ? "as constructed" : "sized for 8 screens",
+        double(cache.misses_) / Frames, double(cache.hits_) / Frames, elapsed / 1000.0 / Frames, cache.bytes_ / 1000000.0);
+
+    for (unsigned i(0); i != 2; ++i) {
+        rfbCloseClient(&viewers[i].client_);
+        pthread_mutex_destroy(&viewers[i].client_.outputMutex);
+    }
+}
+
+int main() {
+    pool_.Start(4);
+
+    std::vector<uint32_t> frame(Width * Height);
+
+    rfbScreenInfo screen;
+    memset(&screen, 0, sizeof(screen));
+    screen.width = Width;
+    screen.height = Height;
+    screen.paddedWidthInBytes = Width * 4;
+    screen.frameBuffer = reinterpret_cast<char *>(&frame[0]);
+    screen.serverFormat.bitsPerPixel = 32;
+    screen.serverFormat.depth = 24;
+    screen.serverFormat.trueColour = TRUE;
+    screen.serverFormat.redMax = 0xff;
+    screen.serverFormat.greenMax = 0xff;
+    screen.serverFormat.blueMax = 0xff;
+    screen.serverFormat.redShift = 16;
+    screen.serverFormat.greenShift = 8;
+    screen.serverFormat.blueShift = 0;
+
+    for (unsigned viewers(1); viewers <= 8; viewers *= 2)
+        VNCBench(screen, frame, viewers, false);
+    VNCBench(screen, frame, 2, true);
+
+    VNCReturn(0);
+    VNCReturn(VNCTightTiles(2048, 1536) * 8);
+
+    unsigned cores(sysconf(_SC_NPROCESSORS_ONLN));
+    printf("%u core%s here\n", cores, cores == 1 ? "" : "s");
+    for (unsigned threads(1); threads <= 4 || threads <= cores; threads *= 2)
+        VNCScale(screen, frame, threads);
+
+    return 0;
+}
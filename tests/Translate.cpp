@@ -0,0 +1,122 @@
+/* Veency - VNC Remote Access Server for iPhoneOS
+ * Copyright (C) 2008-2014  Jay Freeman (saurik)
+*/
+
+/* GNU Affero General Public License, Version 3 {{{ */
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+/* }}} */
+
+
+#include <string.h>
+
+#include <vector>
+
+#include "Test.hpp"
+#include "Translate.hpp"
+
+static rfbPixelFormat Format(uint8_t bits, bool big, uint16_t redMax, uint8_t redShift, uint16_t greenMax, uint8_t greenShift, uint16_t blueMax, uint8_t blueShift) {
+    rfbPixelFormat format;
+    memset(&format, 0, sizeof(format));
+    format.bitsPerPixel = bits;
+    format.depth = bits == 32 ? 24 : bits;
+    format.bigEndian = big;
+    format.trueColour = 1;
+    format.redMax = redMax;
+    format.greenMax = greenMax;
+    format.blueMax = blueMax;
+    format.redShift = redShift;
+    format.greenShift = greenShift;
+    format.blueShift = blueShift;
+    return format;
+}
+
+// what translate.c's tables make of a pixel, in the client's byte order
+static uint32_t Expected(const uint8_t *pixel, const rfbPixelFormat &out) {
+    uint32_t value(
+        (pixel[2] * out.redMax + 127) / 255 << out.redShift |
+        (pixel[1] * out.greenMax + 127) / 255 << out.greenShift |
+        (pixel[0] * out.blueMax + 127) / 255 << out.blueShift
+    );
+
+    if (out.bigEndian && out.bitsPerPixel == 16)
+        value = (value >> 8 | value << 8) & 0xffff;
+    else if (out.bigEndian && out.bitsPerPixel == 32)
+        value = __builtin_bswap32(value);
+    return value;
+}
+
+int main() {
+    rfbPixelFormat in(Format(32, false, 255, 16, 255, 8, 255, 0));
+
+    struct {
+        uint8_t bits;
+        uint16_t redMax;
+        uint8_t redShift;
+        uint16_t greenMax;
+        uint8_t greenShift;
+        uint16_t blueMax;
+        uint8_t blueShift;
+    } formats[] = {
+        {16, 31, 11, 63, 5, 31, 0},
+        {16, 31, 0, 63, 5, 31, 11},
+        {16, 31, 10, 31, 5, 31, 0},
+        {16, 31, 0, 31, 5, 31, 10},
+        {8, 7, 0, 7, 3, 3, 6},
+        {8, 7, 5, 7, 2, 3, 0},
+        {32, 255, 16, 255, 8, 255, 0},
+        {32, 255, 0, 255, 8, 255, 16},
+        {32, 255, 24, 255, 16, 255, 8},
+        {32, 255, 8, 255, 16, 255, 24},
+    };
+
+    VNCRandom random(4);
+    size_t width(643), height(37), stride(700 * 4);
+    std::vector<uint8_t> frame(stride * height);
+    for (size_t i(0); i != frame.size(); ++i)
+        frame[i] = random.Next();
+
+    for (size_t i(0); i != sizeof(formats) / sizeof(formats[0]); ++i)
+        for (unsigned big(0); big != 2; ++big) {
+            rfbPixelFormat out(Format(formats[i].bits, big, formats[i].redMax, formats[i].redShift, formats[i].greenMax, formats[i].greenShift, formats[i].blueMax, formats[i].blueShift));
+            rfbTranslateFnType translate(VNCTranslateFunction(in, out));
+            VNCExpect(translate != NULL);
+
+            size_t bytes(out.bitsPerPixel / 8);
+            std::vector<uint8_t> output(width * height * bytes + 8, 0xcc);
+            translate(NULL, &in, &out, reinterpret_cast<char *>(&frame[0]), reinterpret_cast<char *>(&output[0]), stride, width, height);
+
+            for (size_t y(0); y != height; ++y)
+                for (size_t x(0); x != width; ++x) {
+                    uint32_t value(0);
+                    memcpy(&value, &output[(y * width + x) * bytes], bytes);
+                    VNCExpect(value == Expected(&frame[y * stride + x * 4], out));
+                }
+
+            // nothing is written past the end
+            for (size_t j(width * height * bytes); j != output.size(); ++j)
+                VNCExpect(output[j] == 0xcc);
+        }
+
+    // formats we have nothing for are left to libvncserver
+    VNCExpect(VNCTranslateFunction(in, Format(16, false, 15, 8, 15, 4, 15, 0)) == NULL);
+    rfbPixelFormat mapped(Format(8, false, 7, 0, 7, 3, 3, 6));
+    mapped.trueColour = 0;
+    VNCExpect(VNCTranslateFunction(in, mapped) == NULL);
+    rfbPixelFormat other(Format(32, false, 255, 0, 255, 8, 255, 16));
+    VNCExpect(VNCTranslateFunction(other, Format(16, false, 31, 11, 63, 5, 31, 0)) == NULL);
+
+    return 0;
+}
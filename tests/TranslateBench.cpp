@@ -0,0 +1,163 @@
+/* Veency - VNC Remote Access Server for iPhoneOS
+ * Copyright (C) 2008-2014  Jay Freeman (saurik)
+*/
+
+/* GNU Affero General Public License, Version 3 {{{ */
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+/* }}} */
+
+
+
+#include <string.h>
+
+#include <vector>
+
+#include "Test.hpp"
+#include "Translate.hpp"
+
+// a 640x1136 frame translated into each client format Translate.cpp knows,
+// in either byte order, by VNCTranslateFunction() and by the RGB tables
+// translate.c would otherwise use (which the output is also checked against)
+
+static const int Width = 640;
+static const int Height = 1136;
+static const unsigned Frames = 50;
+
+// rfbInitOneRGBTable(): each channel value scaled with rounding, shifted
+// into place, and byte swapped for a client of the other byte order
+template <typename Pixel>
+static void VNCTable(std::vector<Pixel> &table, unsigned max, unsigned shift, bool swap) {
+    table.resize(256);
+    for (unsigned i(0); i != 256; ++i) {
+        uint32_t value((i * max + 127) / 255 << shift);
+        if (swap && sizeof(Pixel) == 2)
+            value = (value >> 8 | value << 8) & 0xffff;
+        else if (swap && sizeof(Pixel) == 4)
+            value = __builtin_bswap32(value);
+        table[i] = value;
+    }
+}
+
+// rfbTranslateWithRGBTables32toN()
+template <typename Pixel>
+static void VNCTables(const rfbPixelFormat &in, const rfbPixelFormat &out, const std::vector<Pixel> *tables, const char *iptr, char *optr, int stride, int width, int height) {
+    const uint32_t *ip(reinterpret_cast<const uint32_t *>(iptr));
+    Pixel *op(reinterpret_cast<Pixel *>(optr));
+    int extra(stride / 4 - width);
+
+    while (height > 0) {
+        Pixel *end(op + width);
+        while (op < end) {
+            *(op++) = tables[0][*ip >> in.redShift & in.redMax] | tables[1][*ip >> in.greenShift & in.greenMax] | tables[2][*ip >> in.blueShift & in.blueMax];
+            ++ip;
+        }
+        ip += extra;
+        --height;
+    }
+
+    (void) out;
+}
+
+static rfbPixelFormat Format(uint8_t bits, bool big, uint16_t redMax, uint8_t redShift, uint16_t greenMax, uint8_t greenShift, uint16_t blueMax, uint8_t blueShift) {
+    rfbPixelFormat format;
+    memset(&format, 0, sizeof(format));
+    format.bitsPerPixel = bits;
+    format.depth = bits == 32 ? 24 : bits;
+    format.bigEndian = big;
+    format.trueColour = 1;
+    format.redMax = redMax;
+    format.greenMax = greenMax;
+    format.blueMax = blueMax;
+    format.redShift = redShift;
+    format.greenShift = greenShift;
+    format.blueShift = blueShift;
+    return format;
+}
+
+template <typename Pixel>
+static void VNCBench(rfbPixelFormat &in, rfbPixelFormat &out, std::vector<uint32_t> &frame) {
+    // translate.c only swaps multi-byte pixels
+    bool swap(out.bigEndian != in.bigEndian && sizeof(Pixel) != 1);
+    std::vector<Pixel> tables[3];
+    VNCTable(tables[0], out.redMax, out.redShift, swap);
+    VNCTable(tables[1], out.greenMax, out.greenShift, swap);
+    VNCTable(tables[2], out.blueMax, out.blueShift, swap);
+
+    rfbTranslateFnType translate(VNCTranslateFunction(in, out));
+    VNCExpect(translate != NULL);
+
+    std::vector<Pixel> expected(Width * Height), actual(Width * Height);
+    char *input(reinterpret_cast<char *>(&frame[0]));
+
+    uint64_t start(VNCMicroseconds());
+    for (unsigned i(0); i != Frames; ++i)
+        VNCTables(in, out, tables, input, reinterpret_cast<char *>(&expected[0]), Width * 4, Width, Height);
+    uint64_t table(VNCMicroseconds() - start);
+
+    start = VNCMicroseconds();
+    for (unsigned i(0); i != Frames; ++i)
+        translate(NULL, &in, &out, input, reinterpret_cast<char *>(&actual[0]), Width * 4, Width, Height);
+    uint64_t direct(VNCMicroseconds() - start);
+
+    VNCExpect(actual == expected);
+
+    printf("%2u bits, %c%u%c%u%c%u at %u/%u/%u, %s endian: tables %4.0f Mpixel/s, direct %4.0f Mpixel/s (%.2fx)\n", out.bitsPerPixel,
+        'r', out.redMax, 'g', out.greenMax, 'b', out.blueMax, out.redShift, out.greenShift, out.blueShift, out.bigEndian ? "big" : "little",
+        double(Width) * Height * Frames / table, double(Width) * Height * Frames / direct, double(table) / direct);
+}
+
+int main() {
+    rfbPixelFormat in(Format(32, false, 255, 16, 255, 8, 255, 0));
+
+    // the formats Translate.cpp has specializations for
+    struct {
+        uint8_t bits;
+        uint16_t redMax;
+        uint8_t redShift;
+        uint16_t greenMax;
+        uint8_t greenShift;
+        uint16_t blueMax;
+        uint8_t blueShift;
+    } formats[] = {
+        {16, 31, 11, 63, 5, 31, 0},
+        {16, 31, 0, 63, 5, 31, 11},
+        {16, 31, 10, 31, 5, 31, 0},
+        {16, 31, 0, 31, 5, 31, 10},
+        {8, 7, 0, 7, 3, 3, 6},
+        {8, 7, 5, 7, 2, 3, 0},
+        {32, 255, 16, 255, 8, 255, 0},
+        {32, 255, 0, 255, 8, 255, 16},
+        {32, 255, 24, 255, 16, 255, 8},
+        {32, 255, 8, 255, 16, 255, 24},
+    };
+
+    VNCRandom random(21);
+    std::vector<uint32_t> frame(Width * Height);
+    for (size_t i(0); i != frame.size(); ++i)
+        frame[i] = random.Next();
+
+    for (size_t i(0); i != sizeof(formats) / sizeof(formats[0]); ++i)
+        for (unsigned big(0); big != (formats[i].bits == 8 ? 1 : 2); ++big) {
+            rfbPixelFormat out(Format(formats[i].bits, big, formats[i].redMax, formats[i].redShift, formats[i].greenMax, formats[i].greenShift, formats[i].blueMax, formats[i].blueShift));
+            switch (out.bitsPerPixel) {
+                case 8: VNCBench<uint8_t>(in, out, frame); break;
+                case 16: VNCBench<uint16_t>(in, out, frame); break;
+                case 32: VNCBench<uint32_t>(in, out, frame); break;
+            }
+        }
+
+    return 0;
+}
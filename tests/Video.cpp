@@ -0,0 +1,114 @@
+/* Veency - VNC Remote Access Server for iPhoneOS
+ * Copyright (C) 2008-2014  Jay Freeman (saurik)
+*/
+
+/* GNU Affero General Public License, Version 3 {{{ */
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+/* }}} */
+
+
+
+#include <vector>
+
+#include "Video.hpp"
+#include "Test.hpp"
+
+// VNCMotionJpeg is not under test, but Video.cpp refers to the encoder
+rfbBool VNCSendRectTight(VNCPool &, VNCTileCache *, VNCSendRect, VNCTightHistory &, rfbClientPtr, int, int, int, int, int) {
+    return FALSE;
+}
+
+static const size_t Width = 640;
+static const size_t Height = 1136;
+
+// a 4x3-tile "video" at (1, 2) that changes every frame, or stands still
+struct Screen {
+    VNCDamage damage_;
+    std::vector<uint32_t> prev_, next_;
+    uint32_t value_;
+
+    Screen() :
+        prev_(Width * Height, 0),
+        next_(prev_),
+        value_(0)
+    {
+        damage_.Resize(Width, Height);
+    }
+
+    const VNCDamage &Frame(bool playing) {
+        prev_ = next_;
+        if (playing) {
+            ++value_;
+            for (size_t row(2); row != 5; ++row)
+                for (size_t column(1); column != 5; ++column)
+                    next_[(row * TileSize + 5) * Width + column * TileSize + 5] = value_;
+        }
+        damage_.Compare(reinterpret_cast<uint8_t *>(&prev_[0]), Width * 4, reinterpret_cast<uint8_t *>(&next_[0]), Width * 4);
+        return damage_;
+    }
+};
+
+static bool Playing(VNCMotion &motion) {
+    VNCRect region;
+    if (!motion.Region(region))
+        return false;
+    VNCExpect(region.x == TileSize && region.y == 2 * TileSize && region.w == 4 * TileSize && region.h == 3 * TileSize);
+    return true;
+}
+
+int main() {
+    VNCMotion motion;
+    motion.Resize(Width, Height);
+    Screen screen;
+
+    // at 60fps, 12 hot frames and then 8 stable ones
+    uint64_t now(1000000);
+    unsigned frames(0);
+    while (!Playing(motion)) {
+        VNCExpect(++frames <= 20);
+        motion.Update(screen.Frame(true), now += 16667);
+    }
+    VNCExpect(frames >= 12 + 8 - 1);
+
+    // ticks that come while frames do have nothing to add
+    motion.Age(now + 1000);
+    VNCExpect(Playing(motion));
+
+    // the screen stops changing and swapping: the clock alone ends it
+    motion.Age(now += 50000);
+    VNCExpect(Playing(motion));
+    motion.Age(now += 500000);
+    VNCExpect(!Playing(motion));
+
+    // frames that keep coming without the region in them end it as well
+    for (unsigned frame(0); frame != 20; ++frame)
+        motion.Update(screen.Frame(true), now += 16667);
+    VNCExpect(Playing(motion));
+    for (frames = 0; Playing(motion); ++frames)
+        motion.Update(screen.Frame(false), now += 16667);
+    VNCExpect(frames <= 5);
+
+    // 10fps is slow, but still video
+    for (unsigned frame(0); frame != 30; ++frame)
+        motion.Update(screen.Frame(true), now += 100000);
+    VNCExpect(Playing(motion));
+
+    // and a pause in the frames counts, even if no tick came meanwhile
+    motion.Update(screen.Frame(true), now += 1000000);
+    VNCExpect(!Playing(motion));
+
+    return 0;
+}
@@ -0,0 +1,255 @@
+/* Veency - VNC Remote Access Server for iPhoneOS
+ * Copyright (C) 2008-2014  Jay Freeman (saurik)
+*/
+
+/* GNU Affero General Public License, Version 3 {{{ */
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+/* }}} */
+
+
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "Test.hpp"
+#include "Throttle.hpp"
+#include "Video.hpp"
+
+// a 640x360 video playing in the middle of a still screen, sent over TCP
+// loopback to a viewer that reads 1MB/s and asks for the next update as
+// soon as it has the last, as VNC viewers do: frames delivered, bytes per
+// frame and how late each frame was read, with the throttle alone picking
+// the quality, and with VNCMotion finding the video and capping it at 3
+
+static const int Width = 640;
+static const int Height = 1136;
+static const int Top = 400;
+static const int Tall = 360;
+
+static const int Requested = 8;
+static const uint64_t Interval = 33333;
+static const uint64_t Rate = 1000000;
+static const uint64_t Duration = 8000000;
+
+static rfbBool VNCSendNothing(rfbClientPtr, int, int, int, int) {
+    return TRUE;
+}
+
+struct VNCViewer {
+    int sock_;
+    pthread_mutex_t mutex_;
+    pthread_cond_t cond_;
+    uint64_t read_;
+};
+
+static void *VNCRead(void *arg) {
+    VNCViewer *viewer(reinterpret_cast<VNCViewer *>(arg));
+    uint64_t start(VNCMicroseconds()), total(0);
+
+    char data[4096];
+    for (;;) {
+        ssize_t size(read(viewer->sock_, data, sizeof(data)));
+        if (size <= 0)
+            break;
+
+        total += size;
+        pthread_mutex_lock(&viewer->mutex_);
+        viewer->read_ = total;
+        pthread_cond_signal(&viewer->cond_);
+        pthread_mutex_unlock(&viewer->mutex_);
+
+        uint64_t due(start + total * 1000000 / Rate), now(VNCMicroseconds());
+        if (due > now)
+            usleep(due - now);
+    }
+
+    return NULL;
+}
+
+// a still backdrop, and the video's picture for frame number
+static void VNCRender(std::vector<uint32_t> &frame, VNCRandom &random, unsigned number) {
+    for (int y(0); y != Height; ++y)
+        for (int x(0); x != Width; ++x) {
+            uint32_t pixel;
+            if (y < Top || y >= Top + Tall)
+                pixel = (x / 5 & 0xff) << 16 | (y / 6 & 0xff) << 8 | 0x80;
+            else {
+                uint32_t red((x + number * 9) / 3 & 0xff), green((y + x / 2 + number * 4) / 4 & 0xff), blue((x + y + number * 5) / 6 & 0xff);
+                pixel = (red << 16 | green << 8 | blue) ^ (random.Next() & 0x070707);
+            }
+            frame[y * Width + x] = pixel;
+        }
+}
+
+static void VNCBench(VNCPool &pool, rfbScreenInfo &screen, std::vector<uint32_t> &prev, std::vector<uint32_t> &next, bool video) {
+    int listener(socket(AF_INET, SOCK_STREAM, 0));
+    struct sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    VNCExpect(bind(listener, reinterpret_cast<struct sockaddr *>(&address), sizeof(address)) == 0);
+    socklen_t length(sizeof(address));
+    VNCExpect(getsockname(listener, reinterpret_cast<struct sockaddr *>(&address), &length) == 0);
+    VNCExpect(listen(listener, 1) == 0);
+
+    VNCViewer viewer;
+    viewer.sock_ = socket(AF_INET, SOCK_STREAM, 0);
+    pthread_mutex_init(&viewer.mutex_, NULL);
+    pthread_cond_init(&viewer.cond_, NULL);
+    viewer.read_ = 0;
+    int receive(64 * 1024);
+    setsockopt(viewer.sock_, SOL_SOCKET, SO_RCVBUF, &receive, sizeof(receive));
+    VNCExpect(connect(viewer.sock_, reinterpret_cast<struct sockaddr *>(&address), sizeof(address)) == 0);
+
+    rfbClientRec client;
+    memset(&client, 0, sizeof(client));
+    client.screen = &screen;
+    client.scaledScreen = &screen;
+    client.sock = accept(listener, NULL, NULL);
+    VNCExpect(client.sock != -1);
+    close(listener);
+    client.format = screen.serverFormat;
+    client.enableLastRectEncoding = TRUE;
+    client.tightQualityLevel = Requested;
+    pthread_mutex_init(&client.outputMutex, NULL);
+
+    pthread_t thread;
+    pthread_create(&thread, NULL, &VNCRead, &viewer);
+
+    VNCTightHistory history;
+    memset(&history, 0, sizeof(history));
+    VNCMotionJpeg codec(pool, &VNCSendNothing);
+    VNCThrottle throttle;
+    VNCMotion motion;
+    motion.Resize(Width, Height);
+    VNCDamage damage;
+    damage.Resize(Width, Height);
+
+    VNCRandom random(18);
+    uint64_t start(VNCMicroseconds()), sent(0), measured(0), late(0), worst(0), streamed(0);
+    unsigned frames(0), number(0);
+
+    for (;;) {
+        // the newest frame by now, as the ones in between were never asked for
+        uint64_t now(VNCMicroseconds());
+        if (now - start >= Duration)
+            break;
+        unsigned due((now - start) / Interval);
+        if (due < number) {
+            usleep(start + number * Interval - now);
+            due = number;
+        }
+        number = due + 1;
+        uint64_t tick(start + due * Interval);
+
+        prev.swap(next);
+        VNCRender(next, random, due);
+        screen.frameBuffer = reinterpret_cast<char *>(&next[0]);
+        damage.Compare(reinterpret_cast<uint8_t *>(&prev[0]), Width * 4, reinterpret_cast<uint8_t *>(&next[0]), Width * 4);
+        motion.Update(damage, VNCMicroseconds());
+
+        int quality(std::min(Requested, throttle.limit_));
+        uint64_t before(rfbStatLookupEncoding(&client, rfbEncodingTight)->bytesSent);
+        uint64_t encoding(VNCMicroseconds());
+
+        VNCRect region, inside;
+        bool playing(video && motion.Region(region));
+        for (size_t i(0); i != damage.count_; ++i) {
+            const VNCRect &rect(damage.rects_[i]);
+            if (!playing || !VNCIntersect(rect, region, inside)) {
+                VNCExpect(VNCSendRectTight(pool, NULL, &VNCSendNothing, history, &client, quality, rect.x, rect.y, rect.w, rect.h));
+                continue;
+            }
+
+            VNCRect parts[4];
+            size_t count(VNCSubtract(rect, inside, parts));
+            for (size_t j(0); j != count; ++j)
+                VNCExpect(VNCSendRectTight(pool, NULL, &VNCSendNothing, history, &client, quality, parts[j].x, parts[j].y, parts[j].w, parts[j].h));
+            VNCExpect(codec.Send(&client, quality, inside.x, inside.y, inside.w, inside.h));
+        }
+
+        uint64_t encoded(VNCMicroseconds());
+        uint64_t bytes(rfbStatLookupEncoding(&client, rfbEncodingTight)->bytesSent - before);
+        sent += bytes;
+
+        pthread_mutex_lock(&viewer.mutex_);
+        while (viewer.read_ < sent)
+            pthread_cond_wait(&viewer.cond_, &viewer.mutex_);
+        pthread_mutex_unlock(&viewer.mutex_);
+
+        uint64_t delivered(VNCMicroseconds());
+        throttle.Update(bytes, 0, encoded - encoding, delivered - encoded);
+
+        // the first frame is the whole screen, which is not what is measured
+        if (due == 0)
+            continue;
+        ++frames;
+        measured += bytes;
+        late += delivered - tick;
+        worst = std::max(worst, delivered - tick);
+        if (playing)
+            ++streamed;
+    }
+
+    shutdown(client.sock, SHUT_WR);
+    pthread_join(thread, NULL);
+    VNCExpect(viewer.read_ == sent);
+
+    printf("%s: %.1f fps, %.1fKB per frame, %llums average latency, %llums worst; %u of %u frames as video, throttle limit %d at the end\n",
+        video ? "video capped at 3" : "throttle alone", frames * 1000000.0 / Duration, measured / 1000.0 / frames,
+        (unsigned long long) (late / frames / 1000), (unsigned long long) (worst / 1000), unsigned(streamed), frames, throttle.limit_);
+
+    rfbCloseClient(&client);
+    close(viewer.sock_);
+    pthread_mutex_destroy(&client.outputMutex);
+    pthread_cond_destroy(&viewer.cond_);
+    pthread_mutex_destroy(&viewer.mutex_);
+}
+
+int main() {
+    VNCPool pool;
+    pool.Start(0);
+
+    std::vector<uint32_t> prev(Width * Height), next(Width * Height);
+
+    rfbScreenInfo screen;
+    memset(&screen, 0, sizeof(screen));
+    screen.width = Width;
+    screen.height = Height;
+    screen.paddedWidthInBytes = Width * 4;
+    screen.serverFormat.bitsPerPixel = 32;
+    screen.serverFormat.depth = 24;
+    screen.serverFormat.trueColour = TRUE;
+    screen.serverFormat.redMax = 0xff;
+    screen.serverFormat.greenMax = 0xff;
+    screen.serverFormat.blueMax = 0xff;
+    screen.serverFormat.redShift = 16;
+    screen.serverFormat.greenShift = 8;
+    screen.serverFormat.blueShift = 0;
+
+    VNCBench(pool, screen, prev, next, false);
+    VNCBench(pool, screen, prev, next, true);
+    return 0;
+}
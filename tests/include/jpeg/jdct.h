@@ -0,0 +1,35 @@
+/* Veency - VNC Remote Access Server for iPhoneOS
+ * Copyright (C) 2008-2014  Jay Freeman (saurik)
+*/
+
+/* GNU Affero General Public License, Version 3 {{{ */
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+/* }}} */
+
+
+#ifndef VEENCY_TESTS_JDCT_H
+#define VEENCY_TESTS_JDCT_H
+
+// jpeg-9a's jdct.h, as far as Jpeg.cpp needs it; JpegKernels.cpp defines
+// jpeg_fdct_islow() as jfdctint.c does
+
+typedef int DCTELEM;
+
+typedef void (*forward_DCT_method_ptr)(DCTELEM *data, JSAMPARRAY sample_data, JDIMENSION start_col);
+
+void jpeg_fdct_islow(DCTELEM *data, JSAMPARRAY sample_data, JDIMENSION start_col);
+
+#endif//VEENCY_TESTS_JDCT_H
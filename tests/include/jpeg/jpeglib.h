@@ -0,0 +1,112 @@
+/* Veency - VNC Remote Access Server for iPhoneOS
+ * Copyright (C) 2008-2014  Jay Freeman (saurik)
+*/
+
+/* GNU Affero General Public License, Version 3 {{{ */
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+/* }}} */
+
+
+#ifndef VEENCY_TESTS_JPEGLIB_H
+#define VEENCY_TESTS_JPEGLIB_H
+
+// just enough of jpeg-9a's jpeglib.h and jpegint.h, with the same names,
+// for Jpeg.cpp's kernels to build and be checked against the reference
+// in JpegKernels.cpp on a host without jpeg-9a; the records carry only the
+// fields Jpeg.cpp uses, so unlike rfb.h they do not share jpeg-9a's layout
+
+#define JPEG_LIB_VERSION 90
+
+#define DCTSIZE 8
+#define DCTSIZE2 64
+#define MAX_COMPONENTS 10
+
+#define CENTERJSAMPLE 128
+
+#define RGB_RED 0
+#define RGB_GREEN 1
+#define RGB_BLUE 2
+#define RGB_PIXELSIZE 3
+
+typedef unsigned char JSAMPLE;
+typedef short JCOEF;
+typedef unsigned int JDIMENSION;
+
+typedef JSAMPLE *JSAMPROW;
+typedef JSAMPROW *JSAMPARRAY;
+typedef JSAMPARRAY *JSAMPIMAGE;
+
+typedef JCOEF JBLOCK[DCTSIZE2];
+typedef JBLOCK *JBLOCKROW;
+
+typedef enum {
+    JCS_UNKNOWN,
+    JCS_GRAYSCALE,
+    JCS_RGB,
+    JCS_YCbCr,
+    JCS_CMYK,
+    JCS_YCCK,
+    JCS_BG_RGB,
+    JCS_BG_YCC,
+} J_COLOR_SPACE;
+
+typedef enum {
+    JCT_NONE = 0,
+    JCT_SUBTRACT_GREEN = 1,
+} J_COLOR_TRANSFORM;
+
+typedef enum {
+    JDCT_ISLOW,
+    JDCT_IFAST,
+    JDCT_FLOAT,
+} J_DCT_METHOD;
+
+typedef struct {
+    int component_index;
+    int DCT_h_scaled_size;
+    int DCT_v_scaled_size;
+    void *dct_table;
+} jpeg_component_info;
+
+typedef struct jpeg_compress_struct *j_compress_ptr;
+
+struct jpeg_color_converter {
+    void (*start_pass)(j_compress_ptr cinfo);
+    void (*color_convert)(j_compress_ptr cinfo, JSAMPARRAY input_buf, JSAMPIMAGE output_buf, JDIMENSION output_row, int num_rows);
+};
+
+struct jpeg_forward_dct {
+    void (*start_pass)(j_compress_ptr cinfo);
+    void (*forward_DCT[MAX_COMPONENTS])(j_compress_ptr cinfo, jpeg_component_info *compptr, JSAMPARRAY sample_data, JBLOCKROW coef_blocks, JDIMENSION start_row, JDIMENSION start_col, JDIMENSION num_blocks);
+};
+
+struct jpeg_compress_struct {
+    JDIMENSION image_width;
+    int input_components;
+    J_COLOR_SPACE in_color_space;
+
+    int num_components;
+    J_COLOR_SPACE jpeg_color_space;
+    jpeg_component_info *comp_info;
+
+    J_DCT_METHOD dct_method;
+    J_COLOR_TRANSFORM color_transform;
+
+    struct jpeg_color_converter *cconvert;
+    struct jpeg_forward_dct *fdct;
+};
+
+#endif//VEENCY_TESTS_JPEGLIB_H
@@ -0,0 +1,60 @@
+/* Veency - VNC Remote Access Server for iPhoneOS
+ * Copyright (C) 2008-2014  Jay Freeman (saurik)
+*/
+
+/* GNU Affero General Public License, Version 3 {{{ */
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+/* }}} */
+
+
+#ifndef VEENCY_TESTS_ARM_NEON_H
+#define VEENCY_TESTS_ARM_NEON_H
+
+// just the NEON intrinsics Damage.cpp uses, written with GCC vector types
+// so that its NEON kernel (built with VNC_FORCE_NEON) runs on any host;
+// this checks the kernel's logic against the reference, not the hardware
+
+#include <stdint.h>
+#include <string.h>
+
+typedef uint8_t uint8x16_t __attribute__((vector_size(16)));
+typedef uint64_t uint64x2_t __attribute__((vector_size(16)));
+
+static inline uint8x16_t vld1q_u8(const uint8_t *data) {
+    uint8x16_t value;
+    memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+static inline uint8x16_t vdupq_n_u8(uint8_t value) {
+    return uint8x16_t{} + value;
+}
+
+static inline uint8x16_t veorq_u8(uint8x16_t a, uint8x16_t b) {
+    return a ^ b;
+}
+
+static inline uint8x16_t vorrq_u8(uint8x16_t a, uint8x16_t b) {
+    return a | b;
+}
+
+static inline uint64x2_t vreinterpretq_u64_u8(uint8x16_t value) {
+    return reinterpret_cast<uint64x2_t>(value);
+}
+
+#define vgetq_lane_u64(value, lane) ((value)[lane])
+
+#endif//VEENCY_TESTS_ARM_NEON_H
@@ -0,0 +1,221 @@
+/* Veency - VNC Remote Access Server for iPhoneOS
+ * Copyright (C) 2008-2014  Jay Freeman (saurik)
+*/
+
+/* GNU Affero General Public License, Version 3 {{{ */
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+/* }}} */
+
+
+#ifndef VEENCY_TESTS_RFB_H
+#define VEENCY_TESTS_RFB_H
+
+// just enough of libvncserver's rfb.h, with the same names and layouts,
+// for the modules under test to build on a host without libvncserver;
+// Server.cpp implements what they call, and the records below carry only
+// the fields they use
+
+#include <pthread.h>
+#include <stdint.h>
+
+typedef int8_t rfbBool;
+
+#ifndef FALSE
+#define FALSE 0
+#endif
+#ifndef TRUE
+#define TRUE -1
+#endif
+
+extern char rfbEndianTest;
+
+#define Swap16IfLE(s) (rfbEndianTest ? uint16_t(((s) & 0xff) << 8 | ((s) >> 8 & 0xff)) : uint16_t(s))
+#define Swap32IfLE(l) (rfbEndianTest ? __builtin_bswap32(l) : uint32_t(l))
+
+#define LOCK(mutex) pthread_mutex_lock(&(mutex))
+#define UNLOCK(mutex) pthread_mutex_unlock(&(mutex))
+
+#define UPDATE_BUF_SIZE 30000
+
+#define rfbEncodingTight 7
+#define rfbTightFill 0x08
+#define rfbTightJpeg 0x09
+
+typedef struct {
+    uint16_t x;
+    uint16_t y;
+    uint16_t w;
+    uint16_t h;
+} rfbRectangle;
+
+typedef struct {
+    rfbRectangle r;
+    uint32_t encoding;
+} rfbFramebufferUpdateRectHeader;
+
+#define sz_rfbFramebufferUpdateRectHeader 12
+
+typedef struct {
+    uint8_t bitsPerPixel;
+    uint8_t depth;
+    uint8_t bigEndian;
+    uint8_t trueColour;
+    uint16_t redMax;
+    uint16_t greenMax;
+    uint16_t blueMax;
+    uint8_t redShift;
+    uint8_t greenShift;
+    uint8_t blueShift;
+    uint8_t pad1;
+    uint16_t pad2;
+} rfbPixelFormat;
+
+typedef void (*rfbTranslateFnType)(char *table, rfbPixelFormat *in, rfbPixelFormat *out, char *iptr, char *optr, int bytesBetweenInputLines, int width, int height);
+
+typedef struct {
+    int x1, y1;
+    int x2, y2;
+} sraRect;
+
+// unlike rfbregion.c's, these regions are plain lists of rects
+typedef struct sraRegion *sraRegionPtr;
+
+enum rfbNewClientAction {
+    RFB_CLIENT_ACCEPT,
+    RFB_CLIENT_ON_HOLD,
+    RFB_CLIENT_REFUSE
+};
+
+enum rfbSocketState {
+    RFB_SOCKET_INIT,
+    RFB_SOCKET_READY,
+    RFB_SOCKET_SHUTDOWN
+};
+
+struct _rfbClientRec;
+
+typedef enum rfbNewClientAction (*rfbNewClientHookPtr)(struct _rfbClientRec *cl);
+typedef void (*ClientGoneHookPtr)(struct _rfbClientRec *cl);
+
+typedef struct _rfbScreenInfo {
+    int width;
+    int paddedWidthInBytes;
+    int height;
+    rfbPixelFormat serverFormat;
+    char *frameBuffer;
+
+    enum rfbSocketState socketState;
+    int listenSock;
+    int listen6Sock;
+    int httpListenSock;
+    int httpListen6Sock;
+    int httpSock;
+
+    int deferUpdateTime;
+    int deferPtrUpdateTime;
+
+    struct _rfbClientRec *clientHead;
+    rfbNewClientHookPtr newClientHook;
+} rfbScreenInfo, *rfbScreenInfoPtr;
+
+typedef struct _rfbClientRec {
+    rfbScreenInfoPtr screen;
+    rfbScreenInfoPtr scaledScreen;
+    void *clientData;
+    ClientGoneHookPtr clientGoneHook;
+
+    int sock;
+    rfbBool onHold;
+    rfbBool viewOnly;
+    int lastPtrX;
+
+    rfbPixelFormat format;
+    rfbTranslateFnType translateFn;
+    char *translateLookupTable;
+
+    char updateBuf[UPDATE_BUF_SIZE];
+    int ublen;
+
+    rfbBool enableLastRectEncoding;
+    int tightQualityLevel;
+
+    sraRegionPtr modifiedRegion;
+    sraRegionPtr requestedRegion;
+    sraRegionPtr copyRegion;
+
+    pthread_mutex_t outputMutex;
+    pthread_mutex_t updateMutex;
+
+    struct _rfbStatList *statEncList;
+    struct _rfbClientRec *next;
+} rfbClientRec, *rfbClientPtr;
+
+// less the cursor and the framebuffer size, which are not modeled here
+#define FB_UPDATE_PENDING(cl) (!sraRgnEmpty((cl)->copyRegion) || !sraRgnEmpty((cl)->modifiedRegion))
+
+typedef struct rfbClientIterator *rfbClientIteratorPtr;
+
+rfbClientIteratorPtr rfbGetClientIterator(rfbScreenInfoPtr rfbScreen);
+rfbClientIteratorPtr rfbGetClientIteratorWithClosed(rfbScreenInfoPtr rfbScreen);
+rfbClientPtr rfbClientIteratorNext(rfbClientIteratorPtr iterator);
+void rfbReleaseClientIterator(rfbClientIteratorPtr iterator);
+
+// as in main.c, less the threads; rfbCheckFds() and what follows are for a
+// test that needs them to define, standing in for libvncserver's event loop
+rfbClientPtr rfbNewClient(rfbScreenInfoPtr rfbScreen, int sock);
+void rfbClientConnectionGone(rfbClientPtr cl);
+void rfbStartOnHoldClient(rfbClientPtr cl);
+void rfbRefuseOnHoldClient(rfbClientPtr cl);
+rfbBool rfbIsActive(rfbScreenInfoPtr screenInfo);
+int rfbCheckFds(rfbScreenInfoPtr rfbScreen, long usec);
+void rfbHttpCheckFds(rfbScreenInfoPtr rfbScreen);
+void rfbProcessClientMessage(rfbClientPtr cl);
+rfbBool rfbUpdateClient(rfbClientPtr cl);
+
+typedef struct _rfbStatList {
+    uint32_t type;
+    uint32_t sentCount;
+    uint32_t bytesSent;
+    uint32_t bytesSentIfRaw;
+    uint32_t rcvdCount;
+    uint32_t bytesRcvd;
+    uint32_t bytesRcvdIfRaw;
+    struct _rfbStatList *Next;
+} rfbStatList;
+
+extern int rfbMaxClientWait;
+
+int rfbWriteExact(rfbClientPtr cl, const char *buf, int len);
+rfbBool rfbSendUpdateBuf(rfbClientPtr cl);
+void rfbCloseClient(rfbClientPtr cl);
+void rfbLogPerror(const char *str);
+
+rfbStatList *rfbStatLookupEncoding(rfbClientPtr cl, uint32_t type);
+void rfbStatRecordEncodingSent(rfbClientPtr cl, int type, int byteCount, int byteIfRaw);
+void rfbStatRecordEncodingSentAdd(rfbClientPtr cl, int type, int byteCount);
+
+sraRegionPtr sraRgnCreate();
+sraRegionPtr sraRgnCreateRect(int x1, int y1, int x2, int y2);
+void sraRgnDestroy(sraRegionPtr region);
+void sraRgnMakeEmpty(sraRegionPtr region);
+void sraRgnOr(sraRegionPtr dst, sraRegionPtr src);
+rfbBool sraRgnEmpty(sraRegionPtr region);
+sraRect sraRgnBBox(sraRegionPtr region);
+
+// not in libvncserver: whether a pixel is in the region
+bool sraRgnContains(sraRegionPtr region, int x, int y);
+
+#endif//VEENCY_TESTS_RFB_H